@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _MIPS_ATOMIC_H_
+#define _MIPS_ATOMIC_H_
+
+/*
+ * Machine-dependent atomic word operations for <atomic.h>.
+ *
+ * All of these are built on the LL/SC instructions; see the comments
+ * in <machine/spinlock.h> for how those work. Each operation loads
+ * the word with LL, computes the new value in a register, and tries
+ * to store it back with SC, looping if the SC fails because some
+ * other processor (or a trap on this one) got in between. There must
+ * be no other memory accesses between the LL and the SC, so the
+ * computation is restricted to one register-to-register instruction.
+ *
+ * Each function returns the value the word held before the update.
+ * None of them imply a memory barrier; <atomic.h> adds those.
+ */
+
+ATOMIC_INLINE uint32_t atomic_data_fetchadd(volatile uint32_t *w,
+					    uint32_t delta);
+ATOMIC_INLINE uint32_t atomic_data_fetchor(volatile uint32_t *w,
+					   uint32_t bits);
+ATOMIC_INLINE uint32_t atomic_data_fetchand(volatile uint32_t *w,
+					    uint32_t bits);
+ATOMIC_INLINE uint32_t atomic_data_swap(volatile uint32_t *w,
+					uint32_t newval);
+ATOMIC_INLINE uint32_t atomic_data_cas(volatile uint32_t *w,
+				       uint32_t oldval, uint32_t newval);
+
+////////////////////////////////////////////////////////////
+
+/*
+ * *w += delta.
+ */
+ATOMIC_INLINE
+uint32_t
+atomic_data_fetchadd(volatile uint32_t *w, uint32_t delta)
+{
+	uint32_t old, tmp;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   old = *w */
+		"addu %1, %0, %3;"	/*   tmp = old + delta */
+		"sc %1, 0(%2);"		/*   *w = tmp; tmp = success? */
+		"beqz %1, 1b;"		/*   retry if the store failed */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (tmp)
+		: "r" (w), "r" (delta)
+		: "memory");
+	return old;
+}
+
+/*
+ * *w |= bits.
+ */
+ATOMIC_INLINE
+uint32_t
+atomic_data_fetchor(volatile uint32_t *w, uint32_t bits)
+{
+	uint32_t old, tmp;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   old = *w */
+		"or %1, %0, %3;"	/*   tmp = old | bits */
+		"sc %1, 0(%2);"		/*   *w = tmp; tmp = success? */
+		"beqz %1, 1b;"		/*   retry if the store failed */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (tmp)
+		: "r" (w), "r" (bits)
+		: "memory");
+	return old;
+}
+
+/*
+ * *w &= bits.
+ */
+ATOMIC_INLINE
+uint32_t
+atomic_data_fetchand(volatile uint32_t *w, uint32_t bits)
+{
+	uint32_t old, tmp;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   old = *w */
+		"and %1, %0, %3;"	/*   tmp = old & bits */
+		"sc %1, 0(%2);"		/*   *w = tmp; tmp = success? */
+		"beqz %1, 1b;"		/*   retry if the store failed */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (tmp)
+		: "r" (w), "r" (bits)
+		: "memory");
+	return old;
+}
+
+/*
+ * *w = newval.
+ */
+ATOMIC_INLINE
+uint32_t
+atomic_data_swap(volatile uint32_t *w, uint32_t newval)
+{
+	uint32_t old, tmp;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   old = *w */
+		"move %1, %3;"		/*   tmp = newval */
+		"sc %1, 0(%2);"		/*   *w = tmp; tmp = success? */
+		"beqz %1, 1b;"		/*   retry if the store failed */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (tmp)
+		: "r" (w), "r" (newval)
+		: "memory");
+	return old;
+}
+
+/*
+ * if (*w == oldval) *w = newval.
+ *
+ * The caller can tell whether the swap happened by comparing the
+ * return value to OLDVAL.
+ */
+ATOMIC_INLINE
+uint32_t
+atomic_data_cas(volatile uint32_t *w, uint32_t oldval, uint32_t newval)
+{
+	uint32_t old, tmp;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set volatile;"	/* avoid unwanted optimization */
+		"1: ll %0, 0(%2);"	/*   old = *w */
+		"bne %0, %3, 2f;"	/*   give up if old != oldval */
+		"move %1, %4;"		/*   tmp = newval */
+		"sc %1, 0(%2);"		/*   *w = tmp; tmp = success? */
+		"beqz %1, 1b;"		/*   retry if the store failed */
+		"2:;"
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (tmp)
+		: "r" (w), "r" (oldval), "r" (newval)
+		: "memory");
+	return old;
+}
+
+
+#endif /* _MIPS_ATOMIC_H_ */
@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/wait.h>
 #include <signal.h>
 #include <lib.h>
 #include <mips/specialreg.h>
@@ -36,6 +37,7 @@
 #include <spl.h>
 #include <thread.h>
 #include <current.h>
+#include <proc.h>
 #include <vm.h>
 #include <mainbus.h>
 #include <syscall.h>
@@ -109,12 +111,13 @@ kill_curthread(vaddr_t epc, unsigned code, vaddr_t vaddr)
 	}
 
 	/*
-	 * You will probably want to change this.
+	 * There are no signal handlers, so the signal always kills
+	 * the process; the parent sees it in the waitpid status.
 	 */
 
 	kprintf("Fatal user mode trap %u sig %d (%s, epc 0x%x, vaddr 0x%x)\n",
 		code, sig, trapcodenames[code], epc, vaddr);
-	panic("I don't know how to handle this\n");
+	proc_exit(_MKWAIT_SIG(sig));
 }
 
 /*
@@ -153,6 +156,7 @@ mips_trap(struct trapframe *tf)
 	if (code == EX_IRQ) {
 		int old_in;
 		bool doadjust;
+		unsigned acct;
 
 		old_in = curthread->t_in_interrupt;
 		curthread->t_in_interrupt = 1;
@@ -185,7 +189,10 @@ mips_trap(struct trapframe *tf)
 			doadjust = false;
 		}
 
+		acct = thread_cputime(CPUTIME_INTR);
 		mainbus_interrupt(tf);
+		thread_resched();
+		thread_cputime(acct);
 
 		if (doadjust) {
 			KASSERT(curthread->t_curspl == IPL_HIGH);
@@ -212,6 +219,11 @@ mips_trap(struct trapframe *tf)
 	spl = splhigh();
 	splx(spl);
 
+	/* Coming from user mode, stop charging user time. */
+	if (!iskern) {
+		thread_cputime(CPUTIME_SYS);
+	}
+
 	/* Syscall? Call the syscall handler and return. */
 	if (code == EX_SYS) {
 		/* Interrupts should have been on while in user mode. */
@@ -222,6 +234,7 @@ mips_trap(struct trapframe *tf)
 		      tf->tf_v0, tf->tf_a0, tf->tf_a1, tf->tf_a2, tf->tf_a3);
 
 		syscall(tf);
+		thread_resched();
 		goto done;
 	}
 
@@ -315,6 +328,10 @@ mips_trap(struct trapframe *tf)
 	panic("I can't handle this... I think I'll just die now...\n");
 
  done:
+	if (!iskern) {
+		thread_cputime(CPUTIME_USER);
+	}
+
 	/*
 	 * Turn interrupts off on the processor, without affecting the
 	 * stored interrupt state.
@@ -375,6 +392,7 @@ mips_usermode(struct trapframe *tf)
 	 * above, we explicitly call spl0() and then call cpu_irqoff().
 	 */
 	spl0();
+	thread_cputime(CPUTIME_USER);
 	cpu_irqoff();
 
 	cputhreads[curcpu->c_number] = (vaddr_t)curthread;
@@ -30,13 +30,619 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <kern/syscall.h>
+#include <endian.h>
 #include <lib.h>
+#include <atomic.h>
+#include <clock.h>
+#include <copyinout.h>
 #include <mips/trapframe.h>
 #include <thread.h>
 #include <current.h>
+#include <addrspace.h>
 #include <syscall.h>
 
 
+/*
+ * System call table.
+ *
+ * Each entry gives the call's name, an argument descriptor, and an
+ * adapter that passes the unpacked arguments to the sys_* function
+ * with the right types. The descriptor has one character per
+ * argument: 'i' for an integer, 'p' for a pointer, 'l' for a 64-bit
+ * value (off_t). syscall() uses it to fetch the arguments from the
+ * registers and user stack following the calling convention below,
+ * so adapters never look at the trapframe.
+ *
+ * A call whose result is 64 bits (e.g. lseek) sets se_ret64 and gets
+ * it back in v0/v1; otherwise only the low 32 bits of *retval are
+ * returned.
+ *
+ * Each entry also counts its calls and the total time spent in them,
+ * from entry to return, including any time asleep. These are
+ * updated with atomic operations from all cpus and printed, then
+ * cleared, by syscall_printstats.
+ */
+
+#define SYSCALL_MAXARGS		6	/* arguments per call */
+#define SYSCALL_MAXWORDS	8	/* 32-bit words those can take */
+
+struct sysargs {
+	uint64_t sa_arg[SYSCALL_MAXARGS];
+	struct trapframe *sa_tf;	/* for fork and vfork */
+};
+
+#define SA_INT(a, n)	((int)(a)->sa_arg[n])
+#define SA_PTR(a, n)	((userptr_t)(uintptr_t)(a)->sa_arg[n])
+#define SA_CPTR(a, n)	((const_userptr_t)(uintptr_t)(a)->sa_arg[n])
+#define SA_OFF(a, n)	((off_t)(a)->sa_arg[n])
+
+typedef int (*sysent_fn)(const struct sysargs *args, int64_t *retval);
+
+struct sysent {
+	const char *se_name;
+	const char *se_args;		/* argument descriptor */
+	sysent_fn se_func;
+	bool se_ret64;			/* result is 64 bits */
+	atomic_t se_calls;		/* number of calls */
+	atomic_t se_nslo, se_nshi;	/* total ns in the call */
+};
+
+static
+int
+sc_reboot(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_reboot(SA_INT(a, 0));
+}
+
+static
+int
+sc___time(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys___time(SA_PTR(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_nanosleep(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_nanosleep(SA_CPTR(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_spawn(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_spawn(SA_CPTR(a, 0), SA_PTR(a, 1), SA_CPTR(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_getrusage(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_getrusage(SA_INT(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_fork(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_fork(a->sa_tf, &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_vfork(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_vfork(a->sa_tf, &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_execv(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_execv(SA_CPTR(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc__exit(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	sys__exit(SA_INT(a, 0));
+}
+
+static
+int
+sc_waitpid(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_waitpid(SA_INT(a, 0), SA_PTR(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_getpid(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	(void)a;
+	err = sys_getpid(&ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_clock_gettime(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_clock_gettime(SA_INT(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_getpriority(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_getpriority(SA_INT(a, 0), SA_INT(a, 1), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_setpriority(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_setpriority(SA_INT(a, 0), SA_INT(a, 1), SA_INT(a, 2));
+}
+
+static
+int
+sc_sched_setaffinity(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_sched_setaffinity(SA_INT(a, 0), SA_CPTR(a, 1));
+}
+
+static
+int
+sc_sched_getaffinity(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_sched_getaffinity(SA_INT(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_sched_setscheduler(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_sched_setscheduler(SA_INT(a, 0), SA_INT(a, 1),
+				      SA_CPTR(a, 2));
+}
+
+static
+int
+sc_sched_getscheduler(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_sched_getscheduler(SA_INT(a, 0), SA_PTR(a, 1), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_open(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_open(SA_CPTR(a, 0), SA_INT(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_close(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_close(SA_INT(a, 0));
+}
+
+static
+int
+sc_dup2(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_dup2(SA_INT(a, 0), SA_INT(a, 1), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_read(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_read(SA_INT(a, 0), SA_PTR(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_write(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_write(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_pread(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_pread(SA_INT(a, 0), SA_PTR(a, 1), SA_INT(a, 2),
+			SA_OFF(a, 3), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_pwrite(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_pwrite(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2),
+			 SA_OFF(a, 3), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_readv(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_readv(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_preadv(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_preadv(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2),
+			 SA_OFF(a, 3), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_writev(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_writev(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_pwritev(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_pwritev(SA_INT(a, 0), SA_CPTR(a, 1), SA_INT(a, 2),
+			  SA_OFF(a, 3), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_lseek(const struct sysargs *a, int64_t *retval)
+{
+	off_t ret;
+	int err;
+
+	err = sys_lseek(SA_INT(a, 0), SA_OFF(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_pipe(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_pipe(SA_PTR(a, 0));
+}
+
+static
+int
+sc_splice(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_splice(SA_INT(a, 0), SA_INT(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_select(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_select(SA_INT(a, 0), SA_PTR(a, 1), SA_PTR(a, 2),
+			 SA_PTR(a, 3), SA_CPTR(a, 4), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_poll(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_poll(SA_PTR(a, 0), SA_INT(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+static
+int
+sc_stat(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_stat(SA_CPTR(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_fstat(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_fstat(SA_INT(a, 0), SA_PTR(a, 1));
+}
+
+static
+int
+sc_uring_setup(const struct sysargs *a, int64_t *retval)
+{
+	(void)retval;
+	return sys_uring_setup(SA_PTR(a, 0), SA_INT(a, 1), SA_INT(a, 2));
+}
+
+static
+int
+sc_uring_enter(const struct sysargs *a, int64_t *retval)
+{
+	int32_t ret;
+	int err;
+
+	err = sys_uring_enter(SA_INT(a, 0), SA_INT(a, 1), SA_INT(a, 2), &ret);
+	*retval = ret;
+	return err;
+}
+
+#define SYSENT(name, args) \
+	[SYS_##name] = { #name, args, sc_##name, false, \
+			 ATOMIC_INITIALIZER(0), ATOMIC_INITIALIZER(0), \
+			 ATOMIC_INITIALIZER(0) }
+#define SYSENT64(name, args) \
+	[SYS_##name] = { #name, args, sc_##name, true, \
+			 ATOMIC_INITIALIZER(0), ATOMIC_INITIALIZER(0), \
+			 ATOMIC_INITIALIZER(0) }
+
+static struct sysent sysent[] = {
+	SYSENT(reboot,			"i"),
+	SYSENT(__time,			"pp"),
+	SYSENT(nanosleep,		"pp"),
+	SYSENT(fork,			""),
+	SYSENT(vfork,			""),
+	SYSENT(execv,			"pp"),
+	SYSENT(_exit,			"i"),
+	SYSENT(waitpid,			"ipi"),
+	SYSENT(getpid,			""),
+	SYSENT(getrusage,		"ip"),
+	SYSENT(clock_gettime,		"ip"),
+	SYSENT(getpriority,		"ii"),
+	SYSENT(setpriority,		"iii"),
+	SYSENT(sched_setaffinity,	"ip"),
+	SYSENT(sched_getaffinity,	"ip"),
+	SYSENT(sched_setscheduler,	"iip"),
+	SYSENT(sched_getscheduler,	"ip"),
+	SYSENT(spawn,			"ppp"),
+	SYSENT(open,			"pii"),
+	SYSENT(dup2,			"ii"),
+	SYSENT(close,			"i"),
+	SYSENT(read,			"ipi"),
+	SYSENT(pread,			"ipil"),
+	SYSENT(readv,			"ipi"),
+	SYSENT(preadv,			"ipil"),
+	SYSENT(write,			"ipi"),
+	SYSENT(pwrite,			"ipil"),
+	SYSENT(writev,			"ipi"),
+	SYSENT(pwritev,			"ipil"),
+	SYSENT64(lseek,			"ili"),
+	SYSENT(pipe,			"p"),
+	SYSENT(splice,			"iii"),
+	SYSENT(select,			"ipppp"),
+	SYSENT(poll,			"pii"),
+	SYSENT(stat,			"pp"),
+	SYSENT(fstat,			"ip"),
+	SYSENT(uring_setup,		"pii"),
+	SYSENT(uring_enter,		"iii"),
+
+	/* Add stuff here */
+};
+
+/*
+ * Fetch the arguments described by DESC. The first four words come
+ * from a0-a3 and the rest from the user stack; a 64-bit argument
+ * starts on an even word.
+ */
+static
+int
+syscall_getargs(struct trapframe *tf, const char *desc, struct sysargs *args)
+{
+	uint32_t words[SYSCALL_MAXWORDS];
+	unsigned nwords, w, i;
+	uint64_t val;
+	int result;
+
+	/* Count the words, so we copy in only as many as we need. */
+	nwords = 0;
+	for (i=0; desc[i] != '\0'; i++) {
+		if (desc[i] == 'l') {
+			nwords = ROUNDUP(nwords, 2) + 2;
+		}
+		else {
+			nwords++;
+		}
+	}
+	KASSERT(i <= SYSCALL_MAXARGS);
+	KASSERT(nwords <= SYSCALL_MAXWORDS);
+
+	words[0] = tf->tf_a0;
+	words[1] = tf->tf_a1;
+	words[2] = tf->tf_a2;
+	words[3] = tf->tf_a3;
+	if (nwords > 4) {
+		result = copyin((const_userptr_t)(tf->tf_sp + 16), &words[4],
+				(nwords - 4) * sizeof(uint32_t));
+		if (result) {
+			return result;
+		}
+	}
+
+	w = 0;
+	for (i=0; desc[i] != '\0'; i++) {
+		if (desc[i] == 'l') {
+			w = ROUNDUP(w, 2);
+			join32to64(words[w], words[w+1], &val);
+			args->sa_arg[i] = val;
+			w += 2;
+		}
+		else {
+			args->sa_arg[i] = words[w++];
+		}
+	}
+	return 0;
+}
+
+/*
+ * Add NS to an entry's total time. The total is kept as two atomic
+ * words; a carry out of the low one goes into the high one.
+ */
+static
+void
+syscall_addtime(struct sysent *se, uint64_t ns)
+{
+	uint32_t lo, hi, old;
+
+	lo = (uint32_t)ns;
+	hi = (uint32_t)(ns >> 32);
+	old = (uint32_t)atomic_fetch_add(&se->se_nslo, (int)lo);
+	if (old + lo < old) {
+		hi++;
+	}
+	if (hi != 0) {
+		atomic_fetch_add(&se->se_nshi, (int)hi);
+	}
+}
+
+/*
+ * Print the count, total time, and average time of every call that
+ * has been made since last time, then clear them. A call finishing
+ * on another cpu while we clear may be lost or half counted.
+ */
+void
+syscall_printstats(void)
+{
+	struct sysent *se;
+	unsigned i, calls;
+	uint64_t ns;
+
+	kprintf("%-20s %10s %12s %10s\n", "syscall", "calls", "total(us)",
+		"avg(ns)");
+	for (i=0; i<ARRAYCOUNT(sysent); i++) {
+		se = &sysent[i];
+		calls = atomic_read(&se->se_calls);
+		if (se->se_func == NULL || calls == 0) {
+			continue;
+		}
+		ns = ((uint64_t)(uint32_t)atomic_read(&se->se_nshi) << 32) |
+			(uint32_t)atomic_read(&se->se_nslo);
+		kprintf("%-20s %10u %12u %10u\n", se->se_name, calls,
+			(unsigned)(ns / 1000), (unsigned)(ns / calls));
+		atomic_set(&se->se_calls, 0);
+		atomic_set(&se->se_nslo, 0);
+		atomic_set(&se->se_nshi, 0);
+	}
+}
+
 /*
  * System call dispatcher.
  *
@@ -73,13 +679,17 @@
  * If you run out of registers (which happens quickly with 64-bit
  * values) further arguments must be fetched from the user-level
  * stack, starting at sp+16 to skip over the slots for the
- * registerized values, with copyin().
+ * registerized values, with copyin(). syscall_getargs does this.
  */
 void
 syscall(struct trapframe *tf)
 {
 	int callno;
-	int32_t retval;
+	struct sysent *se;
+	struct sysargs args;
+	int64_t retval;
+	uint32_t v0, v1;
+	uint64_t start;
 	int err;
 
 	KASSERT(curthread != NULL);
@@ -99,22 +709,25 @@ syscall(struct trapframe *tf)
 
 	retval = 0;
 
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
-
-	    case SYS___time:
-		err = sys___time((userptr_t)tf->tf_a0,
-				 (userptr_t)tf->tf_a1);
-		break;
-
-	    /* Add stuff here */
+	se = NULL;
+	if (callno >= 0 && (unsigned)callno < ARRAYCOUNT(sysent) &&
+	    sysent[callno].se_func != NULL) {
+		se = &sysent[callno];
+	}
 
-	    default:
+	if (se == NULL) {
 		kprintf("Unknown syscall %d\n", callno);
 		err = ENOSYS;
-		break;
+	}
+	else {
+		start = clock_monotonic_ns();
+		args.sa_tf = tf;
+		err = syscall_getargs(tf, se->se_args, &args);
+		if (!err) {
+			err = se->se_func(&args, &retval);
+		}
+		atomic_inc(&se->se_calls);
+		syscall_addtime(se, clock_monotonic_ns() - start);
 	}
 
 
@@ -127,9 +740,16 @@ syscall(struct trapframe *tf)
 		tf->tf_v0 = err;
 		tf->tf_a3 = 1;      /* signal an error */
 	}
+	else if (se->se_ret64) {
+		/* Success, with a 64-bit result in v0/v1. */
+		split64to32(retval, &v0, &v1);
+		tf->tf_v0 = v0;
+		tf->tf_v1 = v1;
+		tf->tf_a3 = 0;      /* signal no error */
+	}
 	else {
 		/* Success. */
-		tf->tf_v0 = retval;
+		tf->tf_v0 = (int32_t)retval;
 		tf->tf_a3 = 0;      /* signal no error */
 	}
 
@@ -149,13 +769,22 @@ syscall(struct trapframe *tf)
 /*
  * Enter user mode for a newly forked process.
  *
- * This function is provided as a reminder. You need to write
- * both it and the code that calls it.
- *
- * Thus, you can trash it and do things another way if you prefer.
+ * TF is a kmalloc'd copy of the parent's trapframe at the fork
+ * syscall. Copy it onto our stack, so mips_usermode can use it, and
+ * make the syscall return 0 in the child.
  */
 void
 enter_forked_process(struct trapframe *tf)
 {
-	(void)tf;
+	struct trapframe mytf;
+
+	mytf = *tf;
+	kfree(tf);
+
+	mytf.tf_v0 = 0;
+	mytf.tf_a3 = 0;      /* signal no error */
+	mytf.tf_epc += 4;
+
+	as_activate();
+	mips_usermode(&mytf);
 }
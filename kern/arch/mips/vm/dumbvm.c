@@ -36,6 +36,7 @@
 #include <proc.h>
 #include <current.h>
 #include <mips/tlb.h>
+#include <atomic.h>
 #include <addrspace.h>
 #include <vm.h>
 
@@ -64,6 +65,25 @@
  */
 static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
 
+/*
+ * Shared read-only text.
+ *
+ * Only region 1 can be shared; in the executables we build it is the
+ * text segment. The pages are shared by every address space that has
+ * the astext, including copies made by as_copy, and mapped without
+ * TLBLO_DIRTY so that writes to them fault.
+ *
+ * Since dumbvm never frees physical pages, dropping the last
+ * reference only frees the astext itself; what sharing saves is the
+ * pages each further address space would otherwise have stolen.
+ */
+struct astext {
+	vaddr_t at_vbase;
+	paddr_t at_pbase;
+	size_t at_npages;
+	atomic_t at_refcount;
+};
+
 void
 vm_bootstrap(void)
 {
@@ -141,6 +161,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	int i;
 	uint32_t ehi, elo;
 	struct addrspace *as;
+	bool writable;
 	int spl;
 
 	faultaddress &= PAGE_FRAME;
@@ -149,8 +170,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/* Only shared text is mapped read-only; writing it is fatal */
+		return EFAULT;
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
 		break;
@@ -197,8 +218,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
 	stacktop = USERSTACK;
 
+	writable = true;
 	if (faultaddress >= vbase1 && faultaddress < vtop1) {
 		paddr = (faultaddress - vbase1) + as->as_pbase1;
+		writable = as->as_text1 == NULL;
 	}
 	else if (faultaddress >= vbase2 && faultaddress < vtop2) {
 		paddr = (faultaddress - vbase2) + as->as_pbase2;
@@ -222,7 +245,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | TLBLO_VALID;
+		if (writable) {
+			elo |= TLBLO_DIRTY;
+		}
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
@@ -249,6 +275,7 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	as->as_text1 = NULL;
 
 	return as;
 }
@@ -257,6 +284,9 @@ void
 as_destroy(struct addrspace *as)
 {
 	dumbvm_can_sleep();
+	if (as->as_text1 != NULL) {
+		as_text_release(as->as_text1);
+	}
 	kfree(as);
 }
 
@@ -338,15 +368,18 @@ as_zero_region(paddr_t paddr, unsigned npages)
 int
 as_prepare_load(struct addrspace *as)
 {
-	KASSERT(as->as_pbase1 == 0);
 	KASSERT(as->as_pbase2 == 0);
-	KASSERT(as->as_stackpbase == 0);
 
 	dumbvm_can_sleep();
 
-	as->as_pbase1 = getppages(as->as_npages1);
-	if (as->as_pbase1 == 0) {
-		return ENOMEM;
+	/* Shared text is already loaded. */
+	if (as->as_text1 == NULL) {
+		KASSERT(as->as_pbase1 == 0);
+		as->as_pbase1 = getppages(as->as_npages1);
+		if (as->as_pbase1 == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_pbase1, as->as_npages1);
 	}
 
 	as->as_pbase2 = getppages(as->as_npages2);
@@ -354,14 +387,16 @@ as_prepare_load(struct addrspace *as)
 		return ENOMEM;
 	}
 
-	as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+	/* The stack may already be there, holding exec's arguments. */
 	if (as->as_stackpbase == 0) {
-		return ENOMEM;
+		as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+		if (as->as_stackpbase == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
 	}
 
-	as_zero_region(as->as_pbase1, as->as_npages1);
 	as_zero_region(as->as_pbase2, as->as_npages2);
-	as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
 
 	return 0;
 }
@@ -383,6 +418,29 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * The stack is DUMBVM_STACKPAGES physically contiguous pages, so the
+ * window is all of it, through the direct-mapped segment. Allocate it
+ * now if as_prepare_load hasn't yet.
+ */
+int
+as_stackwindow(struct addrspace *as, vaddr_t *ktop, size_t *len)
+{
+	dumbvm_can_sleep();
+
+	if (as->as_stackpbase == 0) {
+		as->as_stackpbase = getppages(DUMBVM_STACKPAGES);
+		if (as->as_stackpbase == 0) {
+			return ENOMEM;
+		}
+		as_zero_region(as->as_stackpbase, DUMBVM_STACKPAGES);
+	}
+
+	*len = DUMBVM_STACKPAGES * PAGE_SIZE;
+	*ktop = PADDR_TO_KVADDR(as->as_stackpbase) + *len;
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
@@ -397,6 +455,12 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 
 	new->as_vbase1 = old->as_vbase1;
 	new->as_npages1 = old->as_npages1;
+	if (old->as_text1 != NULL) {
+		/* Read-only, so the copy can share it. */
+		new->as_pbase1 = old->as_pbase1;
+		new->as_text1 = old->as_text1;
+		atomic_inc(&new->as_text1->at_refcount);
+	}
 	new->as_vbase2 = old->as_vbase2;
 	new->as_npages2 = old->as_npages2;
 
@@ -410,9 +474,11 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	KASSERT(new->as_pbase2 != 0);
 	KASSERT(new->as_stackpbase != 0);
 
-	memmove((void *)PADDR_TO_KVADDR(new->as_pbase1),
-		(const void *)PADDR_TO_KVADDR(old->as_pbase1),
-		old->as_npages1*PAGE_SIZE);
+	if (new->as_text1 == NULL) {
+		memmove((void *)PADDR_TO_KVADDR(new->as_pbase1),
+			(const void *)PADDR_TO_KVADDR(old->as_pbase1),
+			old->as_npages1*PAGE_SIZE);
+	}
 
 	memmove((void *)PADDR_TO_KVADDR(new->as_pbase2),
 		(const void *)PADDR_TO_KVADDR(old->as_pbase2),
@@ -425,3 +491,77 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	*ret = new;
 	return 0;
 }
+
+int
+as_share_text(struct addrspace *as, vaddr_t vaddr, struct astext **ret)
+{
+	struct astext *text;
+
+	if (as->as_vbase1 != (vaddr & PAGE_FRAME) || as->as_pbase1 == 0) {
+		return ENOSYS;
+	}
+
+	if (as->as_text1 == NULL) {
+		text = kmalloc(sizeof(*text));
+		if (text == NULL) {
+			return ENOMEM;
+		}
+		text->at_vbase = as->as_vbase1;
+		text->at_pbase = as->as_pbase1;
+		text->at_npages = as->as_npages1;
+		atomic_set(&text->at_refcount, 1);
+		as->as_text1 = text;
+
+		/* Drop writable TLB entries left over from loading it. */
+		if (as == proc_getas()) {
+			as_activate();
+		}
+	}
+
+	atomic_inc(&as->as_text1->at_refcount);
+	*ret = as->as_text1;
+	return 0;
+}
+
+int
+as_define_text(struct addrspace *as, vaddr_t vaddr, size_t sz,
+	       struct astext *text)
+{
+	size_t npages;
+
+	sz += vaddr & ~(vaddr_t)PAGE_FRAME;
+	vaddr &= PAGE_FRAME;
+	npages = (sz + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	if (as->as_vbase1 != 0 || vaddr != text->at_vbase ||
+	    npages != text->at_npages) {
+		return EINVAL;
+	}
+
+	as->as_vbase1 = vaddr;
+	as->as_npages1 = npages;
+	as->as_pbase1 = text->at_pbase;
+	as->as_text1 = text;
+	atomic_inc(&text->at_refcount);
+	return 0;
+}
+
+void
+as_text_hold(struct astext *text)
+{
+	atomic_inc(&text->at_refcount);
+}
+
+void
+as_text_release(struct astext *text)
+{
+	if (atomic_dec_and_test(&text->at_refcount)) {
+		kfree(text);
+	}
+}
+
+unsigned
+as_text_users(struct astext *text)
+{
+	return atomic_read(&text->at_refcount);
+}
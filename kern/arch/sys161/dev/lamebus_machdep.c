@@ -53,6 +53,35 @@
  */
 #define CPU_FREQUENCY 25000000 /* 25 MHz */
 
+/* Wiring of LAMEbus interrupts to bits in the cause register */
+#define LAMEBUS_IRQ_BIT  0x00000400	/* all system bus slots */
+#define LAMEBUS_IPI_BIT  0x00000800	/* inter-processor interrupt */
+#define MIPS_TIMER_BIT   0x00008000	/* on-chip timer */
+
+/* Cycles per hardclock. */
+#define TIMER_PERIOD (CPU_FREQUENCY / HZ)
+
+/*
+ * How close (in cycles) to the timer firing we're willing to
+ * reprogram it. Closer than this and it might fire before the new
+ * value lands, after which it wouldn't fire again until c0_count
+ * wrapped around, almost three minutes later.
+ */
+#define TIMER_SLOP 1000
+
+/* What start.S sets c0_compare to before we get control. */
+#define TIMER_BOOTCOMPARE 100000
+
+/*
+ * Cycle counting. c0_count starts over from 0 each time the timer
+ * fires (see below), so to count cycles since a cpu started we add
+ * the value c0_compare had to a running total at each timer
+ * interrupt. These are indexed by cpu number and only touched by
+ * that cpu, with interrupts off.
+ */
+static uint64_t timer_base[LB_NSLOTS];	/* cycles up to last interrupt */
+static uint32_t timer_compare[LB_NSLOTS];	/* c0_compare as last set */
+
 /*
  * Access to the on-chip timer.
  *
@@ -64,6 +93,8 @@ static
 void
 mips_timer_set(uint32_t count)
 {
+	timer_compare[curcpu->c_number] = count;
+
 	/*
 	 * $11 == c0_compare; we can't use the symbolic name inside
 	 * the asm string.
@@ -76,6 +107,43 @@ mips_timer_set(uint32_t count)
 		:: "r" (count));
 }
 
+/*
+ * Read c0_count ($9).
+ *
+ * On System/161 the count starts over from 0 when it reaches
+ * c0_compare; that's why hardclock can reload the same value every
+ * time. So between timer interrupts, c0_count is the number of
+ * cycles since the last one.
+ */
+static
+uint32_t
+mips_timer_get(void)
+{
+	uint32_t count;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* do it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
+/*
+ * Check if the timer interrupt is already asserted. Writing
+ * c0_compare would clear it, losing a tick.
+ */
+static
+bool
+mips_timer_pending(void)
+{
+	uint32_t cause;
+
+	__asm volatile("mfc0 %0, $13" : "=r" (cause));	/* c0_cause */
+	return (cause & MIPS_TIMER_BIT) != 0;
+}
+
 /*
  * LAMEbus data for the system. (We have only one LAMEbus per system.)
  * This does not need to be locked, because it's constant once
@@ -86,9 +154,16 @@ static struct lamebus_softc *lamebus;
 void
 mainbus_bootstrap(void)
 {
+	unsigned i;
+
 	/* Interrupts should be off (and have been off since startup) */
 	KASSERT(curthread->t_curspl > 0);
 
+	/* Every cpu's timer starts out the way start.S left it. */
+	for (i=0; i<LB_NSLOTS; i++) {
+		timer_compare[i] = TIMER_BOOTCOMPARE;
+	}
+
 	/* Initialize the system LAMEbus data */
 	lamebus = lamebus_init();
 
@@ -116,7 +191,7 @@ mainbus_bootstrap(void)
 	/*
 	 * Configure the MIPS on-chip timer to interrupt HZ times a second.
 	 */
-	mips_timer_set(CPU_FREQUENCY / HZ);
+	mips_timer_set(TIMER_PERIOD);
 }
 
 /*
@@ -285,14 +360,100 @@ mainbus_debugger(void)
 	ltrace_stop(0);
 }
 
+/*
+ * Tickless idle support: stretch or restore the gap until this cpu's
+ * next timer interrupt. See hardclock_idle() in clock.c.
+ *
+ * mainbus_timer_defer makes the next timer interrupt come TICKS
+ * hardclock periods from the last tick boundary instead of one. It
+ * returns false, changing nothing, if the next tick is already
+ * pending or too close to move.
+ *
+ * mainbus_timer_undefer goes back to interrupting at the next tick
+ * boundary and stores in *ELAPSED the number of ticks since the last
+ * timer interrupt that will now never be delivered. It returns false,
+ * changing nothing, if the deferred interrupt is already pending; it
+ * will then arrive as soon as interrupts are enabled.
+ *
+ * Both must be called with interrupts off.
+ */
+bool
+mainbus_timer_defer(unsigned ticks)
+{
+	uint32_t now, next;
+
+	KASSERT(curthread->t_curspl > 0);
+	KASSERT(ticks > 0 && ticks <= 0xffffffffU / TIMER_PERIOD - 1);
+
+	if (mips_timer_pending()) {
+		return false;
+	}
+	now = mips_timer_get();
+	if (TIMER_PERIOD - now % TIMER_PERIOD < TIMER_SLOP) {
+		return false;
+	}
+	next = (now / TIMER_PERIOD + ticks) * TIMER_PERIOD;
+	mips_timer_set(next);
+	return true;
+}
+
+bool
+mainbus_timer_undefer(unsigned *elapsed)
+{
+	uint32_t now, ticks;
+
+	KASSERT(curthread->t_curspl > 0);
+
+	if (mips_timer_pending()) {
+		return false;
+	}
+	now = mips_timer_get();
+	ticks = now / TIMER_PERIOD;
+	if (TIMER_PERIOD - now % TIMER_PERIOD < TIMER_SLOP) {
+		/* Too close to this boundary; skip it too. */
+		ticks++;
+	}
+	mips_timer_set((ticks + 1) * TIMER_PERIOD);
+	*elapsed = ticks;
+	return true;
+}
+
+/*
+ * Return the number of cycles this cpu has executed since it started
+ * (more or less; it's exact relative to itself, which is what's
+ * needed). Cheap: no bus access.
+ */
+uint64_t
+mainbus_cycles(void)
+{
+	unsigned n;
+	uint32_t count;
+	uint64_t ret;
+	int spl;
+
+	spl = splhigh();
+	n = curcpu->c_number;
+	count = mips_timer_get();
+	if (mips_timer_pending()) {
+		/*
+		 * The timer has fired and c0_count has started over,
+		 * but we haven't taken the interrupt yet. Read the
+		 * count again, in case it started over after we
+		 * read it, and account for the last period ourselves.
+		 */
+		ret = timer_base[n] + timer_compare[n] + mips_timer_get();
+	}
+	else {
+		ret = timer_base[n] + count;
+	}
+	splx(spl);
+	return ret;
+}
+
 /*
  * Interrupt dispatcher.
  */
 
-/* Wiring of LAMEbus interrupts to bits in the cause register */
-#define LAMEBUS_IRQ_BIT  0x00000400	/* all system bus slots */
-#define LAMEBUS_IPI_BIT  0x00000800	/* inter-processor interrupt */
-#define MIPS_TIMER_BIT   0x00008000	/* on-chip timer */
 
 void
 mainbus_interrupt(struct trapframe *tf)
@@ -314,8 +475,10 @@ mainbus_interrupt(struct trapframe *tf)
 		seen = true;
 	}
 	if (cause & MIPS_TIMER_BIT) {
+		/* Count the cycles up to now */
+		timer_base[curcpu->c_number] += timer_compare[curcpu->c_number];
 		/* Reset the timer (this clears the interrupt) */
-		mips_timer_set(CPU_FREQUENCY / HZ);
+		mips_timer_set(TIMER_PERIOD);
 		/* and call hardclock */
 		hardclock();
 		seen = true;
@@ -58,6 +58,7 @@
 #include <generic/console.h>
 #include <vfs.h>
 #include <device.h>
+#include <membar.h>
 #include "autoconf.h"
 
 /*
@@ -134,21 +135,70 @@ putch_intr(struct con_softc *cs, int ch)
 }
 
 /*
- * Read a character, using interrupts to wait for I/O completion.
+ * Take the next character from the input buffer, once we have done
+ * a P on cs_rsem for it.
  */
 static
 int
-getch_intr(struct con_softc *cs)
+getch_take(struct con_softc *cs)
 {
 	unsigned char ret;
 
-	P(cs->cs_rsem);
 	ret = cs->cs_gotchars[cs->cs_gotchars_tail];
 	cs->cs_gotchars_tail =
 		(cs->cs_gotchars_tail + 1) % CONSOLE_INPUT_BUFFER_SIZE;
 	return ret;
 }
 
+/*
+ * Read a character, using interrupts to wait for I/O completion.
+ */
+static
+int
+getch_intr(struct con_softc *cs)
+{
+	P(cs->cs_rsem);
+	return getch_take(cs);
+}
+
+/*
+ * Read a character that has already come in, or return -1 if none
+ * has.
+ */
+static
+int
+getch_nowait(struct con_softc *cs)
+{
+	if (!tryP(cs->cs_rsem)) {
+		return -1;
+	}
+	return getch_take(cs);
+}
+
+/*
+ * Input work, queued by con_input. V the read semaphore once for
+ * each character that has arrived since the last time. A burst of
+ * input that arrives before the worker runs is posted in one pass.
+ */
+static
+void
+con_inputwork(void *vcs)
+{
+	struct con_softc *cs = vcs;
+	bool any = false;
+
+	while (cs->cs_gotchars_posted != cs->cs_gotchars_head) {
+		cs->cs_gotchars_posted =
+			(cs->cs_gotchars_posted + 1) %
+			CONSOLE_INPUT_BUFFER_SIZE;
+		V(cs->cs_rsem);
+		any = true;
+	}
+	if (any) {
+		pollhead_wakeup(&cs->cs_readph);
+	}
+}
+
 /*
  * Called from underlying device when a read-ready interrupt occurs.
  *
@@ -173,7 +223,7 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars[cs->cs_gotchars_head] = ch;
 	cs->cs_gotchars_head = nexthead;
 
-	V(cs->cs_rsem);
+	queue_work(&cs->cs_inputwork);
 }
 
 /*
@@ -244,9 +294,10 @@ static
 int
 con_io(struct device *dev, struct uio *uio)
 {
-	int result;
+	int result, r;
 	char ch;
 	struct lock *lk;
+	size_t start;
 
 	(void)dev;  // unused
 
@@ -260,9 +311,22 @@ con_io(struct device *dev, struct uio *uio)
 	KASSERT(lk != NULL);
 	lock_acquire(lk);
 
+	start = uio->uio_resid;
 	while (uio->uio_resid > 0) {
 		if (uio->uio_rw==UIO_READ) {
-			ch = getch();
+			if (curthread->t_nowait) {
+				/* Return what there is rather than wait. */
+				r = getch_nowait(the_console);
+				if (r < 0) {
+					lock_release(lk);
+					return uio->uio_resid < start ?
+						0 : EAGAIN;
+				}
+				ch = r;
+			}
+			else {
+				ch = getch();
+			}
 			if (ch=='\r') {
 				ch = '\n';
 			}
@@ -302,10 +366,33 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * There is input to read if some has been posted that nobody has
+ * taken yet. Output never waits for long, so it's always ready.
+ */
+static
+int
+con_poll(struct device *dev, int events, struct pollentry *pe)
+{
+	struct con_softc *cs = dev->d_data;
+	int revents = 0;
+
+	if (events & POLLIN) {
+		/* Pairs with the barrier in pollhead_wakeup. */
+		pollwait(pe, &cs->cs_readph);
+		membar_any_any();
+		if (cs->cs_gotchars_posted != cs->cs_gotchars_tail) {
+			revents |= POLLIN;
+		}
+	}
+	return revents | (events & POLLOUT);
+}
+
 static const struct device_ops console_devops = {
 	.devop_eachopen = con_eachopen,
 	.devop_io = con_io,
 	.devop_ioctl = con_ioctl,
+	.devop_poll = con_poll,
 };
 
 static
@@ -386,6 +473,9 @@ config_con(struct con_softc *cs, int unit)
 	cs->cs_wsem = wsem;
 	cs->cs_gotchars_head = 0;
 	cs->cs_gotchars_tail = 0;
+	cs->cs_gotchars_posted = 0;
+	work_init(&cs->cs_inputwork, con_inputwork, cs);
+	pollhead_init(&cs->cs_readph);
 
 	the_console = cs;
 	con_userlock_read = rlk;
@@ -30,6 +30,9 @@
 #ifndef _GENERIC_CONSOLE_H_
 #define _GENERIC_CONSOLE_H_
 
+#include <workqueue.h>
+#include <poll.h>
+
 /*
  * Device data for the hardware-independent system console.
  *
@@ -51,6 +54,9 @@ struct con_softc {
 	unsigned char cs_gotchars[CONSOLE_INPUT_BUFFER_SIZE];
 	unsigned cs_gotchars_head;	/* next slot to put a char in */
 	unsigned cs_gotchars_tail;	/* next slot to take a char out */
+	unsigned cs_gotchars_posted;	/* next slot not yet V'd on cs_rsem */
+	struct work cs_inputwork;	/* posts input, deferred from con_input */
+	struct pollhead cs_readph;	/* pollers waiting for input */
 };
 
 /*
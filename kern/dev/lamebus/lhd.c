@@ -104,6 +104,19 @@ void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
 	lh->lh_result = err;
+	queue_work(&lh->lh_donework);
+}
+
+/*
+ * Completion work, queued by lhd_irq. Wakes the thread waiting for
+ * the I/O from the workqueue rather than from the interrupt handler.
+ */
+static
+void
+lhd_donework(void *vlh)
+{
+	struct lhd_softc *lh = vlh;
+
 	V(lh->lh_done);
 }
 
@@ -296,6 +309,8 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 		return ENOMEM;
 	}
 
+	work_init(&lh->lh_donework, lhd_donework, lh);
+
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_ops = &lhd_devops;
 	lh->lh_dev.d_blocks = bus_read_register(lh->lh_busdata, lh->lh_buspos,
@@ -18,6 +18,7 @@ struct addrspace 封装了一个进程的所有内存管理信息。每个进程
 #include "opt-dumbvm.h"   // 包含对“dumbvm”可选配置的引用
 
 struct vnode;             // 文件系统中的虚拟节点结构体声明
+struct astext;            // 共享只读代码页，由 VM 系统定义
 
 
 /*
@@ -42,6 +43,7 @@ vaddr_t (Virtual Address) 和 paddr_t (Physical Address) 分别存储这些区
         paddr_t as_pbase2;      // 第二个内存区域的物理基地址
         size_t as_npages2;      // 第二个内存区域的页数
         paddr_t as_stackpbase;  // 栈区域的物理基地址
+        struct astext *as_text1; // 非 NULL 时区域 1 是共享的只读代码页
 #else
         /* 在这里放置你的 VM 系统的结构体成员 */
         /*
@@ -79,6 +81,25 @@ vaddr_t (Virtual Address) 和 paddr_t (Physical Address) 分别存储这些区
  * （通常在 as_complete_load() *之后* 调用。）返回新进程的初始栈指针。
  在地址空间的顶部设置栈区域。它还会返回新进程的初始栈指针（initstackptr），这是程序开始执行所必需的。
  *
+ * as_stackwindow - 确保栈顶的物理页已经分配，并返回一个内核虚拟地址
+ * 窗口：*KTOP 对应 USERSTACK，向下 *LEN 字节是连续可写的。用于在地址
+ * 空间还不是当前地址空间时（例如 execv 装入新程序之前）直接往新栈里
+ * 写参数，省掉先复制到内核缓冲区再 copyout 的一次复制。
+ *
+ * 共享只读代码（同一个程序的多个进程共用一份代码页）：
+ *
+ * as_share_text - 把 AS 中从 VADDR 开始、已经装好的区域变成共享的只读
+ * 代码，返回一个新的引用。之后这个区域不能再写。不支持时返回 ENOSYS。
+ *
+ * as_define_text - 代替 as_define_region：在 AS 中定义一个区域，直接映射
+ * 共享代码 TEXT（自己拿一个引用），不需要再装入。
+ *
+ * as_text_hold - 增加 TEXT 的一个引用。
+ *
+ * as_text_release - 释放一个引用；最后一个引用释放时回收代码页。
+ *
+ * as_text_users - 当前持有 TEXT 引用的数量，用于统计。
+ *
  * 注意：当使用 dumbvm 时，addrspace.c 不被使用，这些函数在 dumbvm.c 中。
  */
 
@@ -96,6 +117,16 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_stackwindow(struct addrspace *as, vaddr_t *ktop,
+                                 size_t *len);
+
+int               as_share_text(struct addrspace *as, vaddr_t vaddr,
+                                struct astext **ret);
+int               as_define_text(struct addrspace *as, vaddr_t vaddr,
+                                 size_t sz, struct astext *text);
+void              as_text_hold(struct astext *text);
+void              as_text_release(struct astext *text);
+unsigned          as_text_users(struct astext *text);
 
 
 /*
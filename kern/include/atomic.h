@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _ATOMIC_H_
+#define _ATOMIC_H_
+
+/*
+ * Atomic operations.
+ *
+ * An atomic_t is an integer that can be updated by several CPUs at
+ * once without a spinlock. This is meant for counters, reference
+ * counts, and flag words that are touched often and need nothing
+ * more than a single-word update; anything that has to keep two
+ * fields consistent with each other still needs a lock.
+ *
+ * atomic_read and atomic_set are plain loads and stores (which are
+ * atomic on every machine we support) and are not ordered.
+ *
+ * atomic_inc, atomic_dec, atomic_bit_set, and atomic_bit_clear are
+ * atomic but not ordered with respect to other memory accesses; use
+ * them for statistics and the like.
+ *
+ * All operations that return a value (atomic_fetch_add,
+ * atomic_add_return, atomic_dec_and_test, atomic_add_unless,
+ * atomic_xchg, atomic_cas, atomic_bit_testandset, and
+ * atomic_bit_testandclear) are full memory barriers, so they can be
+ * used for reference counting and handing off ownership.
+ *
+ * atomic_cas returns the value found; the swap happened if and only
+ * if that equals OLDVAL.
+ *
+ * The bit operations work on a plain uint32_t word. BIT must be less
+ * than 32.
+ */
+
+#include <cdefs.h>
+#include <membar.h>
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef ATOMIC_INLINE
+#define ATOMIC_INLINE INLINE
+#endif
+
+typedef struct {
+	volatile uint32_t a_val;
+} atomic_t;
+
+#define ATOMIC_INITIALIZER(v)	{ (uint32_t)(v) }
+
+/* Get the machine-dependent word operations. */
+#include <machine/atomic.h>
+
+ATOMIC_INLINE int atomic_read(const atomic_t *a);
+ATOMIC_INLINE void atomic_set(atomic_t *a, int val);
+ATOMIC_INLINE void atomic_inc(atomic_t *a);
+ATOMIC_INLINE void atomic_dec(atomic_t *a);
+ATOMIC_INLINE int atomic_fetch_add(atomic_t *a, int delta);
+ATOMIC_INLINE int atomic_add_return(atomic_t *a, int delta);
+ATOMIC_INLINE bool atomic_dec_and_test(atomic_t *a);
+ATOMIC_INLINE bool atomic_add_unless(atomic_t *a, int delta, int unless);
+ATOMIC_INLINE int atomic_xchg(atomic_t *a, int newval);
+ATOMIC_INLINE int atomic_cas(atomic_t *a, int oldval, int newval);
+
+ATOMIC_INLINE void atomic_bit_set(volatile uint32_t *w, unsigned bit);
+ATOMIC_INLINE void atomic_bit_clear(volatile uint32_t *w, unsigned bit);
+ATOMIC_INLINE bool atomic_bit_testandset(volatile uint32_t *w, unsigned bit);
+ATOMIC_INLINE bool atomic_bit_testandclear(volatile uint32_t *w, unsigned bit);
+
+////////////////////////////////////////////////////////////
+
+ATOMIC_INLINE
+int
+atomic_read(const atomic_t *a)
+{
+	return (int)a->a_val;
+}
+
+ATOMIC_INLINE
+void
+atomic_set(atomic_t *a, int val)
+{
+	a->a_val = (uint32_t)val;
+}
+
+ATOMIC_INLINE
+void
+atomic_inc(atomic_t *a)
+{
+	atomic_data_fetchadd(&a->a_val, 1);
+}
+
+ATOMIC_INLINE
+void
+atomic_dec(atomic_t *a)
+{
+	atomic_data_fetchadd(&a->a_val, (uint32_t)-1);
+}
+
+ATOMIC_INLINE
+int
+atomic_fetch_add(atomic_t *a, int delta)
+{
+	uint32_t old;
+
+	membar_any_any();
+	old = atomic_data_fetchadd(&a->a_val, (uint32_t)delta);
+	membar_any_any();
+	return (int)old;
+}
+
+ATOMIC_INLINE
+int
+atomic_add_return(atomic_t *a, int delta)
+{
+	return atomic_fetch_add(a, delta) + delta;
+}
+
+/*
+ * Decrement and return true if the result is zero.
+ */
+ATOMIC_INLINE
+bool
+atomic_dec_and_test(atomic_t *a)
+{
+	return atomic_fetch_add(a, -1) == 1;
+}
+
+/*
+ * Add DELTA unless the value is UNLESS. Returns true if the add was
+ * done. This is the shape of "drop a reference, unless it's the last
+ * one", which is what the VOP_RECLAIM paths need.
+ */
+ATOMIC_INLINE
+bool
+atomic_add_unless(atomic_t *a, int delta, int unless)
+{
+	uint32_t old, seen;
+
+	membar_any_any();
+	old = a->a_val;
+	while (old != (uint32_t)unless) {
+		seen = atomic_data_cas(&a->a_val, old, old + (uint32_t)delta);
+		if (seen == old) {
+			membar_any_any();
+			return true;
+		}
+		old = seen;
+	}
+	return false;
+}
+
+ATOMIC_INLINE
+int
+atomic_xchg(atomic_t *a, int newval)
+{
+	uint32_t old;
+
+	membar_any_any();
+	old = atomic_data_swap(&a->a_val, (uint32_t)newval);
+	membar_any_any();
+	return (int)old;
+}
+
+ATOMIC_INLINE
+int
+atomic_cas(atomic_t *a, int oldval, int newval)
+{
+	uint32_t old;
+
+	membar_any_any();
+	old = atomic_data_cas(&a->a_val, (uint32_t)oldval, (uint32_t)newval);
+	membar_any_any();
+	return (int)old;
+}
+
+ATOMIC_INLINE
+void
+atomic_bit_set(volatile uint32_t *w, unsigned bit)
+{
+	atomic_data_fetchor(w, (uint32_t)1 << bit);
+}
+
+ATOMIC_INLINE
+void
+atomic_bit_clear(volatile uint32_t *w, unsigned bit)
+{
+	atomic_data_fetchand(w, ~((uint32_t)1 << bit));
+}
+
+/*
+ * Set BIT and return whether it was already set.
+ */
+ATOMIC_INLINE
+bool
+atomic_bit_testandset(volatile uint32_t *w, unsigned bit)
+{
+	uint32_t mask = (uint32_t)1 << bit;
+	uint32_t old;
+
+	membar_any_any();
+	old = atomic_data_fetchor(w, mask);
+	membar_any_any();
+	return (old & mask) != 0;
+}
+
+/*
+ * Clear BIT and return whether it was set.
+ */
+ATOMIC_INLINE
+bool
+atomic_bit_testandclear(volatile uint32_t *w, unsigned bit)
+{
+	uint32_t mask = (uint32_t)1 << bit;
+	uint32_t old;
+
+	membar_any_any();
+	old = atomic_data_fetchand(w, ~mask);
+	membar_any_any();
+	return (old & mask) != 0;
+}
+
+
+#endif /* _ATOMIC_H_ */
@@ -58,6 +58,13 @@ void          *bitmap_getdata(struct bitmap *);
 */
 int            bitmap_alloc(struct bitmap *, unsigned *index);
 /*
+bitmap_alloc_from(struct bitmap *, unsigned start, unsigned *index)	分配资源
+与 bitmap_alloc 相同，但从 start 开始查找，到末尾后回绕。
+用于按游标循环分配编号（例如 PID），避免每次从头扫描。
+*/
+int            bitmap_alloc_from(struct bitmap *, unsigned start,
+                                 unsigned *index);
+/*
 bitmap_mark(struct bitmap *, unsigned index)	设置/占用	
 设置（mark，置为 1）索引 index 处的位。这通常在资源被手动分配后使用。	
 将某个已知的空闲位标记为已占用
@@ -69,9 +76,11 @@ bitmap_mark(struct bitmap *, unsigned index)	设置/占用
 这通常在资源被手动分配后使用。	将某个已知的空闲位标记为已占用
 */
 void           bitmap_unmark(struct bitmap *, unsigned index);
+/*
 bitmap_isset(struct bitmap *, unsigned index)	检查状态	
 检查索引 index 处的位是否已设置（返回非零表示已设置，即已占用）。	
 在使用资源前检查它是否真的被占用。
+*/
 int            bitmap_isset(struct bitmap *, unsigned index);
 /*
 bitmap_destroy(struct bitmap *)	销毁/释放	
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _CALLOUT_H_
+#define _CALLOUT_H_
+
+/*
+ * Callouts: functions to be called a given number of hardclocks in
+ * the future.
+ *
+ * Each cpu keeps its pending callouts in a hierarchical timing
+ * wheel, advanced by hardclock. Scheduling and cancelling a callout
+ * are O(1); each callout is moved between wheel levels at most
+ * CALLOUT_LEVELS-1 times before it fires.
+ *
+ * Callout functions run from hardclock, in interrupt context, on the
+ * cpu the callout was scheduled on. They must not sleep.
+ *
+ * Functions:
+ *     callout_init     - set up a callout to call FUNC(ARG).
+ *     callout_schedule - arrange for the callout to fire TICKS
+ *                        hardclocks from now, on the current cpu.
+ *                        It must not already be pending.
+ *     callout_cancel   - make sure the callout won't fire. Returns
+ *                        true if it was still pending; false if it
+ *                        had fired already. If the function is
+ *                        running on another cpu, waits for it to
+ *                        finish.
+ *
+ * The rest is called from the clock code:
+ *     callout_hardclock - run the callouts due by tick NOW.
+ *     callout_idleticks - how many ticks this cpu can skip while
+ *                         idle without missing a callout, up to MAX.
+ */
+
+#include <spinlock.h>
+
+#define CALLOUT_LEVELBITS	6
+#define CALLOUT_SLOTS		(1U << CALLOUT_LEVELBITS)	/* per level */
+#define CALLOUT_LEVELS		4	/* 2^24 ticks, ~46 hours at HZ=100 */
+
+struct callout_wheel;
+
+struct callout {
+	struct callout *co_next;	/* link in wheel slot */
+	struct callout **co_prevp;	/* pointer to the link to us */
+	struct callout_wheel *co_wheel;	/* wheel last scheduled on */
+	bool co_pending;		/* on co_wheel, not yet fired */
+	unsigned co_expire;		/* tick at which to fire */
+	void (*co_func)(void *);
+	void *co_arg;
+};
+
+struct callout_wheel {
+	struct spinlock cw_lock;
+	unsigned cw_next;		/* next tick to process */
+	unsigned cw_count;		/* pending callouts */
+	struct callout *cw_running;	/* callout whose function is running */
+	struct callout *cw_slots[CALLOUT_LEVELS][CALLOUT_SLOTS];
+};
+
+void callout_init(struct callout *co, void (*func)(void *), void *arg);
+void callout_schedule(struct callout *co, unsigned ticks);
+bool callout_cancel(struct callout *co);
+
+void callout_wheel_init(struct callout_wheel *cw, unsigned now);
+void callout_hardclock(unsigned now);
+unsigned callout_idleticks(unsigned max);
+
+
+#endif /* _CALLOUT_H_ */
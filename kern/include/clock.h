@@ -11,7 +11,11 @@
 
 
 /*
- * hardclock() 在每个 CPU 上每秒被调用 HZ 次，可能只在 CPU 不空闲时调用，用于调度。
+ * hardclock() 在每个 CPU 上每秒被调用 HZ 次，只在 CPU 不空闲时调用，用于调度。
+ *
+ * 空闲循环在进入 cpu_idle() 之前调用 hardclock_idle() 暂停时钟节拍
+ * （tickless idle），醒来后调用 hardclock_unidle() 恢复周期节拍，
+ * 并把跳过的节拍计入 c_hardclocks 和 c_ticks_skipped。
  */
 
 /* 每秒 hardclock 调用的次数 */
@@ -19,6 +23,8 @@
 
 void hardclock_bootstrap(void); // hardclock 的初始化
 void hardclock(void);           // 每次时钟中断时调用的函数（用于调度）
+void hardclock_idle(void);      // 空闲前：推迟下一次时钟中断
+void hardclock_unidle(void);    // 醒来后：恢复周期时钟中断
 
 /*
  * timerclock() 每秒在单个 CPU 上调用一次，用于简单的定时操作。
@@ -31,6 +37,22 @@ void timerclock(void);
  */
 void gettime(struct timespec *ret);
 
+/*
+ * 高精度时钟（clocksource）。
+ *
+ * 用 CPU 周期计数器（mainbus_cycles()）计时，不需要访问总线，因此很便宜。
+ * clocksource_bootstrap() 在启动时对照 rtclock 校准周期计数器的频率；
+ * clocksource_hatch() 在每个 CPU 上计算该 CPU 的偏移量，使所有 CPU
+ * 读到的时间一致（误差在一次 rtclock 读取之内）。
+ *
+ * clock_monotonic_ns() 返回自启动以来的纳秒数，在同一个 CPU 上永不倒退。
+ * clock_realtime() 返回启动时的日历时间加上单调时钟，是 gettime() 的快速版本。
+ */
+void clocksource_bootstrap(void);
+void clocksource_hatch(void);
+uint64_t clock_monotonic_ns(void);
+void clock_realtime(struct timespec *ret);
+
 /*
  * 时间算术运算
  *
@@ -48,8 +70,12 @@ void timespec_sub(const struct timespec *t1,
 /*
  * clocksleep() 暂停执行所请求的秒数，类似于用户级的 sleep(3)。
  * （不要与 wchan_sleep 混淆。）
+ *
+ * clocksleep_ticks() 暂停执行所请求的 hardclock 节拍数（每秒 HZ 个）。
+ * 两者都基于每 CPU 的定时轮（见 callout.h），精度为一个节拍。
  */
 void clocksleep(int seconds);
+void clocksleep_ticks(unsigned ticks);
 
 
 #endif /* _CLOCK_H_ */
@@ -1,4 +1,4 @@
-#kernel/userland data copy
+/* kernel/userland data copy */
 
 #ifndef _COPYINOUT_H_
 #define _COPYINOUT_H_
@@ -19,6 +19,10 @@
  * 用户空间地址 USERDEST，并在 GOT 中返回找到的实际字符串长度。成功时
  * USERDEST 总是空终止的。LEN 和 GOT 都包含空终止符。
  *
+ * copyinstrlen 只求出用户空间地址 USERSRC 处字符串的长度（包含空终止符，
+ * 在 ACTUAL 中返回），不复制；出错条件与 copyinstr 相同。用于先确定目标
+ * 位置，再把字符串直接复制过去。
+ *
  * 所有这些函数：
  * - 成功时返回 0。
  * - 如果遇到内存寻址错误，返回 EFAULT。
@@ -35,6 +39,7 @@ int copyin(const_userptr_t usersrc, void *dest, size_t len);
 int copyout(const void *src, userptr_t userdest, size_t len);
 int copyinstr(const_userptr_t usersrc, char *dest, size_t len, size_t *got);
 int copyoutstr(const char *src, userptr_t userdest, size_t len, size_t *got);
+int copyinstrlen(const_userptr_t usersrc, size_t len, size_t *actual);
 
 
 #endif /* _COPYINOUT_H_ */
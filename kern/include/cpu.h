@@ -4,7 +4,11 @@
 #define _CPU_H_
 
 
+#include <atomic.h>       // 包含原子操作定义
+#include <callout.h>      // 包含定时轮（callout）定义
+#include <workqueue.h>    // 包含工作队列定义
 #include <spinlock.h>     // 包含自旋锁定义
+#include <thread.h>       // 包含 CPUTIME_* 定义
 #include <threadlist.h>   // 包含线程列表定义
 #include <machine/vm.h>   /* for TLBSHOOTDOWN_MAX */
 
@@ -32,7 +36,44 @@ struct cpu {
 	struct thread *c_curthread;	/* CPU 上当前运行的线程 */
 	struct threadlist c_zombies;	/* 已退出线程的列表 */
 	unsigned c_hardclocks;		/* hardclock() 调用计数器 */
+	unsigned c_lastboost;		/* 上次优先级提升（schedule）时的 c_hardclocks */
+	unsigned c_ticks_deferred;	/* 空闲时推迟的节拍数，0 表示周期模式 */
+	unsigned c_ticks_skipped;	/* 因空闲而跳过的节拍总数 */
+	int64_t c_clock_offset;		/* 本 CPU 周期计数换算成的纳秒 + 此值 = 单调时钟 */
 	unsigned c_spinlocks;		/* 持有的自旋锁计数器 */
+	struct thread *c_migrating;	/* 切换后要送往其他 CPU 的线程 */
+	unsigned c_handoffs;		/* 直接交接（wchan_wakeone_sync）次数 */
+	void *c_stacks[STACK_CACHE];	/* 可重用的空闲内核栈（栈底魔数已写好） */
+	unsigned c_nstacks;		/* c_stacks 中的栈数 */
+	bool c_resched;			/* 有优先级更高的实时线程就绪，尽快让出 CPU */
+
+	/*
+	 * CPU 时间统计（纳秒），见 thread_cputime()。按 CPUTIME_* 状态分类。
+	 */
+	uint64_t c_cputime[CPUTIME_NSTATES];	/* 本 CPU 在各状态下的总时间 */
+	uint64_t c_acct_stamp;		/* 上次计时的单调时钟值 */
+	unsigned c_acct_state;		/* 当前所处的 CPUTIME_* 状态 */
+
+	/*
+	 * 唤醒统计，由发起唤醒的 CPU 计数。其他 CPU 只在打印统计时读取。
+	 */
+	unsigned c_wakeups;		/* 本 CPU 发起的唤醒次数 */
+	unsigned c_wakeups_remote;	/* 其中被唤醒线程放到其他 CPU 上的次数 */
+	unsigned c_wakeups_affine;	/* 其中把被唤醒线程拉到本 CPU 上的次数 */
+
+	/*
+	 * IPI 统计。发送和合并由发送方 CPU 计数，接收由目标 CPU 计数。
+	 */
+	unsigned c_ipi_sent;		/* 本 CPU 实际发出的 IPI 数 */
+	unsigned c_ipi_coalesced;	/* 因目标已有同类 IPI 待处理而省掉的次数 */
+	unsigned c_ipi_received;	/* 本 CPU 处理的 IPI 中断数 */
+
+	/*
+	 * 调度延迟直方图（对数刻度，见 SCHED_LATBUCKETS），在 thread_switch
+	 * 中由本 CPU 更新。其他 CPU 只在打印统计时读取和清零。
+	 */
+	unsigned c_waithist[SCHED_LATBUCKETS];	/* 就绪到开始运行的等待时间 */
+	unsigned c_runhist[SCHED_LATBUCKETS];	/* 每次上 CPU 连续运行的时间 */
 
 	/*
 	 * 被**其他 CPU** 访问的成员。
@@ -40,8 +81,30 @@ struct cpu {
 	 */
 	bool c_isidle;			/* 如果此 cpu 处于空闲状态，则为 True */
 	struct threadlist c_runqueue;	/* 此 cpu 的运行队列 */
+	struct thread *c_handoff;	/* 下次切换时直接运行的线程，不在运行队列中 */
 	struct spinlock c_runqueue_lock;
 
+	/*
+	 * 被**其他 CPU** 无锁读取的成员。
+	 *
+	 * c_load 是运行队列长度的提示值：持有 runqueue 锁修改队列后更新，
+	 * 空闲 CPU 在不获取任何锁的情况下读取它来挑选窃取对象。
+	 * 读到的值可能已经过时，拿到锁之后必须重新检查。
+	 */
+	atomic_t c_load;		/* 运行队列长度提示 */
+
+	/*
+	 * 被**其他 CPU** 访问的成员。
+	 * 受 c_callouts.cw_lock 保护（其他 CPU 可能取消这里的 callout）。
+	 */
+	struct callout_wheel c_callouts;	/* 本 CPU 的定时轮 */
+
+	/*
+	 * 被**其他 CPU** 访问的成员。
+	 * 受 c_workq.wq_lock 保护（中断处理程序把延迟工作放到这里）。
+	 */
+	struct workqueue c_workq;	/* 本 CPU 的工作队列 */
+
 	/*
 	 * 被**其他 CPU** 访问的成员。
 	 * 受 IPI 锁保护。
@@ -86,6 +149,17 @@ void cpu_hatch(unsigned software_number);       // CPU 启动完成后的 C 语
  */
 void cpu_identify(char *buf, size_t max);
 
+/*
+ * 打印每个 CPU 的调度统计信息（运行队列长度、唤醒计数等）。
+ */
+void cpu_printstats(void);
+
+/*
+ * 打印每个 CPU 的调度延迟直方图（就绪等待时间、连续运行时间），然后清零，
+ * 以便下次打印只反映这段时间内的情况。
+ */
+void cpu_printlatency(void);
+
 /*
  * 当前 CPU 的硬件级中断开启/关闭。
  *
@@ -116,7 +190,8 @@ void cpu_halt(void);
  * 当一个页被多个处理器映射在 MMU 中，并且该页正在被更改或需要
  * 在所有 CPU 上被失效时，VM 系统会执行 TLB 射击（shootdown）。
  *
- * ipi_send 向一个 CPU 发送 IPI。
+ * ipi_send 向一个 CPU 发送 IPI。如果目标上同类 IPI 已经待处理，
+ * 就不再重复发送（合并），因为目标处理它时会看到发送方之前做的修改。
  * ipi_broadcast 向除当前 CPU 之外的所有 CPU 广播 IPI。
  * ipi_tlbshootdown 类似于 ipi_send，但带有 TLB 射击数据。
  *
@@ -128,6 +203,7 @@ void cpu_halt(void);
 #define IPI_OFFLINE		1	/* 请求 CPU 下线 */
 #define IPI_UNIDLE		2	/* 有可运行的线程可用 */
 #define IPI_TLBSHOOTDOWN	3	/* MMU 映射需要失效 */
+#define IPI_RESCHED		4	/* 实时线程就绪，需要抢占当前线程 */
 
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
@@ -135,5 +211,10 @@ void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
 
 void interprocessor_interrupt(void);
 
+/*
+ * 汇总所有 CPU 的 IPI 计数（发出的和被合并掉的），供测试程序使用。
+ */
+void ipi_counts(unsigned *sent, unsigned *coalesced);
+
 
 #endif /* _CPU_H_ */
@@ -9,6 +9,7 @@
 
 
 struct uio;  /* 在 <uio.h> 中定义 (用于 I/O 描述符) */
+struct pollentry; /* 在 <poll.h> 中定义 */
 
 /*
  * 文件系统命名空间可访问的设备。
@@ -29,11 +30,14 @@ struct device {
  * devop_eachopen - 在每次 open 调用时被调用，允许拒绝打开操作
  * devop_io - 用于读取和写入（uio 指示方向）
  * devop_ioctl - 杂项控制操作
+ * devop_poll - 用于 poll/select，语义同 vop_poll（见 vnode.h）；
+ *              可以为 NULL，表示设备总是就绪
  */
 struct device_ops {
 	int (*devop_eachopen)(struct device *, int flags_from_open);
 	int (*devop_io)(struct device *, struct uio *);
 	int (*devop_ioctl)(struct device *, int op, userptr_t data);
+	int (*devop_poll)(struct device *, int events, struct pollentry *pe);
 };
 
 /*
@@ -42,6 +46,7 @@ struct device_ops {
 #define DEVOP_EACHOPEN(d, f)	((d)->d_ops->devop_eachopen(d, f))
 #define DEVOP_IO(d, u)		((d)->d_ops->devop_io(d, u))
 #define DEVOP_IOCTL(d, op, p)	((d)->d_ops->devop_ioctl(d, op, p))
+#define DEVOP_POLL(d, ev, pe)	((d)->d_ops->devop_poll(d, ev, pe))
 
 
 /* 为 VFS 级别的设备创建 vnode (虚拟节点)。 */
@@ -38,12 +38,24 @@ typedef struct {
 } Elf32_Ehdr;
 
 /* e_ident[] 中 1 字节字段的偏移量 */
-// ... (定义了 EI_MAG0 到 EI_PAD 的偏移量宏) ...
+#define	EI_MAG0		0	/* '\177' */
+#define	EI_MAG1		1	/* 'E' */
+#define	EI_MAG2		2	/* 'L' */
+#define	EI_MAG3		3	/* 'F' */
+#define	EI_CLASS	4	/* 文件类别 */
+#define	EI_DATA		5	/* 数据编码（字节序） */
+#define	EI_VERSION	6	/* ELF 版本 */
+#define	EI_OSABI	7	/* 操作系统/syscall ABI 标识 */
+#define	EI_ABIVERSION	8	/* syscall ABI 版本 */
+#define	EI_PAD		9	/* 从这里开始是填充 */
 
 /* 这些字段的值 */
 
 /* 对于 e_ident[EI_MAG0..3] (ELF 魔数) */
-// ... (定义了 ELFMAG0 到 ELFMAG3 的值宏) ...
+#define	ELFMAG0		'\177'
+#define	ELFMAG1		'E'
+#define	ELFMAG2		'L'
+#define	ELFMAG3		'F'
 
 /* 对于 e_ident[EI_CLASS] (文件类别) */
 #define	ELFCLASSNONE	0	/* 无效类别 */
@@ -60,7 +72,9 @@ typedef struct {
 #define	EV_CURRENT	1	/* 当前版本 */
 
 /* e_ident[EI_OSABI] (操作系统/syscall ABI 标识) */
-// ... (定义了 ELFOSABI_SYSV, ELFOSABI_HPUX, ELFOSABI_STANDALONE 的值宏) ...
+#define	ELFOSABI_SYSV		0	/* UNIX System V ABI */
+#define	ELFOSABI_HPUX		1	/* HP-UX 操作系统 */
+#define	ELFOSABI_STANDALONE	255	/* 独立（嵌入式）应用 */
 
 
 /*
@@ -71,12 +85,20 @@ typedef struct {
 #define	ET_EXEC		2	/* 可执行文件 */
 #define	ET_DYN		3	/* 共享对象文件 */
 #define	ET_CORE		4	/* 核心转储文件 */
-// ...
+#define	ET_NUM		5	/* 类型数量 */
 
 /*
  * e_machine 的值 (处理器类型)
  */
-// ... (定义了 EM_NONE, EM_MIPS 等处理器类型的值宏) ...
+#define	EM_NONE		0	/* 无机器类型 */
+#define	EM_M32		1	/* AT&T WE 32100 */
+#define	EM_SPARC	2	/* SPARC */
+#define	EM_386		3	/* Intel 80386 */
+#define	EM_68K		4	/* Motorola 68000 */
+#define	EM_88K		5	/* Motorola 88000 */
+#define	EM_486		6	/* Intel 80486 */
+#define	EM_860		7	/* Intel 80860 */
+#define	EM_MIPS		8	/* MIPS RS3000 */
 
 
 /*
@@ -99,7 +121,14 @@ typedef struct {
 /* p_type 的值 (段类型) */
 #define	PT_NULL		0		/* 程序头表条目未使用 */
 #define	PT_LOAD		1		/* 可加载程序段 */
-// ... (定义了 PT_DYNAMIC, PT_INTERP 等其他段类型的值宏) ...
+#define	PT_DYNAMIC	2		/* 动态链接信息 */
+#define	PT_INTERP	3		/* 程序解释器路径 */
+#define	PT_NOTE		4		/* 附加信息 */
+#define	PT_SHLIB	5		/* 保留 */
+#define	PT_PHDR		6		/* 程序头表本身 */
+#define	PT_LOPROC	0x70000000	/* 处理器相关类型的起点 */
+#define	PT_HIPROC	0x7fffffff	/* 处理器相关类型的终点 */
+#define	PT_MIPS_REGINFO	0x70000000	/* MIPS 寄存器使用信息 */
 
 /* p_flags 的值 (权限标志) */
 #define	PF_R		0x4	/* 段是可读的 */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _EXECCACHE_H_
+#define _EXECCACHE_H_
+
+/*
+ * Executable image cache.
+ *
+ * load_elf remembers, per vnode, the parsed ELF header and loadable
+ * program headers of the programs it loads, and (when the VM system
+ * supports it) the program's text as shared read-only pages. Loading
+ * the same program again skips reading the headers and maps the
+ * existing text instead of reading a private copy.
+ *
+ * Functions:
+ *     execcache_lookup  - copy out the image cached for V. Returns
+ *                         false on a miss. On a hit, if ei_text is
+ *                         not NULL the caller holds a reference to it
+ *                         and must drop it with as_text_release.
+ *     execcache_insert  - cache IMG for V. Consumes the caller's
+ *                         reference to IMG->ei_text, if any.
+ *     execcache_purge   - forget V; called when it is opened for
+ *                         writing and on each write. Cheap if V is
+ *                         not cached.
+ *     execcache_flush   - forget everything; called before unmount.
+ *     execcache_printstats - print hit/miss counts and pages saved.
+ */
+
+#include <elf.h>
+
+struct vnode;
+struct astext;
+
+/* Most PT_LOAD segments we handle; our executables have two or three. */
+#define EXECIMAGE_MAXSEGS	4
+
+struct execimage {
+	vaddr_t ei_entry;			/* entry point */
+	unsigned ei_nsegs;			/* number of PT_LOAD segments */
+	Elf_Phdr ei_segs[EXECIMAGE_MAXSEGS];
+	int ei_textseg;				/* shared segment, or -1 */
+	struct astext *ei_text;			/* shared text, or NULL */
+	size_t ei_textpages;			/* size of the text in pages */
+};
+
+bool execcache_lookup(struct vnode *v, struct execimage *img);
+void execcache_insert(struct vnode *v, const struct execimage *img);
+void execcache_purge(struct vnode *v);
+void execcache_flush(void);
+void execcache_printstats(void);
+
+#endif /* _EXECCACHE_H_ */
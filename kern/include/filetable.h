@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _FILETABLE_H_
+#define _FILETABLE_H_
+
+/*
+ * Per-process file descriptor table.
+ *
+ * A fixed array of OPEN_MAX openfile pointers, NULL for unused
+ * descriptors. Being fixed, it never moves, so a slot can be read
+ * without locking as long as nobody can change it at the same time.
+ *
+ * Only threads of the owning process change its table (open, close,
+ * dup2, exit) or look things up in it. In a single-threaded process
+ * (every process but one with a uring poller thread) that is just
+ * the caller, so filetable_get reads the slot without ft_lock and
+ * without taking a reference: the fast path for read and write is a
+ * bounds check and a load. When the process has more threads,
+ * filetable_get still doesn't take ft_lock: it takes a reference
+ * with openfile_tryincref and rechecks the slot, and filetable_put
+ * drops the reference. ft_lock is only for changing the table.
+ *
+ * Functions:
+ *     filetable_create  - make an empty table.
+ *     filetable_copy    - make a table sharing all of FT's openfiles,
+ *                         for fork and spawn.
+ *     filetable_destroy - drop every openfile and free the table.
+ *     filetable_place   - put OF in the lowest free descriptor.
+ *                         Consumes the caller's reference to OF.
+ *     filetable_placeat - put OF at descriptor FD, handing back what
+ *                         was there (or NULL) for the caller to drop.
+ *                         Consumes the caller's reference to OF.
+ *     filetable_remove  - empty descriptor FD, handing back its
+ *                         openfile for the caller to drop.
+ *     filetable_get     - look up FD. SHARED says whether other
+ *                         threads may use the table. Returns in *HELD
+ *                         whether a reference was taken.
+ *     filetable_put     - done with an openfile from filetable_get.
+ *
+ * Descriptors outside 0..OPEN_MAX-1 and empty ones are EBADF.
+ */
+
+#include <limits.h>
+#include <spinlock.h>
+
+struct openfile;
+
+struct filetable {
+	struct spinlock ft_lock;		/* for changing ft_files */
+	struct openfile *ft_files[OPEN_MAX];
+};
+
+struct filetable *filetable_create(void);
+int filetable_copy(struct filetable *ft, struct filetable **ret);
+void filetable_destroy(struct filetable *ft);
+int filetable_place(struct filetable *ft, struct openfile *of, int *fd);
+int filetable_placeat(struct filetable *ft, struct openfile *of, int fd,
+		      struct openfile **oldfile);
+int filetable_remove(struct filetable *ft, int fd, struct openfile **ret);
+int filetable_get(struct filetable *ft, int fd, bool shared,
+		  struct openfile **ret, bool *held);
+void filetable_put(struct openfile *of, bool held);
+
+#endif /* _FILETABLE_H_ */
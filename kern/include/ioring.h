@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _IORING_H_
+#define _IORING_H_
+
+/*
+ * Submission/completion rings, for uring_setup and uring_enter. The
+ * layout shared with user space is in <kern/uring.h>.
+ *
+ * A process has at most one ring, in its own memory. Requests are
+ * carried out by the ordinary system call code on behalf of the
+ * process: in uring_enter, or, with URING_SETUP_SQPOLL, by a poller
+ * thread that belongs to the process and spins on the submission
+ * queue while there is work, so that no system call is needed.
+ *
+ * Functions:
+ *     ioring_pause   - stop PROC's ring from touching user memory
+ *                      until ioring_resume. Used around exec_load,
+ *                      which swaps the address space.
+ *     ioring_resume  - undo ioring_pause.
+ *     ioring_destroy - stop the poller, if any, and free PROC's ring.
+ *                      PROC must be the current process; it may be
+ *                      paused.
+ *
+ * All three do nothing if PROC has no ring.
+ */
+
+struct proc;
+
+void ioring_pause(struct proc *proc);
+void ioring_resume(struct proc *proc);
+void ioring_destroy(struct proc *proc);
+
+#endif /* _IORING_H_ */
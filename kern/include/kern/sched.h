@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2003, 2008
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_SCHED_H_
+#define _KERN_SCHED_H_
+
+/*
+ * Definitions for sched_setscheduler() and sched_getscheduler().
+ */
+
+
+/* Scheduling policies. */
+#define SCHED_OTHER	0	/* Time-sharing (the default). */
+#define SCHED_RR	1	/* Fixed-priority real-time, round robin. */
+
+/* Real-time priorities; higher runs first. */
+#define SCHED_RT_MINPRIO	1
+#define SCHED_RT_MAXPRIO	16
+
+/*
+ * Parameters for SCHED_RR. A real-time thread may run for up to
+ * sched_runtime microseconds in each sched_period microseconds
+ * ahead of time-sharing threads; past that it competes as an
+ * ordinary thread until its next period. Ignored for SCHED_OTHER.
+ */
+struct sched_param {
+	int sched_priority;		/* SCHED_RT_MINPRIO..SCHED_RT_MAXPRIO */
+	unsigned sched_runtime;		/* Budget per period (us). */
+	unsigned sched_period;		/* Period (us). */
+};
+
+/* Longest sched_period accepted (us). */
+#define SCHED_RT_MAXPERIOD	10000000
+
+#endif /* _KERN_SCHED_H_ */
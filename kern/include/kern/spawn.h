@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2003, 2008
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_SPAWN_H_
+#define _KERN_SPAWN_H_
+
+/*
+ * Definitions for spawn().
+ */
+
+
+/* File action operations. */
+#define SPAWN_END	0	/* End of the action list. */
+#define SPAWN_CLOSE	1	/* close(sfa_fd) */
+#define SPAWN_DUP2	2	/* dup2(sfa_srcfd, sfa_fd) */
+#define SPAWN_OPEN	3	/* open(sfa_path, sfa_flags, sfa_mode) as sfa_fd */
+
+/*
+ * One file action. spawn() takes an array of these ended by a
+ * SPAWN_END entry and applies them in order to the child's file
+ * table, which starts as a copy of the parent's, before the child
+ * runs.
+ */
+struct spawn_action {
+	int sfa_op;			/* SPAWN_* */
+	int sfa_fd;			/* Descriptor acted on. */
+	int sfa_srcfd;			/* SPAWN_DUP2: descriptor to copy. */
+	int sfa_flags;			/* SPAWN_OPEN: open flags. */
+	int sfa_mode;			/* SPAWN_OPEN: creation mode. */
+	const char *sfa_path;		/* SPAWN_OPEN: path. */
+};
+
+#endif /* _KERN_SPAWN_H_ */
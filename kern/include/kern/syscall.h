@@ -86,13 +86,13 @@
 //#define SYS_sigaltstack 33
 //                              (resource tracking and usage)
 //#define SYS_wait4      34
-//#define SYS_getrusage  35
+#define SYS_getrusage    35
 //                              (resource limits)
 //#define SYS_getrlimit  36
 //#define SYS_setrlimit  37
 //                              (process priority control)
-//#define SYS_getpriority 38
-//#define SYS_setpriority 39
+#define SYS_getpriority  38
+#define SYS_setpriority  39
 //                              (process groups, sessions, and job control)
 //#define SYS_getpgid    40
 //#define SYS_setpgid    41
@@ -109,13 +109,13 @@
 #define SYS_close        49
 #define SYS_read         50
 #define SYS_pread        51
-//#define SYS_readv      52
-//#define SYS_preadv     53
+#define SYS_readv        52
+#define SYS_preadv       53
 #define SYS_getdirentry  54
 #define SYS_write        55
 #define SYS_pwrite       56
-//#define SYS_writev     57
-//#define SYS_pwritev    58
+#define SYS_writev       57
+#define SYS_pwritev      58
 #define SYS_lseek        59
 #define SYS_flock        60
 #define SYS_ftruncate    61
@@ -197,6 +197,27 @@
 #define SYS_reboot       119
 //#define SYS___sysctl   120
 
+//                              -- Scheduling --
+#define SYS_sched_setaffinity 121
+#define SYS_sched_getaffinity 122
+
+//                              -- Time-related, continued --
+#define SYS_clock_gettime 123
+
+//                              -- Scheduling, continued --
+#define SYS_sched_setscheduler 124
+#define SYS_sched_getscheduler 125
+
+//                              -- Process-related, continued --
+#define SYS_spawn        126
+
+//                              -- File-handle-related, continued --
+#define SYS_splice       127
+
+//                              -- Batched I/O --
+#define SYS_uring_setup  128
+#define SYS_uring_enter  129
+
 /*CALLEND*/
 
 
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _KERN_URING_H_
+#define _KERN_URING_H_
+
+/*
+ * Definitions for uring_setup() and uring_enter(): submission and
+ * completion rings shared between a process and the kernel.
+ *
+ * The process supplies URING_SIZE(entries) bytes of its own memory,
+ * 8-byte aligned, laid out as a struct uring_rings followed by the
+ * submission queue (ENTRIES struct uring_sqe) and the completion
+ * queue (ENTRIES struct uring_cqe). ENTRIES is a power of two, and
+ * slot I of a queue is used by every index equal to I modulo
+ * ENTRIES; the head and tail indexes run freely and wrap.
+ *
+ * The process fills in the SQE at ur_sqtail and then advances
+ * ur_sqtail; the kernel takes SQEs from ur_sqhead. The kernel fills
+ * in the CQE at ur_cqtail and advances ur_cqtail; the process reads
+ * CQEs from ur_cqhead and advances that. Each index is written by
+ * only one side. Each side must make an entry visible before moving
+ * the index past it (a memory barrier on multiprocessors).
+ *
+ * Every SQE produces exactly one CQE, in order, carrying the SQE's
+ * sqe_data and the call's result: what the corresponding system
+ * call would have returned, or -errno on failure. The kernel takes
+ * an SQE only when there is room in the completion queue for it.
+ */
+
+/* Operations. */
+#define URING_OP_NOP	0	/* nothing */
+#define URING_OP_READ	1	/* read or pread */
+#define URING_OP_WRITE	2	/* write or pwrite */
+#define URING_OP_OPEN	3	/* open */
+#define URING_OP_CLOSE	4	/* close */
+#define URING_OP_STAT	5	/* stat */
+#define URING_OP_FSTAT	6	/* fstat */
+
+struct uring_sqe {
+	int sqe_op;		/* URING_OP_* */
+	int sqe_fd;		/* file handle (READ, WRITE, CLOSE, FSTAT) */
+	int sqe_flags;		/* open flags (OPEN) */
+	unsigned sqe_len;	/* byte count (READ, WRITE); mode (OPEN) */
+#ifdef _KERNEL
+	userptr_t sqe_addr;	/* buffer (READ, WRITE); path (OPEN, STAT) */
+	userptr_t sqe_statbuf;	/* struct stat (STAT, FSTAT) */
+#else
+	void *sqe_addr;
+	void *sqe_statbuf;
+#endif
+	__off_t sqe_off;	/* position, or -1 for the seek position */
+	__u64 sqe_data;		/* passed through to the CQE */
+};
+
+struct uring_cqe {
+	__u64 cqe_data;		/* sqe_data of the request */
+	int cqe_res;		/* result, or -errno */
+	int cqe_pad;
+};
+
+struct uring_rings {
+	unsigned ur_sqhead;	/* next SQE the kernel takes (kernel) */
+	unsigned ur_sqtail;	/* next free SQE (process) */
+	unsigned ur_cqhead;	/* next CQE the process takes (process) */
+	unsigned ur_cqtail;	/* next free CQE (kernel) */
+	unsigned ur_flags;	/* URING_F_* (kernel) */
+	unsigned ur_entries;	/* size of each queue (kernel) */
+};
+
+#define URING_SIZE(entries) \
+	(sizeof(struct uring_rings) + \
+	 (entries) * (sizeof(struct uring_sqe) + sizeof(struct uring_cqe)))
+
+#define URING_MAXENTRIES	1024
+
+/* Flags for uring_setup. */
+#define URING_SETUP_SQPOLL	1	/* a kernel thread takes the SQEs */
+
+/* Bits in ur_flags. */
+#define URING_F_SQPOLL		1	/* set up with URING_SETUP_SQPOLL */
+#define URING_F_NEED_WAKEUP	2	/* poller is asleep; use uring_enter */
+
+/* Flags for uring_enter. */
+#define URING_ENTER_GETEVENTS	1	/* wait for min_complete CQEs */
+#define URING_ENTER_WAKEUP	2	/* wake the poller */
+
+#endif /* _KERN_URING_H_ */
@@ -52,6 +52,19 @@ void mainbus_interrupt(struct trapframe *);
 /* XXX this interface is not adequately MI */
 size_t mainbus_ramsize(void);
 
+/*
+ * Stretch (defer) or restore (undefer) the interval until this cpu's
+ * next clock tick, for tickless idle. (Low-level; see clock.c.)
+ */
+bool mainbus_timer_defer(unsigned ticks);
+bool mainbus_timer_undefer(unsigned *elapsed);
+
+/*
+ * Cycles executed by this cpu since it started. Monotonic per cpu;
+ * see clock_monotonic_ns() for something comparable across cpus.
+ */
+uint64_t mainbus_cycles(void);
+
 /* Switch on an inter-processor interrupt. (Low-level.) */
 void mainbus_send_ipi(struct cpu *target);
 
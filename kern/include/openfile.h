@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _OPENFILE_H_
+#define _OPENFILE_H_
+
+/*
+ * Open files.
+ *
+ * An openfile is what a file descriptor refers to: an open vnode
+ * together with the access mode it was opened with and the seek
+ * position. Descriptors copied by fork, spawn and dup2 share the
+ * same openfile, and with it the seek position, as in Unix. It is
+ * reference counted; the last reference closes the vnode.
+ *
+ * Freed openfiles are kept for reuse rather than given back to
+ * kmalloc, so memory that has held an openfile always holds one.
+ * That lets filetable_get take a reference on a descriptor's
+ * openfile without the table lock: openfile_tryincref fails on one
+ * that has been freed, and the caller then rechecks the descriptor
+ * to catch one that has been freed and reused.
+ *
+ * of_offset is protected by of_offsetsem, a semaphore used as a
+ * sleeping lock since it is held across VOP_READ/VOP_WRITE. A file
+ * with one reference in a single-threaded process cannot be used by
+ * anyone else, so openfile_lockoffset skips the semaphore then.
+ *
+ * Functions:
+ *     openfile_create - make an openfile for VN, which it takes over
+ *                       the caller's reference to, with one reference.
+ *     openfile_open   - vfs_open PATH and make an openfile for it,
+ *                       with one reference. May destroy PATH.
+ *     openfile_incref - add a reference.
+ *     openfile_tryincref - add a reference unless there are none, in
+ *                       which case OF is free. Returns whether it did.
+ *     openfile_decref - drop a reference; the last one closes the file.
+ *     openfile_lockoffset - lock of_offset if anyone else might use
+ *                       it. Returns whether it did, for
+ *                       openfile_unlockoffset.
+ */
+
+#include <kern/fcntl.h>
+#include <atomic.h>
+
+struct vnode;
+struct semaphore;
+
+struct openfile {
+	struct vnode *of_vnode;		/* the open file */
+	int of_accmode;			/* O_RDONLY, O_WRONLY, or O_RDWR */
+	int of_append;			/* opened with O_APPEND */
+	struct semaphore *of_offsetsem;	/* for of_offset */
+	off_t of_offset;		/* seek position */
+	atomic_t of_refcount;		/* descriptors and other users */
+	struct openfile *of_nextfree;	/* link on the free list */
+};
+
+#define OPENFILE_CANREAD(of)	((of)->of_accmode != O_WRONLY)
+#define OPENFILE_CANWRITE(of)	((of)->of_accmode != O_RDONLY)
+
+int openfile_create(struct vnode *vn, int flags, struct openfile **ret);
+int openfile_open(char *path, int flags, mode_t mode, struct openfile **ret);
+void openfile_incref(struct openfile *of);
+bool openfile_tryincref(struct openfile *of);
+void openfile_decref(struct openfile *of);
+bool openfile_lockoffset(struct openfile *of);
+void openfile_unlockoffset(struct openfile *of, bool locked);
+
+#endif /* _OPENFILE_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Pipes.
+ *
+ * A pipe is a ring buffer of PIPE_NPAGES pages with two vnodes, one
+ * for each end. The ends are opened like any other vnode, through
+ * openfiles, and the pipe goes away when both have been closed.
+ * Reading an empty pipe waits for data, or returns end of file once
+ * the write end is closed; writing a full pipe waits for space, or
+ * fails with EPIPE once the read end is closed.
+ *
+ * Functions:
+ *     pipe_create     - make a pipe; returns its read and write ends,
+ *                       each with one reference.
+ *     pipe_isread     - true if VN is the read end of a pipe.
+ *     pipe_iswrite    - true if VN is the write end of a pipe.
+ *     pipe_same       - true if VN1 and VN2 are ends of one pipe.
+ *     pipe_splice_out - move up to LEN bytes from the pipe whose
+ *                       read end is RDVN into DST at *OFFSET, with
+ *                       one VOP_WRITE straight from the ring buffer.
+ *     pipe_splice_in  - move up to LEN bytes from SRC at *OFFSET into
+ *                       the pipe whose write end is WRVN, with one
+ *                       VOP_READ straight into the ring buffer.
+ *
+ * The splice functions wait like read and write do, move what they
+ * can in one go, advance *OFFSET, and return the count in *MOVED (0
+ * at end of file).
+ */
+
+struct vnode;
+
+#define PIPE_NPAGES	4	/* must be a power of two */
+
+int pipe_create(struct vnode **rdvn, struct vnode **wrvn);
+bool pipe_isread(struct vnode *vn);
+bool pipe_iswrite(struct vnode *vn);
+bool pipe_same(struct vnode *vn1, struct vnode *vn2);
+int pipe_splice_out(struct vnode *rdvn, struct vnode *dst, off_t *offset,
+		    size_t len, size_t *moved);
+int pipe_splice_in(struct vnode *wrvn, struct vnode *src, off_t *offset,
+		   size_t len, size_t *moved);
+
+#endif /* _PIPE_H_ */
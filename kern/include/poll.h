@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Waiting for readiness, for poll and select.
+ *
+ * Every object a thread might wait on in poll has a pollhead: a
+ * list of the poll calls currently waiting on it. Each poll call
+ * has a pollset, and an array of pollentries, one per descriptor.
+ * VOP_POLL links a descriptor's pollentry onto its object's
+ * pollhead; when the object becomes ready, its owner calls
+ * pollhead_wakeup, which puts each entry on its set's ready list
+ * and wakes the waiting thread.
+ *
+ * So a poll call sleeping on many descriptors costs nothing while
+ * nothing happens, and when something does, the waker does work for
+ * the pollers on that one object and the poller rechecks only the
+ * entries on its ready list, not every descriptor it was given.
+ *
+ * To avoid missing a wakeup, VOP_POLL must register the entry
+ * before checking the object's state, and the owner must change the
+ * state before calling pollhead_wakeup. Then either the check sees
+ * the change, or the wakeup sees the entry.
+ *
+ * pollhead functions:
+ *     pollhead_init    - set up an empty pollhead.
+ *     pollhead_cleanup - tear one down; nobody may be waiting.
+ *     pollhead_wakeup  - signal everyone waiting on PH. Cheap if
+ *                        nobody is; may be called with the owner's
+ *                        own spinlocks held.
+ *     pollwait         - for VOP_POLL: if PE is not NULL, add it to
+ *                        PH. Call before checking for readiness.
+ *
+ * pollset functions, for the poll and select code and the uring
+ * poller:
+ *     pollset_init     - set up an empty pollset.
+ *     pollset_cleanup  - tear it down; all entries must be removed.
+ *     pollentry_init   - set up entry INDEX of a call on PS.
+ *     pollentry_remove - take PE off its pollhead, if it's on one.
+ *     pollset_wait     - sleep until some entry is signalled, or
+ *                        until clock_monotonic_ns() reaches DEADLINE
+ *                        (never, if DEADLINE is 0), or until
+ *                        pollset_wake.
+ *     pollset_wake     - make the current or next pollset_wait on PS
+ *                        return even if nothing is ready.
+ *     pollset_next     - take a signalled entry off the ready list,
+ *                        for the caller to recheck; NULL if none
+ *                        (after pollset_wait: timed out, or woken).
+ */
+
+#include <spinlock.h>
+#include <kern/poll.h>
+
+struct pollset;
+
+struct pollentry {
+	struct pollhead *pe_head;	/* what we're waiting on, or NULL */
+	struct pollentry *pe_next;	/* link on pe_head */
+	struct pollentry **pe_prevp;	/* pointer to the link to us */
+	struct pollset *pe_set;		/* the poll call we belong to */
+	struct pollentry *pe_readynext;	/* link on pe_set's ready list */
+	bool pe_ready;			/* on the ready list */
+	unsigned pe_index;		/* which descriptor of the call */
+};
+
+struct pollhead {
+	struct spinlock ph_lock;
+	struct pollentry *ph_entries;
+};
+
+struct pollset {
+	struct spinlock ps_lock;
+	struct pollentry *ps_ready;	/* signalled entries */
+	bool ps_woken;			/* pollset_wake was called */
+};
+
+void pollhead_init(struct pollhead *ph);
+void pollhead_cleanup(struct pollhead *ph);
+void pollhead_wakeup(struct pollhead *ph);
+void pollwait(struct pollentry *pe, struct pollhead *ph);
+
+void pollset_init(struct pollset *ps);
+void pollset_cleanup(struct pollset *ps);
+void pollentry_init(struct pollentry *pe, struct pollset *ps, unsigned index);
+void pollentry_remove(struct pollentry *pe);
+void pollset_wait(struct pollset *ps, uint64_t deadline);
+void pollset_wake(struct pollset *ps);
+struct pollentry *pollset_next(struct pollset *ps);
+
+#endif /* _POLL_H_ */
@@ -8,9 +8,14 @@
  */
 
 #include <spinlock.h>
+#include <atomic.h>
+#include <thread.h>   /* for CPUTIME_NTHREAD */
 struct addrspace;
+struct rusage;
 struct thread;
 struct vnode;
+struct filetable;
+struct ioring;
 /*
  * 进程结构体
  * 
@@ -26,13 +31,43 @@ struct vnode;
 struct proc {
     char *p_name;                   /* 进程名称 */
     struct spinlock p_lock;         /* 保护该结构体的锁 */
-    unsigned p_numthreads;          /* 该进程中的线程数量 */
+    atomic_t p_numthreads;          /* 该进程中的线程数量（原子操作） */
 
     /* 虚拟内存相关 */
     struct addrspace *p_addrspace;  /* 虚拟地址空间 */
 
     /* 虚拟文件系统相关 */
     struct vnode *p_cwd;            /* 当前工作目录 */
+    struct filetable *p_filetable;  /* 文件描述符表；内核进程为 NULL */
+
+    /* 调度相关 */
+    int p_nice;                     /* setpriority() 的值，PRIO_MIN..PRIO_MAX */
+
+    /* CPU 时间统计：已离开本进程的线程累计的值（受 p_lock 保护） */
+    uint64_t p_cputime[CPUTIME_NTHREAD]; /* 各 CPUTIME_* 状态的纳秒数 */
+    unsigned p_nvcsw;               /* 主动上下文切换次数 */
+    unsigned p_nivcsw;              /* 被抢占次数 */
+
+    /* 已回收子进程（及其已回收子进程）的 CPU 时间，RUSAGE_CHILDREN 用（受 p_lock 保护） */
+    uint64_t p_ccputime[CPUTIME_NTHREAD];
+    unsigned p_cnvcsw;
+    unsigned p_cnivcsw;
+
+    /* 进程表相关（受 proc.c 中的 proctable_lock 保护） */
+    pid_t p_pid;                    /* 进程号；不在进程表中时为 0 */
+    struct proc *p_parent;          /* 父进程；内核启动的进程和孤儿为 NULL */
+    struct proc *p_children;        /* 子进程链表头 */
+    struct proc *p_sibling;         /* 兄弟链表中的下一个 */
+    struct proc **p_siblingprev;    /* 指向前一个节点中指向自己的指针，O(1) 摘除 */
+    struct proc *p_hashnext;        /* PID 哈希链中的下一个 */
+    bool p_exited;                  /* 已退出，等待父进程回收（僵尸） */
+    int p_exitstatus;               /* 编码后的退出状态（_MKWAIT_*） */
+
+    /* vfork 相关（受 p_lock 保护） */
+    bool p_vfork;                   /* 正在借用父进程的地址空间 */
+
+    /* 批量 I/O（uring_setup）；只有本进程的线程会碰它 */
+    struct ioring *p_ioring;        /* 提交/完成环；没有时为 NULL */
 
     /* 根据需要在此添加更多内容 */
 };
@@ -46,6 +81,23 @@ void proc_bootstrap(void);
 /* 为 runprogram() 创建一个新的进程 */
 struct proc *proc_create_runprogram(const char *name);
 
+/* 为 fork() 创建当前进程的子进程：复制地址空间、当前目录、文件描述符表和 nice 值并分配 PID */
+int proc_fork(struct proc **ret);
+
+/* 为 vfork() 创建借用当前进程地址空间的子进程；父进程随后等待它归还 */
+int proc_vfork(struct proc **ret);
+bool proc_vfork_done(struct proc *proc);
+void proc_vfork_wait(struct proc *child);
+
+/* 为 spawn() 创建当前进程的子进程，使用已装好程序的地址空间 AS */
+int proc_spawn(const char *name, struct addrspace *as, struct proc **ret);
+
+/* 以编码后的状态 STATUS 结束当前进程（其唯一线程），不返回 */
+__DEAD void proc_exit(int status);
+
+/* 等待当前进程的子进程 PID（或 WAIT_ANY）退出并回收它 */
+int proc_wait(pid_t pid, int options, int *status, pid_t *ret);
+
 /* 销毁一个进程 */
 void proc_destroy(struct proc *proc);
 
@@ -55,6 +107,12 @@ int proc_addthread(struct proc *proc, struct thread *t);
 /* 从进程中分离线程 */
 void proc_remthread(struct thread *t);
 
+/* 获取进程的资源使用情况（getrusage 的 RUSAGE_SELF） */
+void proc_getrusage(struct proc *proc, struct rusage *ru);
+
+/* 获取已回收子进程的资源使用情况（getrusage 的 RUSAGE_CHILDREN） */
+void proc_getrusage_children(struct proc *proc, struct rusage *ru);
+
 /* 获取当前进程的地址空间 */
 struct addrspace *proc_getas(void);
 
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _SLEEPQ_H_
+#define _SLEEPQ_H_
+
+/*
+ * Sleep queues.
+ *
+ * These do the job of a wait channel for an object that doesn't
+ * have one. Sleeping threads are kept in a global hash table keyed
+ * by the object's address, so the object itself needs no storage
+ * for them and nothing is allocated until someone actually sleeps.
+ * Any unique address will do as the key; normally it's the address
+ * of the object being waited for.
+ *
+ * As with wait channels, the caller supplies a spinlock that
+ * protects the condition being waited for. Every sleep and wakeup on
+ * a given key must be done holding that same lock. The sleep queue's
+ * own locks come after it, and before the run queue locks.
+ */
+
+struct spinlock; /* in spinlock.h */
+
+/*
+ * Go to sleep on KEY. LK must be held; it is released while sleeping
+ * and reacquired before returning. NAME is what to show for the
+ * thread in the meantime (like a wait channel's name); it must stay
+ * valid while the thread sleeps.
+ */
+void sleepq_sleep(const void *key, const char *name, struct spinlock *lk);
+
+/*
+ * Like sleepq_sleep, but give up after TICKS hardclocks. Returns
+ * ETIMEDOUT if nobody woke us by then, otherwise 0.
+ */
+int sleepq_sleep_timeout(const void *key, const char *name,
+			 struct spinlock *lk, unsigned ticks);
+
+/*
+ * Wake one thread, or all threads, sleeping on KEY. LK must be held.
+ * sleepq_wakeone_sync is the sleep queue version of
+ * wchan_wakeone_sync.
+ */
+void sleepq_wakeone(const void *key, struct spinlock *lk);
+void sleepq_wakeone_sync(const void *key, struct spinlock *lk);
+void sleepq_wakeall(const void *key, struct spinlock *lk);
+
+/*
+ * Return true if nobody is sleeping on KEY. For diagnostic use, such
+ * as checking an object being destroyed.
+ */
+bool sleepq_isempty(const void *key);
+
+
+#endif /* _SLEEPQ_H_ */
@@ -42,10 +42,12 @@
  *
  * The name field is for easier debugging. A copy of the name is made
  * internally.
+ *
+ * Waiting threads are kept on the sleep queue for the semaphore's
+ * address (see sleepq.h), so there's no wait channel in here.
  */
 struct semaphore {
         char *sem_name;
-	struct wchan *sem_wchan;
 	struct spinlock sem_lock;
         volatile unsigned sem_count;
 };
@@ -54,13 +56,22 @@ struct semaphore *sem_create(const char *name, unsigned initial_count);
 void sem_destroy(struct semaphore *);
 
 /*
- * Operations (both atomic):
+ * Operations (all atomic):
  *     P (proberen): decrement count. If the count is 0, block until
  *                   the count is 1 again before decrementing.
  *     V (verhogen): increment count.
+ *     tryP:         P if it can be done without blocking. Returns
+ *                   whether it was.
+ *     V_sync:       V, for a caller that is about to block (as in V
+ *                   on one semaphore then P on another, to pass a
+ *                   request and wait for the reply). A thread it
+ *                   wakes gets this cpu as soon as the caller
+ *                   blocks. See wchan_wakeone_sync.
  */
 void P(struct semaphore *);
+bool tryP(struct semaphore *);
 void V(struct semaphore *);
+void V_sync(struct semaphore *);
 
 
 /*
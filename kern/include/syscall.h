@@ -40,12 +40,17 @@ struct trapframe; /* from <machine/trapframe.h> */
 
 void syscall(struct trapframe *tf);
 
+/*
+ * Print per-syscall call counts and time spent, then reset them.
+ */
+void syscall_printstats(void);
+
 /*
  * Support functions.
  */
 
-/* Helper for fork(). You write this. */
-void enter_forked_process(struct trapframe *tf);
+/* Enter user mode in a new child of fork(), returning 0. Frees TF. */
+__DEAD void enter_forked_process(struct trapframe *tf);
 
 /* Enter user mode. Does not return. */
 __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
@@ -58,5 +63,47 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_nanosleep(const_userptr_t req, userptr_t rem);
+int sys_clock_gettime(int clockid, userptr_t ts);
+int sys_getrusage(int who, userptr_t ru);
+int sys_fork(struct trapframe *tf, int32_t *retval);
+int sys_vfork(struct trapframe *tf, int32_t *retval);
+int sys_execv(const_userptr_t path, userptr_t argv);
+int sys_spawn(const_userptr_t path, userptr_t argv, const_userptr_t actions,
+	      int32_t *retval);
+__DEAD void sys__exit(int code);
+int sys_waitpid(pid_t pid, userptr_t status, int options, int32_t *retval);
+int sys_getpid(int32_t *retval);
+int sys_getpriority(int which, int who, int32_t *retval);
+int sys_setpriority(int which, int who, int prio);
+int sys_sched_setaffinity(pid_t pid, const_userptr_t mask);
+int sys_sched_getaffinity(pid_t pid, userptr_t mask);
+int sys_sched_setscheduler(pid_t pid, int policy, const_userptr_t param);
+int sys_sched_getscheduler(pid_t pid, userptr_t param, int32_t *retval);
+int sys_open(const_userptr_t path, int flags, mode_t mode, int32_t *retval);
+int sys_close(int fd);
+int sys_dup2(int oldfd, int newfd, int32_t *retval);
+int sys_read(int fd, userptr_t buf, size_t len, int32_t *retval);
+int sys_write(int fd, const_userptr_t buf, size_t len, int32_t *retval);
+int sys_pread(int fd, userptr_t buf, size_t len, off_t pos, int32_t *retval);
+int sys_pwrite(int fd, const_userptr_t buf, size_t len, off_t pos,
+	       int32_t *retval);
+int sys_readv(int fd, const_userptr_t iov, int iovcnt, int32_t *retval);
+int sys_writev(int fd, const_userptr_t iov, int iovcnt, int32_t *retval);
+int sys_preadv(int fd, const_userptr_t iov, int iovcnt, off_t pos,
+	       int32_t *retval);
+int sys_pwritev(int fd, const_userptr_t iov, int iovcnt, off_t pos,
+		int32_t *retval);
+int sys_lseek(int fd, off_t pos, int whence, off_t *retval);
+int sys_stat(const_userptr_t path, userptr_t statbuf);
+int sys_fstat(int fd, userptr_t statbuf);
+int sys_pipe(userptr_t fds);
+int sys_splice(int fromfd, int tofd, size_t len, int32_t *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout, int32_t *retval);
+int sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	       userptr_t exceptfds, const_userptr_t timeout, int32_t *retval);
+int sys_uring_setup(userptr_t rings, unsigned entries, int flags);
+int sys_uring_enter(unsigned to_submit, unsigned min_complete, int flags,
+		    int32_t *retval);
 
 #endif /* _SYSCALL_H_ */
@@ -46,6 +46,16 @@ int arraytest2(int, char **);
 int bitmaptest(int, char **);
 int threadlisttest(int, char **);
 
+/* atomic operation tests */
+int atomictest(int, char **);
+int atomicbench(int, char **);
+
+/* callout and timed sleep tests */
+int callouttest(int, char **);
+
+/* workqueue tests */
+int workqueuetest(int, char **);
+
 /* thread tests */
 int threadtest(int, char **);
 int threadtest2(int, char **);
@@ -54,6 +64,9 @@ int semtest(int, char **);
 int locktest(int, char **);
 int cvtest(int, char **);
 int cvtest2(int, char **);
+int pingpongbench(int, char **);
+int semcreatebench(int, char **);
+int wakeallbench(int, char **);
 
 /* semaphore unit tests */
 int semu1(int, char **);
@@ -55,6 +55,57 @@ struct cpu;
 /* Macro to test if two addresses are on the same kernel stack */
 #define SAME_STACK(p1, p2)     (((p1) & STACK_MASK) == ((p2) & STACK_MASK))
 
+/* Number of free kernel stacks each cpu keeps for reuse */
+#define STACK_CACHE 8
+
+
+/*
+ * Real-time threads get at most this share of each cpu, in tenths
+ * of a percent: no one thread may ask for more, and all of them
+ * together get at most this much times the number of cpus
+ * (admission control in thread_setrt).
+ */
+#define SCHED_RT_UTIL		500
+
+/*
+ * Scheduler levels. The scheduler is a multi-level feedback queue:
+ * a thread that uses up its time slice drops one level, and a
+ * thread at a better (lower-numbered) level always runs before one
+ * at a worse level. The slice at level L is SCHED_SLICE(L)
+ * hardclocks, so CPU-bound threads sink to long slices at low
+ * priority while threads that sleep a lot stay near the top.
+ * Periodically every thread is boosted back to its base level (see
+ * schedule()) so nothing starves.
+ */
+#define SCHED_NLEVELS		4
+#define SCHED_SLICE(level)	(1U << (level))
+
+/*
+ * CPU affinity masks. Bit N set means the thread may run on the cpu
+ * whose c_number is N. System/161 supports at most 32 cpus, so one
+ * word is enough.
+ */
+#define CPUMASK_ALL		0xffffffffU
+#define CPUMASK_BIT(n)		(1U << (n))
+
+/*
+ * CPU time accounting states. Each cpu is in exactly one of these
+ * at any moment; time in the first three is also charged to the
+ * current thread. Index t_cputime[], p_cputime[] and c_cputime[].
+ */
+#define CPUTIME_USER		0	/* running user code */
+#define CPUTIME_SYS		1	/* in the kernel, for the thread */
+#define CPUTIME_INTR		2	/* handling an interrupt */
+#define CPUTIME_IDLE		3	/* no thread (idle loop/switching) */
+#define CPUTIME_NTHREAD		3	/* states charged to threads */
+#define CPUTIME_NSTATES		4
+
+/*
+ * Scheduler latency histograms (see cpu_printlatency). Bucket 0
+ * counts times under 2us; bucket B, [2^B, 2^(B+1)) us; the last one
+ * everything longer.
+ */
+#define SCHED_LATBUCKETS	20
 
 /* States a thread can be in. */
 typedef enum {
@@ -72,6 +123,8 @@ struct thread {
 	 */
 	char *t_name;			/* Name of this thread */
 	const char *t_wchan_name;	/* Name of wait channel, if sleeping */
+	struct wchan *t_wchan;		/* Wait channel, if on one (wchan lock) */
+	const void *t_sleepkey;		/* Sleep queue key, if on one (ditto) */
 	threadstate_t t_state;		/* State this thread is in */
 
 	/*
@@ -85,6 +138,42 @@ struct thread {
 	struct proc *t_proc;		/* Process thread belongs to */
 	HANGMAN_ACTOR(t_hangman);	/* Deadlock detector hook */
 
+	/*
+	 * Scheduler fields. These are protected by the runqueue lock
+	 * of t_cpu while the thread is on a runqueue; otherwise only
+	 * the thread itself (including from hardclock) touches them.
+	 */
+	unsigned t_level;		/* MLFQ level; 0 is highest */
+	unsigned t_slice;		/* Hardclocks left at this level */
+	uint32_t t_affinity;		/* CPUs we may run on (CPUMASK_BIT) */
+	struct thread *t_lastwaker;	/* Who woke us last (only compared) */
+
+	/*
+	 * Real-time class (see thread_setrt). t_rtprio is 0 for an
+	 * ordinary time-sharing thread. The budget is counted down by
+	 * schedule_tick and refilled once per period.
+	 */
+	unsigned t_rtprio;		/* SCHED_RR priority, or 0 */
+	unsigned t_rtruntime;		/* Budget per period (hardclocks) */
+	unsigned t_rtperiod;		/* Period (hardclocks) */
+	unsigned t_rtbudget;		/* Budget left this period */
+	uint64_t t_rtrenew;		/* When to refill (clock_monotonic_ns) */
+
+	/*
+	 * CPU time accounting, in nanoseconds. Updated only by the
+	 * thread itself with interrupts off; see thread_cputime().
+	 */
+	uint64_t t_cputime[CPUTIME_NTHREAD];
+	unsigned t_acct_state;		/* CPUTIME_* while switched out */
+	unsigned t_nvcsw;		/* Voluntary context switches */
+	unsigned t_nivcsw;		/* Involuntary (preempted) */
+
+	/*
+	 * Latency stamps (clock_monotonic_ns), for the histograms.
+	 */
+	uint64_t t_readystamp;		/* When last made runnable */
+	uint64_t t_runstamp;		/* When last put on a cpu */
+
 	/*
 	 * Interrupt state fields.
 	 *
@@ -106,6 +195,13 @@ struct thread {
 	 * Public fields
 	 */
 
+	/*
+	 * Set by a thread that must not wait for I/O. Pipe and console
+	 * reads and writes then fail with EAGAIN instead of waiting,
+	 * or stop short with what they could move without waiting.
+	 */
+	bool t_nowait;
+
 	/* add more here as needed */
 };
 
@@ -164,10 +260,54 @@ void thread_yield(void);
 void schedule(void);
 
 /*
- * Potentially migrate ready threads to other CPUs. Called from the
- * timer interrupt.
+ * Charge the current thread for one hardclock. Returns true if it
+ * should yield. Called from the timer interrupt.
+ */
+bool schedule_tick(void);
+
+/*
+ * Recompute the current thread's scheduler level after its
+ * process's nice value (p_nice) changed.
+ */
+void thread_renice(void);
+
+/*
+ * Set the current thread's CPU affinity mask. Bits for cpus that
+ * don't exist are dropped; returns EINVAL if none are left. If the
+ * current cpu is no longer allowed, the thread moves off it the next
+ * time that cpu has something else to run.
+ */
+int thread_setaffinity(uint32_t mask);
+
+/*
+ * Charge the time since the last call to the current accounting
+ * state, then enter state NEWSTATE. Returns the previous state so
+ * an interrupt handler can go back to it. Called on every trap and
+ * context switch.
+ */
+unsigned thread_cputime(unsigned newstate);
+
+/*
+ * Put the current thread in the real-time class at priority PRIO
+ * (SCHED_RT_MINPRIO..SCHED_RT_MAXPRIO; higher runs first), with a
+ * budget of RUNTIME hardclocks every PERIOD hardclocks. While it has
+ * budget left it runs ahead of every time-sharing thread, and a
+ * wakeup preempts a lower-priority thread at once rather than at the
+ * next tick. PRIO 0 returns it to time-sharing.
+ *
+ * Returns EINVAL for bad parameters and EBUSY if the thread asks for
+ * more than SCHED_RT_UTIL of a cpu, or admitting it would take
+ * real-time threads past SCHED_RT_UTIL of the machine.
+ * New threads start out time-sharing.
+ */
+int thread_setrt(unsigned prio, unsigned runtime, unsigned period);
+
+/*
+ * Yield if a real-time thread has been made runnable on this cpu
+ * ahead of the current thread. Called on the way back out of traps
+ * and interrupts.
  */
-void thread_consider_migration(void);
+void thread_resched(void);
 
 
 #endif /* _THREAD_H_ */
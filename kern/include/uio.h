@@ -138,5 +138,21 @@ int uiomovezeros(size_t len, struct uio *uio);
 void uio_kinit(struct iovec *, struct uio *,
 	       void *kbuf, size_t len, off_t pos, enum uio_rw rw);
 
+/*
+ * Likewise, for I/O to or from a buffer in the current process's
+ * user address space (e.g. for read and write).
+ */
+void uio_uinit(struct iovec *, struct uio *,
+	       userptr_t ubuf, size_t len, off_t pos, enum uio_rw rw);
+
+/*
+ * Likewise, for a scatter/gather list of IOVCNT user buffers (e.g.
+ * for readv and writev). The uio uses the iovec array in place, so
+ * it must stay around until the I/O is done. Fails with EINVAL if
+ * the lengths add up to more than an ssize_t can hold.
+ */
+int uio_uinitv(struct iovec *iov, unsigned iovcnt, struct uio *,
+	       off_t pos, enum uio_rw rw);
+
 
 #endif /* _UIO_H_ */
@@ -31,8 +31,10 @@
 #define _VNODE_H_
 
 #include <spinlock.h>
+#include <atomic.h>
 struct uio;
 struct stat;
+struct pollentry;
 
 
 /*
@@ -49,8 +51,7 @@ struct stat;
  * Note: vn_fs may be null if the vnode refers to a device.
  */
 struct vnode {
-	int vn_refcount;                /* Reference count */
-	struct spinlock vn_countlock;   /* Lock for vn_refcount */
+	atomic_t vn_refcount;           /* Reference count */
 
 	struct fs *vn_fs;               /* Filesystem vnode belongs to */
 
@@ -132,6 +133,15 @@ struct vnode {
  *                      uio. Need not work on objects that are not
  *                      directories.
  *
+ *    vop_poll        - Return which of the EVENTS bits (POLLIN,
+ *                      POLLOUT; see kern/poll.h) can be done without
+ *                      waiting, plus POLLHUP or POLLERR if they apply.
+ *                      If PE is not NULL, first register it with
+ *                      pollwait() on whatever pollhead will be woken
+ *                      when that changes; see poll.h. Objects that
+ *                      never make anyone wait can use
+ *                      vnode_poll_ready.
+ *
  *****************************************
  *
  *    vop_creat       - Create a regular file named NAME in the passed
@@ -196,6 +206,8 @@ struct vnode_ops {
 	int (*vop_mmap)(struct vnode *file /* add stuff */);
 	int (*vop_truncate)(struct vnode *file, off_t len);
 	int (*vop_namefile)(struct vnode *file, struct uio *uio);
+	int (*vop_poll)(struct vnode *object, int events,
+			struct pollentry *pe);
 
 
 	int (*vop_creat)(struct vnode *dir,
@@ -240,6 +252,7 @@ struct vnode_ops {
 #define VOP_MMAP(vn /*add stuff */)     (__VOP(vn, mmap)(vn /*add stuff */))
 #define VOP_TRUNCATE(vn, pos)           (__VOP(vn, truncate)(vn, pos))
 #define VOP_NAMEFILE(vn, uio)           (__VOP(vn, namefile)(vn, uio))
+#define VOP_POLL(vn, events, pe)        (__VOP(vn, poll)(vn, events, pe))
 
 #define VOP_CREAT(vn,nm,excl,mode,res)  (__VOP(vn, creat)(vn,nm,excl,mode,res))
 #define VOP_SYMLINK(vn, name, content)  (__VOP(vn, symlink)(vn, name, content))
@@ -312,5 +325,10 @@ int vopfail_lookup_notdir(struct vnode *vn, char *path, struct vnode **result);
 int vopfail_lookparent_notdir(struct vnode *vn, char *path,
 			      struct vnode **result, char *buf, size_t len);
 
+/*
+ * vop_poll for objects that are always ready, like regular files.
+ */
+int vnode_poll_ready(struct vnode *vn, int events, struct pollentry *pe);
+
 
 #endif /* _VNODE_H_ */
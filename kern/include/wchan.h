@@ -66,6 +66,13 @@ bool wchan_isempty(struct wchan *wc, struct spinlock *lk);
  */
 void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Like wchan_sleep, but give up after TICKS hardclocks. Returns 0 if
+ * awakened by someone else and ETIMEDOUT if the time ran out.
+ */
+int wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk,
+			unsigned ticks);
+
 /*
  * Wake up one thread, or all threads, sleeping on a wait channel.
  * The associated spinlock should be locked.
@@ -76,5 +83,16 @@ void wchan_sleep(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeone(struct wchan *wc, struct spinlock *lk);
 void wchan_wakeall(struct wchan *wc, struct spinlock *lk);
 
+/*
+ * Like wchan_wakeone, but for a caller that is about to block. The
+ * woken thread is handed this cpu directly: it doesn't go on a run
+ * queue, and runs as soon as the caller switches out, ahead of
+ * anything queued. If the caller keeps running instead, it goes on
+ * the run queue at the next hardclock. Falls back to wchan_wakeone
+ * if the thread can't run here or this cpu already has a handoff
+ * pending.
+ */
+void wchan_wakeone_sync(struct wchan *wc, struct spinlock *lk);
+
 
 #endif /* _WCHAN_H_ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _WORKQUEUE_H_
+#define _WORKQUEUE_H_
+
+/*
+ * Workqueues: deferred work run by a kernel thread.
+ *
+ * Each cpu has a workqueue and a worker thread bound to it. An
+ * interrupt handler that has more to do than acknowledge its device
+ * can put the rest in a struct work and queue it; the worker runs
+ * it shortly afterwards in thread context, with interrupts on, so
+ * it may take sleep locks and block.
+ *
+ * A work item is queued on the cpu that queues it, and runs there.
+ * It can be queued only once at a time: queueing an item that is
+ * already pending does nothing. Once the function has started, the
+ * item can be queued again (including by the function itself).
+ *
+ * Functions:
+ *     work_init          - set up a work item to call FUNC(ARG).
+ *     queue_work         - run the work item soon. Returns false
+ *                          if it was already pending. May be called
+ *                          from interrupt handlers.
+ *     queue_delayed_work - run the work item after TICKS hardclocks.
+ *     cancel_delayed_work - stop a delayed work item whose time has
+ *                          not come yet. Returns true if it did so;
+ *                          false if the item was not waiting on its
+ *                          timer (not queued, or already handed to
+ *                          the worker, in which case it will run).
+ *     workqueue_start    - start the current cpu's worker. Until
+ *                          this is called, queued work runs
+ *                          immediately in the caller's context.
+ */
+
+#include <atomic.h>
+#include <spinlock.h>
+#include <callout.h>
+
+struct thread;
+struct wchan;
+
+struct work {
+	struct work *w_next;		/* link in workqueue */
+	atomic_t w_pending;		/* 1 from queueing until it runs */
+	struct callout w_timer;		/* for queue_delayed_work */
+	void (*w_func)(void *);
+	void *w_arg;
+};
+
+struct workqueue {
+	struct spinlock wq_lock;
+	struct work *wq_head;		/* first item to run */
+	struct work **wq_tailp;		/* where to link the next item */
+	struct wchan *wq_wchan;		/* worker sleeps here */
+	bool wq_running;		/* worker started */
+	unsigned wq_queued;		/* items queued (statistics) */
+	unsigned wq_maxdepth;		/* longest the queue has been */
+	unsigned wq_depth;		/* items now queued */
+};
+
+void work_init(struct work *w, void (*func)(void *), void *arg);
+bool queue_work(struct work *w);
+bool queue_delayed_work(struct work *w, unsigned ticks);
+bool cancel_delayed_work(struct work *w);
+
+void workqueue_init(struct workqueue *wq);
+void workqueue_start(void);
+
+
+#endif /* _WORKQUEUE_H_ */
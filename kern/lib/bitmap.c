@@ -168,6 +168,59 @@
      return ENOSPC;
  }
  
+ // ----------------------------------------------------------------------
+ // 函数实现：bitmap_alloc_from (从指定位置开始分配空闲位)
+ // ----------------------------------------------------------------------
+ /*
+  * 与 bitmap_alloc 相同，但从 start 开始向后查找，到末尾后回绕到 0。
+  * 调用者记住上次分配的位置并从其后开始（“游标”），就不必每次都从头
+  * 扫过前面已经分配满的部分，刚释放的编号也不会马上被重用。
+  */
+ int
+ bitmap_alloc_from(struct bitmap *b, unsigned start, unsigned *index)
+ {
+     unsigned ix, n;
+     unsigned maxix = DIVROUNDUP(b->nbits, BITS_PER_WORD);
+     unsigned offset;
+     WORD_TYPE mask;
+
+     if (start >= b->nbits) {
+         start = 0;
+     }
+
+     // 1. 先检查 start 所在字节中 start 及其后的位
+     ix = start / BITS_PER_WORD;
+     for (offset = start % BITS_PER_WORD; offset < BITS_PER_WORD; offset++) {
+         mask = ((WORD_TYPE)1) << offset;
+         if ((b->v[ix] & mask)==0) {
+             b->v[ix] |= mask;
+             *index = (ix*BITS_PER_WORD)+offset;
+             KASSERT(*index < b->nbits);
+             return 0;
+         }
+     }
+
+     // 2. 再按字节向后查找（回绕），跳过全满的字节；最后回到 start 所在
+     //    字节时，其中 start 之前的位也会被查到
+     for (n = 1; n <= maxix; n++) {
+         ix = (start / BITS_PER_WORD + n) % maxix;
+         if (b->v[ix]==WORD_ALLBITS) {
+             continue;
+         }
+         for (offset = 0; offset < BITS_PER_WORD; offset++) {
+             mask = ((WORD_TYPE)1) << offset;
+             if ((b->v[ix] & mask)==0) {
+                 b->v[ix] |= mask;
+                 *index = (ix*BITS_PER_WORD)+offset;
+                 KASSERT(*index < b->nbits);
+                 return 0;
+             }
+         }
+         KASSERT(0);
+     }
+     return ENOSPC;
+ }
+
  // ----------------------------------------------------------------------
  // 辅助函数：bitmap_translate (将总索引转换为字节索引和位掩码)
  // ----------------------------------------------------------------------
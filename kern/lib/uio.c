@@ -28,6 +28,7 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <uio.h>
 #include <proc.h>
@@ -162,3 +163,45 @@ uio_kinit(struct iovec *iov, struct uio *u,
 	u->uio_rw = rw;
 	u->uio_space = NULL;
 }
+
+void
+uio_uinit(struct iovec *iov, struct uio *u,
+	  userptr_t ubuf, size_t len, off_t pos, enum uio_rw rw)
+{
+	iov->iov_ubase = ubuf;
+	iov->iov_len = len;
+	u->uio_iov = iov;
+	u->uio_iovcnt = 1;
+	u->uio_offset = pos;
+	u->uio_resid = len;
+	u->uio_segflg = UIO_USERSPACE;
+	u->uio_rw = rw;
+	u->uio_space = proc_getas();
+}
+
+int
+uio_uinitv(struct iovec *iov, unsigned iovcnt, struct uio *u,
+	   off_t pos, enum uio_rw rw)
+{
+	/* The result must fit in the ssize_t that read/write return. */
+	const size_t maxresid = (size_t)-1 >> 1;
+	size_t resid;
+	unsigned i;
+
+	resid = 0;
+	for (i=0; i<iovcnt; i++) {
+		if (iov[i].iov_len > maxresid - resid) {
+			return EINVAL;
+		}
+		resid += iov[i].iov_len;
+	}
+
+	u->uio_iov = iov;
+	u->uio_iovcnt = iovcnt;
+	u->uio_offset = pos;
+	u->uio_resid = resid;
+	u->uio_segflg = UIO_USERSPACE;
+	u->uio_rw = rw;
+	u->uio_space = proc_getas();
+	return 0;
+}
@@ -39,6 +39,7 @@
 #include <spl.h>
 #include <clock.h>
 #include <thread.h>
+#include <workqueue.h>
 #include <proc.h>
 #include <current.h>
 #include <synch.h>
@@ -126,6 +127,8 @@ boot(void)
 	/* Late phase of initialization. */
 	vm_bootstrap();
 	kprintf_bootstrap();
+	clocksource_bootstrap();
+	workqueue_start();
 	thread_start_cpus();
 
 	/* Default bootfs - but ignore failure, in case emu0 doesn't exist */
@@ -35,6 +35,7 @@
 #include <lib.h>
 #include <uio.h>
 #include <clock.h>
+#include <cpu.h>
 #include <mainbus.h>
 #include <synch.h>
 #include <thread.h>
@@ -42,6 +43,7 @@
 #include <vfs.h>
 #include <sfs.h>
 #include <syscall.h>
+#include <execcache.h>
 #include <test.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
@@ -494,6 +496,54 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+static
+int
+cmd_cpustats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	cpu_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_syscallstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	syscall_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_execcachestats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	execcache_printstats();
+
+	return 0;
+}
+
+static
+int
+cmd_cpulatency(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	cpu_printlatency();
+
+	return 0;
+}
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -556,6 +606,10 @@ static const char *testmenu[] = {
 	"[at2] Large array test              ",
 	"[bt]  Bitmap test                   ",
 	"[tlt] Threadlist test               ",
+	"[atm1] Atomic operations test       ",
+	"[atm2] Atomic counter benchmark     ",
+	"[clk1] Callout/timed sleep test     ",
+	"[wq1] Workqueue test                ",
 	"[km1] Kernel malloc test            ",
 	"[km2] kmalloc stress test           ",
 	"[km3] Large kmalloc test            ",
@@ -570,6 +624,9 @@ static const char *testmenu[] = {
 	"[sy2] Lock test             (1)     ",
 	"[sy3] CV test               (1)     ",
 	"[sy4] CV test #2            (1)     ",
+	"[sy5] Semaphore ping-pong benchmark ",
+	"[sy6] Semaphore create benchmark    ",
+	"[sy7] Broadcast wakeup benchmark    ",
 	"[semu1-22] Semaphore unit tests     ",
 	"[fs1] Filesystem test               ",
 	"[fs2] FS read stress                ",
@@ -601,6 +658,10 @@ static const char *mainmenu[] = {
 	"[kh] Kernel heap stats              ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[cpus] Per-CPU scheduler stats      ",
+	"[lat] Scheduler latency (and reset) ",
+	"[sysc] Syscall stats (and reset)    ",
+	"[exc] Exec cache stats              ",
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -652,12 +713,20 @@ static struct {
 	{ "kh",         cmd_kheapstats },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "cpus",	cmd_cpustats },
+	{ "lat",	cmd_cpulatency },
+	{ "sysc",	cmd_syscallstats },
+	{ "exc",	cmd_execcachestats },
 
 	/* base system tests */
 	{ "at",		arraytest },
 	{ "at2",	arraytest2 },
 	{ "bt",		bitmaptest },
 	{ "tlt",	threadlisttest },
+	{ "atm1",	atomictest },
+	{ "atm2",	atomicbench },
+	{ "clk1",	callouttest },
+	{ "wq1",	workqueuetest },
 	{ "km1",	kmalloctest },
 	{ "km2",	kmallocstress },
 	{ "km3",	kmalloctest3 },
@@ -669,6 +738,9 @@ static struct {
 	{ "tt2",	threadtest2 },
 	{ "tt3",	threadtest3 },
 	{ "sy1",	semtest },
+	{ "sy5",	pingpongbench },
+	{ "sy6",	semcreatebench },
+	{ "sy7",	wakeallbench },
 
 	/* synchronization assignment tests */
 	{ "sy2",	locktest },
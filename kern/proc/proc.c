@@ -6,17 +6,156 @@
  * 除非你实现多线程用户进程，否则唯一拥有多个线程的进程是内核进程。
  */
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/wait.h>
+#include <limits.h>
+#include <lib.h>
 #include <spl.h>
+#include <bitmap.h>
+#include <sleepq.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
 #include <vnode.h>
+#include <filetable.h>
+#include <ioring.h>
 
 /*
  * 内核的进程；这包含所有仅内核线程。
  */
 struct proc *kproc;
 
+/*
+ * 进程表。
+ *
+ * PID 用位图分配，从上次分配的 PID 之后开始找，到 PID_MAX 后回绕
+ * （游标 pid_rotor）。PID 空间远大于同时存在的进程数，所以游标之后
+ * 几乎总是立刻就有空位，分配是 O(1) 的；刚释放的 PID 也要等游标转一圈
+ * 才会被重用。
+ *
+ * 按 PID 查找进程用哈希表，以 p_hashnext 串链。PID 是连续分配的，
+ * 直接取模就能均匀分布。
+ *
+ * 每个进程把自己的子进程串成双向链表（p_children/p_sibling/
+ * p_siblingprev），所以 waitpid 回收、退出时处理子进程都只看自己的
+ * 子进程，不扫描整个进程表。
+ *
+ * proctable_lock 保护：位图和游标、哈希链、父子链表、p_exited 和
+ * p_exitstatus。在 waitpid 中等待的线程以父进程结构体的地址为键睡在
+ * 睡眠队列上，子进程退出时唤醒它们。
+ */
+#define PROC_HASHSIZE	128
+
+static struct spinlock proctable_lock = SPINLOCK_INITIALIZER;
+static struct bitmap *pid_map;
+static unsigned pid_rotor;
+static struct proc *proc_hash[PROC_HASHSIZE];
+
+/*
+ * 分配 PID，加入哈希表，并挂到父进程 PARENT（可以为 NULL）下。
+ */
+static
+int
+proctable_add(struct proc *proc, struct proc *parent)
+{
+	unsigned pid, bucket;
+	int result;
+
+	spinlock_acquire(&proctable_lock);
+	result = bitmap_alloc_from(pid_map, pid_rotor, &pid);
+	if (result) {
+		spinlock_release(&proctable_lock);
+		return ENPROC;
+	}
+	pid_rotor = pid + 1;
+
+	proc->p_pid = pid;
+	bucket = pid % PROC_HASHSIZE;
+	proc->p_hashnext = proc_hash[bucket];
+	proc_hash[bucket] = proc;
+
+	proc->p_parent = parent;
+	if (parent != NULL) {
+		proc->p_sibling = parent->p_children;
+		if (parent->p_children != NULL) {
+			parent->p_children->p_siblingprev = &proc->p_sibling;
+		}
+		proc->p_siblingprev = &parent->p_children;
+		parent->p_children = proc;
+	}
+	spinlock_release(&proctable_lock);
+	return 0;
+}
+
+/*
+ * 从父进程的子进程链表中摘除。调用者持有 proctable_lock。
+ */
+static
+void
+proctable_unlink(struct proc *proc)
+{
+	KASSERT(spinlock_do_i_hold(&proctable_lock));
+	KASSERT(proc->p_parent != NULL);
+
+	*proc->p_siblingprev = proc->p_sibling;
+	if (proc->p_sibling != NULL) {
+		proc->p_sibling->p_siblingprev = proc->p_siblingprev;
+	}
+	proc->p_parent = NULL;
+	proc->p_sibling = NULL;
+	proc->p_siblingprev = NULL;
+}
+
+/*
+ * 从哈希表中移除并释放 PID。调用者持有 proctable_lock，且进程已经
+ * 不在任何子进程链表上。
+ */
+static
+void
+proctable_remove(struct proc *proc)
+{
+	struct proc **pp;
+
+	KASSERT(spinlock_do_i_hold(&proctable_lock));
+	KASSERT(proc->p_parent == NULL);
+
+	pp = &proc_hash[proc->p_pid % PROC_HASHSIZE];
+	while (*pp != proc) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->p_hashnext;
+	}
+	*pp = proc->p_hashnext;
+	proc->p_hashnext = NULL;
+
+	bitmap_unmark(pid_map, proc->p_pid);
+	proc->p_pid = 0;
+}
+
+/*
+ * 按 PID 查找进程。调用者持有 proctable_lock。
+ */
+static
+struct proc *
+proctable_lookup(pid_t pid)
+{
+	struct proc *proc;
+
+	KASSERT(spinlock_do_i_hold(&proctable_lock));
+
+	if (pid < PID_MIN || pid > PID_MAX) {
+		return NULL;
+	}
+	for (proc = proc_hash[pid % PROC_HASHSIZE]; proc != NULL;
+	     proc = proc->p_hashnext) {
+		if (proc->p_pid == pid) {
+			return proc;
+		}
+	}
+	return NULL;
+}
+
 /*
  * 创建进程结构。
  */
@@ -59,7 +198,7 @@ proc_create(const char *name)
 	
          
 	// 初始化进程字段
-	proc->p_numthreads = 0;           // 线程数为0
+	atomic_set(&proc->p_numthreads, 0); // 线程数为0
 	spinlock_init(&proc->p_lock);     // 初始化进程锁
 	
 	//spinlock_init(): 初始化自旋锁
@@ -76,6 +215,36 @@ proc_create(const char *name)
 
 	/* VFS 字段 - 文件系统相关 */
 	proc->p_cwd = NULL;               // 当前工作目录为空
+	proc->p_filetable = NULL;         // 还没有文件描述符表
+
+	/* 调度字段 */
+	proc->p_nice = 0;                 // 默认优先级
+
+	/* 批量 I/O：环不随 fork 继承 */
+	proc->p_ioring = NULL;
+
+	/* CPU 时间统计字段 */
+	proc->p_cputime[CPUTIME_USER] = 0;
+	proc->p_cputime[CPUTIME_SYS] = 0;
+	proc->p_cputime[CPUTIME_INTR] = 0;
+	proc->p_nvcsw = 0;
+	proc->p_nivcsw = 0;
+	proc->p_ccputime[CPUTIME_USER] = 0;
+	proc->p_ccputime[CPUTIME_SYS] = 0;
+	proc->p_ccputime[CPUTIME_INTR] = 0;
+	proc->p_cnvcsw = 0;
+	proc->p_cnivcsw = 0;
+
+	/* 进程表字段：加入进程表时才分配 PID */
+	proc->p_pid = 0;
+	proc->p_parent = NULL;
+	proc->p_children = NULL;
+	proc->p_sibling = NULL;
+	proc->p_siblingprev = NULL;
+	proc->p_hashnext = NULL;
+	proc->p_exited = false;
+	proc->p_exitstatus = 0;
+	proc->p_vfork = false;
 
 	return proc;
 }
@@ -83,7 +252,9 @@ proc_create(const char *name)
 /*
  * 销毁进程结构。
  *
- * 注意：当前没有代码调用此函数。你的 wait/exit 代码可能需要这样做。
+ * 由 waitpid 回收僵尸进程、孤儿进程退出、以及 fork 失败时调用。
+ * 前两种情况下进程已经离开进程表；fork 失败时子进程还没运行过，
+ * 在这里把它从进程表和父进程的子进程链表中拿掉。
  */
 void
 proc_destroy(struct proc *proc)
@@ -97,7 +268,18 @@ proc_destroy(struct proc *proc)
 	// 断言：进程不能为空且不能是内核进程,jin cheng de xian cheng shu liang bi xu wei 0
 	KASSERT(proc != NULL);
 	KASSERT(proc != kproc);
-	KASSERT(proc->p_numthreads == 0); 
+	KASSERT(atomic_read(&proc->p_numthreads) == 0);
+	KASSERT(proc->p_children == NULL);
+
+	/* 进程表字段 */
+	if (proc->p_pid != 0) {
+		spinlock_acquire(&proctable_lock);
+		if (proc->p_parent != NULL) {
+			proctable_unlink(proc);
+		}
+		proctable_remove(proc);
+		spinlock_release(&proctable_lock);
+	}
 
 	/*
 	 * 我们在这里不获取 p_lock，因为我们必须是此结构的唯一引用。
@@ -109,6 +291,16 @@ proc_destroy(struct proc *proc)
 		VOP_DECREF(proc->p_cwd);  // 减少当前目录的引用计数
 		proc->p_cwd = NULL;
 	}
+	if (proc->p_filetable) {
+		filetable_destroy(proc->p_filetable);  // 关闭所有描述符
+		proc->p_filetable = NULL;
+	}
+
+	/* vfork 失败时：借来的地址空间还是父进程的，不能销毁 */
+	if (proc->p_vfork) {
+		proc->p_addrspace = NULL;
+		proc->p_vfork = false;
+	}
 
 	/* VM 字段 - 虚拟内存清理 */
 	if (proc->p_addrspace) {
@@ -150,7 +342,7 @@ proc_destroy(struct proc *proc)
 	}
 
 	// 断言：进程应该没有线程了
-	KASSERT(proc->p_numthreads == 0);
+	KASSERT(atomic_read(&proc->p_numthreads) == 0);
 	spinlock_cleanup(&proc->p_lock);  // 清理自旋锁
 
 	// 释放进程名称和结构内存
@@ -168,6 +360,15 @@ proc_bootstrap(void)
 	if (kproc == NULL) {
 		panic("proc_create for kproc failed\n");
 	}
+
+	/* PID 0 到 PID_MIN-1 保留，不分配；内核进程不在进程表中 */
+	pid_map = bitmap_create(PID_MAX + 1);
+	if (pid_map == NULL) {
+		panic("proc_bootstrap: out of memory for pid bitmap\n");
+	}
+	for (pid_rotor = 0; pid_rotor < PID_MIN; pid_rotor++) {
+		bitmap_mark(pid_map, pid_rotor);
+	}
 }
 
 /*
@@ -201,9 +402,355 @@ proc_create_runprogram(const char *name)
 	}
 	spinlock_release(&curproc->p_lock);
 
+	/* 空的文件描述符表；标准输入输出由 runprogram 打开 */
+	newproc->p_filetable = filetable_create();
+	if (newproc->p_filetable == NULL) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
+	/* 调度字段：继承当前进程的 nice 值 */
+	newproc->p_nice = curproc->p_nice;
+
+	/* 内核启动的进程没有父进程，退出时自行回收 */
+	if (proctable_add(newproc, NULL)) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
 	return newproc;
 }
 
+/*
+ * 创建当前进程的子进程：共享当前目录，复制文件描述符表（与父进程
+ * 共享打开的文件和读写位置），继承 nice 值，分配 PID 并挂到
+ * 当前进程下。地址空间由调用者设置。子进程还没有线程；调用者负责
+ * 为它创建线程，失败时用 proc_destroy 撤销。
+ */
+static
+int
+proc_create_child(const char *name, struct proc **ret)
+{
+	struct proc *newproc;
+	int result;
+
+	newproc = proc_create(name);
+	if (newproc == NULL) {
+		return ENOMEM;
+	}
+
+	/* VFS 字段 */
+	spinlock_acquire(&curproc->p_lock);
+	if (curproc->p_cwd != NULL) {
+		VOP_INCREF(curproc->p_cwd);
+		newproc->p_cwd = curproc->p_cwd;
+	}
+	newproc->p_nice = curproc->p_nice;
+	spinlock_release(&curproc->p_lock);
+
+	/* 只有本进程的线程会改动它的描述符表，这里不用 p_lock */
+	if (curproc->p_filetable != NULL) {
+		result = filetable_copy(curproc->p_filetable,
+					&newproc->p_filetable);
+		if (result) {
+			proc_destroy(newproc);
+			return result;
+		}
+	}
+
+	result = proctable_add(newproc, curproc);
+	if (result) {
+		proc_destroy(newproc);
+		return result;
+	}
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * 为 fork() 创建当前进程的子进程，复制地址空间。
+ */
+int
+proc_fork(struct proc **ret)
+{
+	struct proc *newproc;
+	struct addrspace *as;
+	int result;
+
+	result = proc_create_child(curproc->p_name, &newproc);
+	if (result) {
+		return result;
+	}
+
+	/* VM 字段 */
+	as = proc_getas();
+	if (as != NULL) {
+		result = as_copy(as, &newproc->p_addrspace);
+		if (result) {
+			proc_destroy(newproc);
+			return result;
+		}
+	}
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * 为 vfork() 创建当前进程的子进程。子进程借用父进程的地址空间，
+ * 不复制；父进程要在 proc_vfork_wait 中等到子进程 exec 或退出、
+ * 归还地址空间之后才能继续运行。
+ */
+int
+proc_vfork(struct proc **ret)
+{
+	struct proc *newproc;
+	int result;
+
+	result = proc_create_child(curproc->p_name, &newproc);
+	if (result) {
+		return result;
+	}
+
+	/* VM 字段：新进程还没有线程，不用加锁 */
+	newproc->p_addrspace = proc_getas();
+	newproc->p_vfork = true;
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * 子进程归还借用的地址空间（此时它已经不再使用该地址空间），
+ * 唤醒等待的父进程。如果 PROC 确实是借用的，返回 true，此时调用者
+ * 不能销毁原来的地址空间。
+ */
+bool
+proc_vfork_done(struct proc *proc)
+{
+	bool borrowed;
+
+	spinlock_acquire(&proc->p_lock);
+	borrowed = proc->p_vfork;
+	if (borrowed) {
+		proc->p_vfork = false;
+		sleepq_wakeall(&proc->p_vfork, &proc->p_lock);
+	}
+	spinlock_release(&proc->p_lock);
+	return borrowed;
+}
+
+/*
+ * 父进程等待 vfork 的子进程 CHILD 归还地址空间。子进程只有父进程
+ * 能回收，所以在这期间 CHILD 不会消失。
+ *
+ * 睡眠键用 &CHILD->p_vfork（配 p_lock）；proc 本身是 waitpid 的键，
+ * 配的是 proctable_lock，同一个键不能配两把锁。
+ */
+void
+proc_vfork_wait(struct proc *child)
+{
+	spinlock_acquire(&child->p_lock);
+	while (child->p_vfork) {
+		sleepq_sleep(&child->p_vfork, "vfork", &child->p_lock);
+	}
+	spinlock_release(&child->p_lock);
+}
+
+/*
+ * 为 spawn() 创建当前进程的子进程，使用已经装好程序的地址空间 AS。
+ * 失败时 AS 仍归调用者所有。
+ */
+int
+proc_spawn(const char *name, struct addrspace *as, struct proc **ret)
+{
+	struct proc *newproc;
+	int result;
+
+	result = proc_create_child(name, &newproc);
+	if (result) {
+		return result;
+	}
+
+	/* VM 字段 */
+	newproc->p_addrspace = as;
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * 结束当前进程。
+ *
+ * 当前线程必须是进程中唯一的线程（环的轮询线程除外，这里先停掉它）。地址空间和打开的文件马上释放
+ * （借用的地址空间归还给 vfork 的父进程）；进程结构体
+ * 作为僵尸留到父进程 waitpid 回收为止。没有父进程的进程直接销毁。
+ *
+ * 已退出但还没被回收的子进程在这里一并回收；还在运行的子进程成为
+ * 孤儿，退出时自行销毁。
+ *
+ * 线程先挪到内核进程再发布退出状态：一旦父进程看到 p_exited，
+ * 它随时可能销毁 proc，此后不能再碰它。
+ */
+void
+proc_exit(int status)
+{
+	struct proc *proc = curproc;
+	struct proc *child, *next, *reap;
+	struct addrspace *as;
+
+	KASSERT(proc != kproc);
+
+	/* 环的轮询线程（如果有）先停下并离开本进程 */
+	ioring_destroy(proc);
+	KASSERT(atomic_read(&proc->p_numthreads) == 1);
+
+	as = proc_setas(NULL);
+	as_deactivate();
+	if (!proc_vfork_done(proc) && as != NULL) {
+		as_destroy(as);
+	}
+
+	/* 文件马上关闭，不等父进程回收 */
+	if (proc->p_filetable != NULL) {
+		filetable_destroy(proc->p_filetable);
+		proc->p_filetable = NULL;
+	}
+
+	proc_remthread(curthread);
+	proc_addthread(kproc, curthread);
+
+	/* 要销毁的进程借 p_sibling 串起来，放锁之后再销毁 */
+	reap = NULL;
+
+	spinlock_acquire(&proctable_lock);
+	for (child = proc->p_children; child != NULL; child = next) {
+		next = child->p_sibling;
+		proctable_unlink(child);
+		if (child->p_exited) {
+			proctable_remove(child);
+			child->p_sibling = reap;
+			reap = child;
+		}
+	}
+	KASSERT(proc->p_children == NULL);
+
+	if (proc->p_parent == NULL) {
+		proctable_remove(proc);
+		proc->p_sibling = reap;
+		reap = proc;
+	}
+	else {
+		proc->p_exitstatus = status;
+		proc->p_exited = true;
+		sleepq_wakeall(proc->p_parent, &proctable_lock);
+	}
+	spinlock_release(&proctable_lock);
+
+	while (reap != NULL) {
+		next = reap->p_sibling;
+		reap->p_sibling = NULL;
+		proc_destroy(reap);
+		reap = next;
+	}
+
+	thread_exit();
+}
+
+/*
+ * 把回收的子进程 CHILD 的 CPU 时间（包括它回收过的子进程的）并入
+ * 父进程 PROC 的 RUSAGE_CHILDREN 统计。CHILD 已经不在进程表中。
+ */
+static
+void
+proc_addchildtime(struct proc *proc, struct proc *child)
+{
+	unsigned i;
+
+	spinlock_acquire(&proc->p_lock);
+	for (i=0; i<CPUTIME_NTHREAD; i++) {
+		proc->p_ccputime[i] += child->p_cputime[i] +
+			child->p_ccputime[i];
+	}
+	proc->p_cnvcsw += child->p_nvcsw + child->p_cnvcsw;
+	proc->p_cnivcsw += child->p_nivcsw + child->p_cnivcsw;
+	spinlock_release(&proc->p_lock);
+}
+
+/*
+ * 等待当前进程的子进程 PID 退出，或者 PID 为 WAIT_ANY 时等待任意
+ * 子进程，然后回收它：在 *STATUS 中返回它的退出状态，在 *RET 中返回
+ * 它的 PID。指定了 WNOHANG 而子进程还没有退出时，*RET 为 0。
+ *
+ * PID 不存在时返回 ESRCH，不是当前进程的子进程（或 WAIT_ANY 时
+ * 没有子进程）时返回 ECHILD。
+ */
+int
+proc_wait(pid_t pid, int options, int *status, pid_t *ret)
+{
+	struct proc *proc = curproc;
+	struct proc *child;
+
+	if (options & ~WNOHANG) {
+		return EINVAL;
+	}
+	if (pid != WAIT_ANY && pid <= 0) {
+		/* 没有进程组 */
+		return EINVAL;
+	}
+
+	spinlock_acquire(&proctable_lock);
+	while (1) {
+		if (pid == WAIT_ANY) {
+			if (proc->p_children == NULL) {
+				spinlock_release(&proctable_lock);
+				return ECHILD;
+			}
+			for (child = proc->p_children; child != NULL;
+			     child = child->p_sibling) {
+				if (child->p_exited) {
+					break;
+				}
+			}
+		}
+		else {
+			child = proctable_lookup(pid);
+			if (child == NULL) {
+				spinlock_release(&proctable_lock);
+				return ESRCH;
+			}
+			if (child->p_parent != proc) {
+				spinlock_release(&proctable_lock);
+				return ECHILD;
+			}
+			if (!child->p_exited) {
+				child = NULL;
+			}
+		}
+
+		if (child != NULL) {
+			break;
+		}
+		if (options & WNOHANG) {
+			spinlock_release(&proctable_lock);
+			*ret = 0;
+			return 0;
+		}
+		sleepq_sleep(proc, "waitpid", &proctable_lock);
+	}
+
+	*status = child->p_exitstatus;
+	*ret = child->p_pid;
+	proctable_unlink(child);
+	proctable_remove(child);
+	spinlock_release(&proctable_lock);
+
+	proc_addchildtime(proc, child);
+	proc_destroy(child);
+	return 0;
+}
+
 /*
  * 向进程添加线程。线程或进程可能是也可能不是当前的。
  *
@@ -218,10 +765,8 @@ proc_addthread(struct proc *proc, struct thread *t)
 
 	KASSERT(t->t_proc == NULL);  // 断言线程还没有关联进程
 
-	// 增加进程的线程计数
-	spinlock_acquire(&proc->p_lock);
-	proc->p_numthreads++;
-	spinlock_release(&proc->p_lock);
+	// 增加进程的线程计数（原子操作，不需要 p_lock）
+	atomic_inc(&proc->p_numthreads);
 
 	// 关闭中断并设置线程的进程关联
 	spl = splhigh();
@@ -247,10 +792,26 @@ proc_remthread(struct thread *t)
 	proc = t->t_proc;
 	KASSERT(proc != NULL);  // 断言线程有关联的进程
 
-	// 减少进程的线程计数
+	// 减少进程的线程计数（原子操作，不需要 p_lock）
+	KASSERT(atomic_read(&proc->p_numthreads) > 0);
+	atomic_dec(&proc->p_numthreads);
+
+	// 把线程的 CPU 时间并入进程（当前线程先结算到此刻）
+	if (t == curthread) {
+		thread_cputime(CPUTIME_SYS);
+	}
 	spinlock_acquire(&proc->p_lock);
-	KASSERT(proc->p_numthreads > 0);
-	proc->p_numthreads--;
+	proc->p_cputime[CPUTIME_USER] += t->t_cputime[CPUTIME_USER];
+	proc->p_cputime[CPUTIME_SYS] += t->t_cputime[CPUTIME_SYS];
+	proc->p_cputime[CPUTIME_INTR] += t->t_cputime[CPUTIME_INTR];
+	proc->p_nvcsw += t->t_nvcsw;
+	proc->p_nivcsw += t->t_nivcsw;
+	// 清零，线程若再加入别的进程（如 kproc）不会被重复计入
+	t->t_cputime[CPUTIME_USER] = 0;
+	t->t_cputime[CPUTIME_SYS] = 0;
+	t->t_cputime[CPUTIME_INTR] = 0;
+	t->t_nvcsw = 0;
+	t->t_nivcsw = 0;
 	spinlock_release(&proc->p_lock);
 
 	// 关闭中断并清除线程的进程关联
@@ -301,3 +862,77 @@ proc_setas(struct addrspace *newas)
 	spinlock_release(&proc->p_lock);
 	return oldas;
 }
+
+/*
+ * 纳秒转换为 struct timeval。
+ */
+static
+void
+proc_ns_to_timeval(uint64_t ns, struct timeval *tv)
+{
+	tv->tv_sec = ns / 1000000000;
+	tv->tv_usec = (ns % 1000000000) / 1000;
+}
+
+/*
+ * 获取进程的资源使用情况：已离开进程的线程累计的值，加上当前线程
+ * （如果它属于该进程）到此刻为止的值。
+ *
+ * 我们没有进程的线程列表，所以其他仍在运行的线程的时间要等它们退出
+ * 才会计入；用户进程只有一个线程，因此对 curproc 来说结果是准确的。
+ *
+ * 中断时间（CPUTIME_INTR）不是为该进程花费的，不计入 ru_stime。
+ * 除 CPU 时间和上下文切换次数以外的字段都为 0。
+ */
+void
+proc_getrusage(struct proc *proc, struct rusage *ru)
+{
+	uint64_t utime, stime;
+	unsigned nvcsw, nivcsw;
+	struct thread *cur = curthread;
+
+	spinlock_acquire(&proc->p_lock);
+	utime = proc->p_cputime[CPUTIME_USER];
+	stime = proc->p_cputime[CPUTIME_SYS];
+	nvcsw = proc->p_nvcsw;
+	nivcsw = proc->p_nivcsw;
+	spinlock_release(&proc->p_lock);
+
+	if (cur->t_proc == proc) {
+		thread_cputime(CPUTIME_SYS);
+		utime += cur->t_cputime[CPUTIME_USER];
+		stime += cur->t_cputime[CPUTIME_SYS];
+		nvcsw += cur->t_nvcsw;
+		nivcsw += cur->t_nivcsw;
+	}
+
+	bzero(ru, sizeof(*ru));
+	proc_ns_to_timeval(utime, &ru->ru_utime);
+	proc_ns_to_timeval(stime, &ru->ru_stime);
+	ru->ru_nvcsw = nvcsw;
+	ru->ru_nivcsw = nivcsw;
+}
+
+/*
+ * 获取进程已回收的子进程（递归地包括它们回收的子进程）的资源使用
+ * 情况。字段含义同 proc_getrusage。
+ */
+void
+proc_getrusage_children(struct proc *proc, struct rusage *ru)
+{
+	uint64_t utime, stime;
+	unsigned nvcsw, nivcsw;
+
+	spinlock_acquire(&proc->p_lock);
+	utime = proc->p_ccputime[CPUTIME_USER];
+	stime = proc->p_ccputime[CPUTIME_SYS];
+	nvcsw = proc->p_cnvcsw;
+	nivcsw = proc->p_cnivcsw;
+	spinlock_release(&proc->p_lock);
+
+	bzero(ru, sizeof(*ru));
+	proc_ns_to_timeval(utime, &ru->ru_utime);
+	proc_ns_to_timeval(stime, &ru->ru_stime);
+	ru->ru_nvcsw = nvcsw;
+	ru->ru_nivcsw = nivcsw;
+}
@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/spawn.h>
+#include <limits.h>
+#include <lib.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <vfs.h>
+#include <copyinout.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <ioring.h>
+#include <syscall.h>
+
+/*
+ * Program execution: execv and spawn.
+ *
+ * Both copy in the path, build a new address space, stage the
+ * arguments on its stack, and load the program into it. execv then
+ * switches the caller over to it; spawn gives it to a new child
+ * process instead.
+ *
+ * The arguments are copied once, from the caller's memory straight
+ * to their final place in the new stack, through the window that
+ * as_stackwindow gives onto it. That needs their total size before
+ * anything is copied, so we make two passes over the caller's
+ * argv: one to measure the strings, one to copy them. Scanning is
+ * much cheaper than copying, and the second pass finds the strings
+ * in the cache.
+ */
+
+/*
+ * Where the arguments ended up in the new address space.
+ */
+struct execargs {
+	int ea_argc;
+	userptr_t ea_argv;	/* user address of argv */
+	vaddr_t ea_stackptr;	/* initial stack pointer, below argv */
+};
+
+/*
+ * Copy the NULL-terminated argument vector at user address UARGV onto
+ * the top of the stack of AS, which is not the current address space:
+ * the strings at the top, then the argv array pointing at them. The
+ * strings and the array together must fit in ARG_MAX, or we fail
+ * with E2BIG.
+ */
+static
+int
+execargs_stage(userptr_t uargv, struct addrspace *as, struct execargs *ea)
+{
+	userptr_t uarg, *kargv;
+	vaddr_t ktop, strbase, argvbase;
+	size_t winlen, total, need, len, pos;
+	char *kstr;
+	int argc, i, result;
+
+	result = as_stackwindow(as, &ktop, &winlen);
+	if (result) {
+		return result;
+	}
+
+	/* Pass 1: count and measure. */
+	argc = 0;
+	total = 0;
+	while (1) {
+		result = copyin(uargv + argc * sizeof(userptr_t), &uarg,
+				sizeof(uarg));
+		if (result) {
+			return result;
+		}
+		if (uarg == NULL) {
+			break;
+		}
+		/* Leave room for this pointer and the final NULL. */
+		need = total + (argc + 2) * sizeof(userptr_t);
+		if (need >= ARG_MAX) {
+			return E2BIG;
+		}
+		result = copyinstrlen(uarg, ARG_MAX - need, &len);
+		if (result == ENAMETOOLONG) {
+			result = E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		total += len;
+		argc++;
+	}
+
+	/* Lay out the block; the stack pointer must be 8-byte aligned. */
+	strbase = USERSTACK - ROUNDUP(total, sizeof(userptr_t));
+	argvbase = (strbase - (argc + 1) * sizeof(userptr_t)) & ~(vaddr_t)7;
+	if (USERSTACK - argvbase > winlen) {
+		return E2BIG;
+	}
+	kstr = (char *)(ktop - (USERSTACK - strbase));
+	kargv = (userptr_t *)(ktop - (USERSTACK - argvbase));
+
+	/*
+	 * Pass 2: copy into place. If the caller's strings grew in
+	 * the meantime they no longer fit; treat that as E2BIG.
+	 */
+	pos = 0;
+	for (i=0; i<argc; i++) {
+		result = copyin(uargv + i * sizeof(userptr_t), &uarg,
+				sizeof(uarg));
+		if (result) {
+			return result;
+		}
+		if (uarg == NULL) {
+			return EFAULT;
+		}
+		result = copyinstr(uarg, kstr + pos, total - pos, &len);
+		if (result == ENAMETOOLONG) {
+			result = E2BIG;
+		}
+		if (result) {
+			return result;
+		}
+		kargv[i] = (userptr_t)(strbase + pos);
+		pos += len;
+	}
+	kargv[argc] = NULL;
+
+	ea->ea_argc = argc;
+	ea->ea_argv = (userptr_t)argvbase;
+	ea->ea_stackptr = argvbase;
+	return 0;
+}
+
+/*
+ * Build a new address space for the program at PATH with the
+ * arguments at user address UARGV, and make it the current process's
+ * address space. The one it replaces is returned in *OLDAS; the
+ * caller either destroys it (execv) or switches back to it (spawn).
+ * On error the current address space is left as it was.
+ *
+ * Calls vfs_open on PATH and thus may destroy it.
+ */
+static
+int
+exec_load(char *path, userptr_t uargv, struct addrspace **oldas,
+	  vaddr_t *entrypoint, struct execargs *ea)
+{
+	struct addrspace *as, *old;
+	struct vnode *v;
+	vaddr_t stackptr;
+	int result;
+
+	result = vfs_open(path, O_RDONLY, 0, &v);
+	if (result) {
+		return result;
+	}
+
+	as = as_create();
+	if (as == NULL) {
+		vfs_close(v);
+		return ENOMEM;
+	}
+
+	/* Stage the arguments while the caller's memory is still mapped. */
+	result = execargs_stage(uargv, as, ea);
+	if (result) {
+		vfs_close(v);
+		as_destroy(as);
+		return result;
+	}
+
+	old = proc_setas(as);
+	as_activate();
+
+	result = load_elf(v, entrypoint);
+	vfs_close(v);
+	if (result) {
+		goto fail;
+	}
+
+	result = as_define_stack(as, &stackptr);
+	if (result) {
+		goto fail;
+	}
+	KASSERT(stackptr == USERSTACK);
+
+	*oldas = old;
+	return 0;
+
+ fail:
+	proc_setas(old);
+	as_activate();
+	as_destroy(as);
+	return result;
+}
+
+/*
+ * execv: replace the calling process's program with the one at PATH,
+ * passing it the arguments in ARGV. Returns only on error.
+ *
+ * A child of vfork gives the address space it borrowed back to its
+ * parent here, instead of destroying it.
+ *
+ * A uring_setup ring goes away with the old program.
+ */
+int
+sys_execv(const_userptr_t path, userptr_t argv)
+{
+	struct execargs ea;
+	struct addrspace *oldas;
+	vaddr_t entrypoint;
+	char *kpath;
+	int result;
+
+	kpath = kmalloc(PATH_MAX);
+	if (kpath == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(path, kpath, PATH_MAX, NULL);
+	if (result) {
+		kfree(kpath);
+		return result;
+	}
+
+	/* The ring lives in the old address space. */
+	ioring_pause(curproc);
+	result = exec_load(kpath, argv, &oldas, &entrypoint, &ea);
+	kfree(kpath);
+	if (result) {
+		ioring_resume(curproc);
+		return result;
+	}
+	ioring_destroy(curproc);
+
+	if (!proc_vfork_done(curproc) && oldas != NULL) {
+		as_destroy(oldas);
+	}
+
+	enter_new_process(ea.ea_argc, ea.ea_argv, NULL, ea.ea_stackptr,
+			  entrypoint);
+}
+
+/*
+ * Where a spawned child starts running in user mode.
+ */
+struct spawnstart {
+	struct execargs ss_args;
+	vaddr_t ss_entrypoint;
+};
+
+static
+void
+spawn_child_entry(void *data1, unsigned long data2)
+{
+	struct spawnstart ss;
+
+	(void)data2;
+	ss = *(struct spawnstart *)data1;
+	kfree(data1);
+
+	as_activate();
+	enter_new_process(ss.ss_args.ea_argc, ss.ss_args.ea_argv, NULL,
+			  ss.ss_args.ea_stackptr, ss.ss_entrypoint);
+}
+
+/*
+ * Apply the file action list at user address ACTIONS, which may be
+ * NULL for none, to FT, the new child's file table. PATHBUF is
+ * PATH_MAX bytes of scratch space for SPAWN_OPEN paths. The child
+ * has no thread yet, so nothing else uses FT.
+ */
+static
+int
+spawn_fileactions(struct filetable *ft, const_userptr_t actions,
+		  char *pathbuf)
+{
+	struct spawn_action sfa;
+	struct openfile *of, *oldfile;
+	bool held;
+	int result;
+
+	if (actions == NULL) {
+		return 0;
+	}
+
+	while (1) {
+		result = copyin(actions, &sfa, sizeof(sfa));
+		if (result) {
+			return result;
+		}
+		actions += sizeof(sfa);
+
+		switch (sfa.sfa_op) {
+		    case SPAWN_END:
+			return 0;
+		    case SPAWN_CLOSE:
+			result = filetable_remove(ft, sfa.sfa_fd, &of);
+			if (result) {
+				return result;
+			}
+			openfile_decref(of);
+			continue;
+		    case SPAWN_DUP2:
+			result = filetable_get(ft, sfa.sfa_srcfd, false,
+					       &of, &held);
+			if (result) {
+				return result;
+			}
+			if (sfa.sfa_srcfd == sfa.sfa_fd) {
+				continue;
+			}
+			openfile_incref(of);
+			break;
+		    case SPAWN_OPEN:
+			result = copyinstr((const_userptr_t)sfa.sfa_path,
+					   pathbuf, PATH_MAX, NULL);
+			if (result) {
+				return result;
+			}
+			result = openfile_open(pathbuf, sfa.sfa_flags,
+					       sfa.sfa_mode, &of);
+			if (result) {
+				return result;
+			}
+			break;
+		    default:
+			return EINVAL;
+		}
+
+		/* SPAWN_DUP2 and SPAWN_OPEN: install OF as sfa_fd */
+		result = filetable_placeat(ft, of, sfa.sfa_fd, &oldfile);
+		if (result) {
+			openfile_decref(of);
+			return result;
+		}
+		if (oldfile != NULL) {
+			openfile_decref(oldfile);
+		}
+	}
+}
+
+/*
+ * spawn: start the program at PATH, with arguments ARGV, in a new
+ * child process, and return the child's pid.
+ *
+ * Unlike fork and exec, this never copies the caller's address
+ * space: the child's is built from the executable directly. The
+ * program is loaded here, in the caller's context, so that a bad
+ * path or executable is reported by spawn itself. While it loads,
+ * the new address space is the current one; the caller's is put
+ * back before we return. That is safe only because user processes
+ * have one thread, apart from a ring poller, which is paused.
+ */
+int
+sys_spawn(const_userptr_t path, userptr_t argv, const_userptr_t actions,
+	  int32_t *retval)
+{
+	struct addrspace *oldas, *newas;
+	struct spawnstart *ss;
+	struct proc *newproc;
+	userptr_t arg0;
+	char *kpath;
+	const char *name;
+	pid_t pid;
+	int result;
+
+	ss = kmalloc(sizeof(*ss));
+	if (ss == NULL) {
+		return ENOMEM;
+	}
+	kpath = kmalloc(PATH_MAX);
+	if (kpath == NULL) {
+		kfree(ss);
+		return ENOMEM;
+	}
+	result = copyinstr(path, kpath, PATH_MAX, NULL);
+	if (result) {
+		goto fail;
+	}
+
+	ioring_pause(curproc);
+	result = exec_load(kpath, argv, &oldas, &ss->ss_entrypoint,
+			   &ss->ss_args);
+	if (result) {
+		ioring_resume(curproc);
+		goto fail;
+	}
+
+	/*
+	 * Name the child after argv[0], as the shell would show it.
+	 * The string is on the new stack, which is still current.
+	 */
+	name = curproc->p_name;
+	if (ss->ss_args.ea_argc > 0 &&
+	    copyin(ss->ss_args.ea_argv, &arg0, sizeof(arg0)) == 0 &&
+	    copyinstr(arg0, kpath, PATH_MAX, NULL) == 0) {
+		name = kpath;
+	}
+
+	/* Put our own address space back. */
+	newas = proc_setas(oldas);
+	as_activate();
+	ioring_resume(curproc);
+
+	result = proc_spawn(name, newas, &newproc);
+	if (result) {
+		as_destroy(newas);
+		goto fail;
+	}
+	pid = newproc->p_pid;
+
+	result = spawn_fileactions(newproc->p_filetable, actions, kpath);
+	if (result) {
+		proc_destroy(newproc);
+		goto fail;
+	}
+
+	result = thread_fork(curthread->t_name, newproc, spawn_child_entry,
+			     ss, 0);
+	if (result) {
+		proc_destroy(newproc);
+		goto fail;
+	}
+
+	kfree(kpath);
+	*retval = pid;
+	return 0;
+
+ fail:
+	kfree(kpath);
+	kfree(ss);
+	return result;
+}
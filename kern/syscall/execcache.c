@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Executable image cache. See execcache.h.
+ *
+ * The cache is small and looked up once per exec, so it is a plain
+ * array searched linearly under a spinlock, with least-recently-used
+ * replacement. Each entry holds a reference to its vnode (so the
+ * pointer stays unique) and to its shared text, if any. Dropping
+ * those references can sleep, so it is always done after the
+ * spinlock is released.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <addrspace.h>
+#include <vnode.h>
+#include <execcache.h>
+
+#define EXECCACHE_SIZE	16
+
+struct execcache_entry {
+	struct vnode *ece_vnode;	/* NULL if the slot is free */
+	unsigned ece_lastuse;		/* execcache_clock at last hit */
+	struct execimage ece_img;
+};
+
+static struct spinlock execcache_lock = SPINLOCK_INITIALIZER;
+static struct execcache_entry execcache[EXECCACHE_SIZE];
+static unsigned execcache_clock;
+
+/* Statistics, protected by execcache_lock. */
+static unsigned execcache_hits;
+static unsigned execcache_misses;
+static unsigned execcache_evictions;
+static unsigned execcache_pagesshared;	/* text pages mapped on hits */
+
+/*
+ * Find the entry for V. Call with execcache_lock held.
+ */
+static
+struct execcache_entry *
+execcache_find(struct vnode *v)
+{
+	unsigned i;
+
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i].ece_vnode == v) {
+			return &execcache[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Empty an entry, handing back what it held so the caller can drop
+ * the references once it has released execcache_lock.
+ */
+static
+void
+execcache_clear(struct execcache_entry *ece,
+		struct vnode **v, struct astext **text)
+{
+	*v = ece->ece_vnode;
+	*text = ece->ece_img.ei_text;
+	ece->ece_vnode = NULL;
+	ece->ece_img.ei_text = NULL;
+}
+
+static
+void
+execcache_drop(struct vnode *v, struct astext *text)
+{
+	if (text != NULL) {
+		as_text_release(text);
+	}
+	if (v != NULL) {
+		VOP_DECREF(v);
+	}
+}
+
+bool
+execcache_lookup(struct vnode *v, struct execimage *img)
+{
+	struct execcache_entry *ece;
+
+	spinlock_acquire(&execcache_lock);
+	ece = execcache_find(v);
+	if (ece == NULL) {
+		execcache_misses++;
+		spinlock_release(&execcache_lock);
+		return false;
+	}
+	ece->ece_lastuse = ++execcache_clock;
+	*img = ece->ece_img;
+	if (img->ei_text != NULL) {
+		as_text_hold(img->ei_text);
+		execcache_pagesshared += img->ei_textpages;
+	}
+	execcache_hits++;
+	spinlock_release(&execcache_lock);
+	return true;
+}
+
+void
+execcache_insert(struct vnode *v, const struct execimage *img)
+{
+	struct execcache_entry *ece;
+	struct vnode *oldv = NULL;
+	struct astext *oldtext = NULL;
+	unsigned i;
+
+	KASSERT(img->ei_nsegs <= EXECIMAGE_MAXSEGS);
+
+	spinlock_acquire(&execcache_lock);
+	if (execcache_find(v) != NULL) {
+		/* Someone else loaded it at the same time; keep theirs. */
+		spinlock_release(&execcache_lock);
+		execcache_drop(NULL, img->ei_text);
+		return;
+	}
+
+	/* Take a free slot, or else the least recently used one. */
+	ece = &execcache[0];
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i].ece_vnode == NULL) {
+			ece = &execcache[i];
+			break;
+		}
+		if (execcache[i].ece_lastuse < ece->ece_lastuse) {
+			ece = &execcache[i];
+		}
+	}
+	if (ece->ece_vnode != NULL) {
+		execcache_clear(ece, &oldv, &oldtext);
+		execcache_evictions++;
+	}
+
+	VOP_INCREF(v);
+	ece->ece_vnode = v;
+	ece->ece_lastuse = ++execcache_clock;
+	ece->ece_img = *img;
+	spinlock_release(&execcache_lock);
+
+	execcache_drop(oldv, oldtext);
+}
+
+/*
+ * This is called on every write, so first look without the lock,
+ * which is almost always enough to see V isn't cached. An entry
+ * being added for V at the same time is for a load that read the
+ * file before this write finished, which is no different from the
+ * load happening first.
+ */
+void
+execcache_purge(struct vnode *v)
+{
+	struct execcache_entry *ece;
+	struct vnode *oldv = NULL;
+	struct astext *oldtext = NULL;
+	unsigned i;
+
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		if (execcache[i].ece_vnode == v) {
+			break;
+		}
+	}
+	if (i == EXECCACHE_SIZE) {
+		return;
+	}
+
+	spinlock_acquire(&execcache_lock);
+	ece = execcache_find(v);
+	if (ece != NULL) {
+		execcache_clear(ece, &oldv, &oldtext);
+	}
+	spinlock_release(&execcache_lock);
+
+	execcache_drop(oldv, oldtext);
+}
+
+void
+execcache_flush(void)
+{
+	struct vnode *oldv;
+	struct astext *oldtext;
+	unsigned i;
+
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		oldv = NULL;
+		oldtext = NULL;
+		spinlock_acquire(&execcache_lock);
+		if (execcache[i].ece_vnode != NULL) {
+			execcache_clear(&execcache[i], &oldv, &oldtext);
+		}
+		spinlock_release(&execcache_lock);
+		execcache_drop(oldv, oldtext);
+	}
+}
+
+/*
+ * Print the counters and, for each cached program, how many address
+ * spaces map its text. Every sharer beyond the first is a copy of
+ * the text we did not have to allocate and read in.
+ */
+void
+execcache_printstats(void)
+{
+	struct execcache_entry *ece;
+	unsigned i, users, saved, entries;
+	unsigned hits, misses, evictions, pagesshared;
+
+	entries = 0;
+	saved = 0;
+	spinlock_acquire(&execcache_lock);
+	for (i=0; i<EXECCACHE_SIZE; i++) {
+		ece = &execcache[i];
+		if (ece->ece_vnode == NULL) {
+			continue;
+		}
+		entries++;
+		if (ece->ece_img.ei_text == NULL) {
+			continue;
+		}
+		/* One of the references is ours. */
+		users = as_text_users(ece->ece_img.ei_text) - 1;
+		if (users > 1) {
+			saved += (users - 1) * ece->ece_img.ei_textpages;
+		}
+	}
+	hits = execcache_hits;
+	misses = execcache_misses;
+	evictions = execcache_evictions;
+	pagesshared = execcache_pagesshared;
+	spinlock_release(&execcache_lock);
+
+	kprintf("execcache: %u entries, %u hits, %u misses, %u evictions\n",
+		entries, hits, misses, evictions);
+	kprintf("execcache: %u text pages mapped from cache; "
+		"%u pages (%uK) saved now\n",
+		pagesshared, saved, saved * PAGE_SIZE / 1024);
+}
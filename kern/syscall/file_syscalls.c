@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File-related system calls.
+ *
+ * Descriptors index the current process's filetable (filetable.h),
+ * whose entries are openfiles (openfile.h).
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/seek.h>
+#include <kern/stat.h>
+#include <limits.h>
+#include <lib.h>
+#include <uio.h>
+#include <current.h>
+#include <proc.h>
+#include <vnode.h>
+#include <vfs.h>
+#include <copyinout.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <execcache.h>
+#include <pipe.h>
+#include <syscall.h>
+
+/*
+ * Look up descriptor FD of the current process. This takes no lock,
+ * and unless other threads share our table no reference either;
+ * pass *HELD to filetable_put when done.
+ */
+static
+int
+file_get(int fd, struct openfile **ret, bool *held)
+{
+	return filetable_get(curproc->p_filetable, fd,
+			     atomic_read(&curproc->p_numthreads) > 1,
+			     ret, held);
+}
+
+/*
+ * Do the I/O described by UIO on descriptor FD. If POSITIONED, at
+ * the offset already in UIO, leaving the seek position alone (pread
+ * and pwrite); otherwise at, and advancing, the seek position. The
+ * byte count transferred goes in *RETVAL.
+ */
+static
+int
+file_io(int fd, struct uio *uio, bool positioned, int32_t *retval)
+{
+	struct openfile *of;
+	struct vnode *vn;
+	struct stat st;
+	size_t len;
+	bool held, locked, seekable;
+	int result;
+
+	result = file_get(fd, &of, &held);
+	if (result) {
+		return result;
+	}
+	vn = of->of_vnode;
+	seekable = VOP_ISSEEKABLE(vn);
+
+	if (uio->uio_rw == UIO_READ ?
+	    !OPENFILE_CANREAD(of) : !OPENFILE_CANWRITE(of)) {
+		filetable_put(of, held);
+		return EBADF;
+	}
+
+	locked = false;
+	if (positioned) {
+		if (!seekable) {
+			result = ESPIPE;
+			goto out;
+		}
+		if (uio->uio_offset < 0) {
+			result = EINVAL;
+			goto out;
+		}
+	}
+	else if (seekable) {
+		locked = openfile_lockoffset(of);
+		if (of->of_append && uio->uio_rw == UIO_WRITE) {
+			result = VOP_STAT(vn, &st);
+			if (result) {
+				goto out;
+			}
+			of->of_offset = st.st_size;
+		}
+		uio->uio_offset = of->of_offset;
+	}
+
+	len = uio->uio_resid;
+	if (uio->uio_rw == UIO_READ) {
+		result = VOP_READ(vn, uio);
+	}
+	else {
+		/* A file being changed can't run from the exec cache. */
+		execcache_purge(vn);
+		result = VOP_WRITE(vn, uio);
+	}
+	/* Pipes and devices like the console have no seek position. */
+	if (!positioned && seekable) {
+		of->of_offset = uio->uio_offset;
+	}
+	if (result == 0) {
+		*retval = len - uio->uio_resid;
+	}
+
+ out:
+	openfile_unlockoffset(of, locked);
+	filetable_put(of, held);
+	return result;
+}
+
+/*
+ * open: open PATH and return the lowest free descriptor for it.
+ */
+int
+sys_open(const_userptr_t path, int flags, mode_t mode, int32_t *retval)
+{
+	struct openfile *of;
+	char *kpath;
+	int fd, result;
+
+	kpath = kmalloc(PATH_MAX);
+	if (kpath == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(path, kpath, PATH_MAX, NULL);
+	if (result) {
+		kfree(kpath);
+		return result;
+	}
+
+	result = openfile_open(kpath, flags, mode, &of);
+	kfree(kpath);
+	if (result) {
+		return result;
+	}
+
+	result = filetable_place(curproc->p_filetable, of, &fd);
+	if (result) {
+		openfile_decref(of);
+		return result;
+	}
+
+	*retval = fd;
+	return 0;
+}
+
+/*
+ * close: release descriptor FD. The file itself is closed when its
+ * last descriptor (in any process) goes.
+ */
+int
+sys_close(int fd)
+{
+	struct openfile *of;
+	int result;
+
+	result = filetable_remove(curproc->p_filetable, fd, &of);
+	if (result) {
+		return result;
+	}
+	openfile_decref(of);
+	return 0;
+}
+
+/*
+ * dup2: make NEWFD refer to the same open file as OLDFD, closing
+ * whatever NEWFD referred to before.
+ */
+int
+sys_dup2(int oldfd, int newfd, int32_t *retval)
+{
+	struct openfile *of, *oldfile;
+	bool held;
+	int result;
+
+	result = file_get(oldfd, &of, &held);
+	if (result) {
+		return result;
+	}
+
+	if (oldfd != newfd) {
+		openfile_incref(of);
+		result = filetable_placeat(curproc->p_filetable, of, newfd,
+					   &oldfile);
+		if (result) {
+			openfile_decref(of);
+			filetable_put(of, held);
+			return result;
+		}
+		if (oldfile != NULL) {
+			openfile_decref(oldfile);
+		}
+	}
+	filetable_put(of, held);
+
+	*retval = newfd;
+	return 0;
+}
+
+int
+sys_read(int fd, userptr_t buf, size_t len, int32_t *retval)
+{
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, buf, len, 0, UIO_READ);
+	return file_io(fd, &u, false, retval);
+}
+
+int
+sys_write(int fd, const_userptr_t buf, size_t len, int32_t *retval)
+{
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, (userptr_t)buf, len, 0, UIO_WRITE);
+	return file_io(fd, &u, false, retval);
+}
+
+int
+sys_pread(int fd, userptr_t buf, size_t len, off_t pos, int32_t *retval)
+{
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, buf, len, pos, UIO_READ);
+	return file_io(fd, &u, true, retval);
+}
+
+int
+sys_pwrite(int fd, const_userptr_t buf, size_t len, off_t pos,
+	   int32_t *retval)
+{
+	struct iovec iov;
+	struct uio u;
+
+	uio_uinit(&iov, &u, (userptr_t)buf, len, pos, UIO_WRITE);
+	return file_io(fd, &u, true, retval);
+}
+
+/*
+ * Vectored I/O: copy in the user's iovec array and pass the whole
+ * list to the file system as one uio, so a call costs one VOP_READ
+ * or VOP_WRITE however many buffers it has. Short lists, the common
+ * case, are copied onto the stack.
+ */
+#define FILE_STACKIOVS	8
+
+static
+int
+file_iov(int fd, const_userptr_t uiov, int iovcnt, off_t pos,
+	 bool positioned, enum uio_rw rw, int32_t *retval)
+{
+	struct iovec stackiov[FILE_STACKIOVS];
+	struct iovec *iov;
+	struct uio u;
+	int result;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX) {
+		return EINVAL;
+	}
+	if (iovcnt <= FILE_STACKIOVS) {
+		iov = stackiov;
+	}
+	else {
+		iov = kmalloc(iovcnt * sizeof(*iov));
+		if (iov == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	result = copyin(uiov, iov, iovcnt * sizeof(*iov));
+	if (result == 0) {
+		result = uio_uinitv(iov, iovcnt, &u, pos, rw);
+	}
+	if (result == 0) {
+		result = file_io(fd, &u, positioned, retval);
+	}
+
+	if (iov != stackiov) {
+		kfree(iov);
+	}
+	return result;
+}
+
+int
+sys_readv(int fd, const_userptr_t iov, int iovcnt, int32_t *retval)
+{
+	return file_iov(fd, iov, iovcnt, 0, false, UIO_READ, retval);
+}
+
+int
+sys_writev(int fd, const_userptr_t iov, int iovcnt, int32_t *retval)
+{
+	return file_iov(fd, iov, iovcnt, 0, false, UIO_WRITE, retval);
+}
+
+int
+sys_preadv(int fd, const_userptr_t iov, int iovcnt, off_t pos,
+	   int32_t *retval)
+{
+	return file_iov(fd, iov, iovcnt, pos, true, UIO_READ, retval);
+}
+
+int
+sys_pwritev(int fd, const_userptr_t iov, int iovcnt, off_t pos,
+	    int32_t *retval)
+{
+	return file_iov(fd, iov, iovcnt, pos, true, UIO_WRITE, retval);
+}
+
+/*
+ * lseek: set the seek position of FD to POS relative to the start,
+ * the current position, or the end, per WHENCE.
+ */
+int
+sys_lseek(int fd, off_t pos, int whence, off_t *retval)
+{
+	struct openfile *of;
+	struct stat st;
+	off_t newpos;
+	bool held, locked;
+	int result;
+
+	result = file_get(fd, &of, &held);
+	if (result) {
+		return result;
+	}
+	if (!VOP_ISSEEKABLE(of->of_vnode)) {
+		filetable_put(of, held);
+		return ESPIPE;
+	}
+
+	locked = openfile_lockoffset(of);
+	switch (whence) {
+	    case SEEK_SET:
+		newpos = pos;
+		break;
+	    case SEEK_CUR:
+		newpos = of->of_offset + pos;
+		break;
+	    case SEEK_END:
+		result = VOP_STAT(of->of_vnode, &st);
+		if (result) {
+			goto out;
+		}
+		newpos = st.st_size + pos;
+		break;
+	    default:
+		result = EINVAL;
+		goto out;
+	}
+	if (newpos < 0) {
+		result = EINVAL;
+		goto out;
+	}
+	of->of_offset = newpos;
+	*retval = newpos;
+
+ out:
+	openfile_unlockoffset(of, locked);
+	filetable_put(of, held);
+	return result;
+}
+
+/*
+ * stat: copy the attributes of the file named by PATH to STATBUF.
+ */
+int
+sys_stat(const_userptr_t path, userptr_t statbuf)
+{
+	struct vnode *vn;
+	struct stat st;
+	char *kpath;
+	int result;
+
+	kpath = kmalloc(PATH_MAX);
+	if (kpath == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(path, kpath, PATH_MAX, NULL);
+	if (result) {
+		kfree(kpath);
+		return result;
+	}
+
+	result = vfs_lookup(kpath, &vn);
+	kfree(kpath);
+	if (result) {
+		return result;
+	}
+	result = VOP_STAT(vn, &st);
+	VOP_DECREF(vn);
+	if (result) {
+		return result;
+	}
+	return copyout(&st, statbuf, sizeof(st));
+}
+
+/*
+ * fstat: copy the attributes of the file open on FD to STATBUF.
+ */
+int
+sys_fstat(int fd, userptr_t statbuf)
+{
+	struct openfile *of;
+	struct stat st;
+	bool held;
+	int result;
+
+	result = file_get(fd, &of, &held);
+	if (result) {
+		return result;
+	}
+	result = VOP_STAT(of->of_vnode, &st);
+	filetable_put(of, held);
+	if (result) {
+		return result;
+	}
+	return copyout(&st, statbuf, sizeof(st));
+}
+
+/*
+ * pipe: make a pipe and return descriptors for its read and write
+ * ends in FDS[0] and FDS[1].
+ */
+int
+sys_pipe(userptr_t fds)
+{
+	struct vnode *rdvn, *wrvn;
+	struct openfile *rdfile, *wrfile, *junk;
+	int kfds[2];
+	int result;
+
+	result = pipe_create(&rdvn, &wrvn);
+	if (result) {
+		return result;
+	}
+	result = openfile_create(rdvn, O_RDONLY, &rdfile);
+	if (result) {
+		vfs_close(rdvn);
+		vfs_close(wrvn);
+		return result;
+	}
+	result = openfile_create(wrvn, O_WRONLY, &wrfile);
+	if (result) {
+		openfile_decref(rdfile);
+		vfs_close(wrvn);
+		return result;
+	}
+
+	result = filetable_place(curproc->p_filetable, rdfile, &kfds[0]);
+	if (result) {
+		goto fail;
+	}
+	result = filetable_place(curproc->p_filetable, wrfile, &kfds[1]);
+	if (result) {
+		filetable_remove(curproc->p_filetable, kfds[0], &junk);
+		goto fail;
+	}
+
+	result = copyout(kfds, fds, sizeof(kfds));
+	if (result) {
+		filetable_remove(curproc->p_filetable, kfds[0], &junk);
+		filetable_remove(curproc->p_filetable, kfds[1], &junk);
+		goto fail;
+	}
+	return 0;
+
+ fail:
+	openfile_decref(rdfile);
+	openfile_decref(wrfile);
+	return result;
+}
+
+/*
+ * splice: move up to LEN bytes from FROMFD to TOFD, one of which must
+ * be a pipe, without passing them through user memory. The data is
+ * copied once, between the pipe's buffer and the other file. The
+ * other file's seek position is used and advanced as by read/write.
+ * Like read, returns what is available rather than waiting for all
+ * of LEN; 0 means the pipe being read is at end of file.
+ */
+int
+sys_splice(int fromfd, int tofd, size_t len, int32_t *retval)
+{
+	struct openfile *from, *to, *other;
+	struct stat st;
+	off_t pos;
+	size_t moved;
+	bool fromheld, toheld, locked, seekable;
+	int result;
+
+	result = file_get(fromfd, &from, &fromheld);
+	if (result) {
+		return result;
+	}
+	result = file_get(tofd, &to, &toheld);
+	if (result) {
+		filetable_put(from, fromheld);
+		return result;
+	}
+
+	if (!OPENFILE_CANREAD(from) || !OPENFILE_CANWRITE(to)) {
+		result = EBADF;
+		goto done;
+	}
+	if (pipe_isread(from->of_vnode)) {
+		other = to;
+	}
+	else if (pipe_iswrite(to->of_vnode)) {
+		other = from;
+	}
+	else {
+		result = EINVAL;
+		goto done;
+	}
+	if (pipe_same(from->of_vnode, to->of_vnode)) {
+		result = EINVAL;
+		goto done;
+	}
+
+	/* The count must fit in the ssize_t we return. */
+	if (len > (size_t)-1 >> 1) {
+		len = (size_t)-1 >> 1;
+	}
+
+	locked = false;
+	pos = 0;
+	seekable = VOP_ISSEEKABLE(other->of_vnode);
+	if (seekable) {
+		locked = openfile_lockoffset(other);
+		if (other == to && to->of_append) {
+			result = VOP_STAT(to->of_vnode, &st);
+			if (result) {
+				openfile_unlockoffset(other, locked);
+				goto done;
+			}
+			to->of_offset = st.st_size;
+		}
+		pos = other->of_offset;
+	}
+
+	if (other == to) {
+		execcache_purge(to->of_vnode);
+		result = pipe_splice_out(from->of_vnode, to->of_vnode, &pos,
+					 len, &moved);
+	}
+	else {
+		result = pipe_splice_in(to->of_vnode, from->of_vnode, &pos,
+					len, &moved);
+	}
+
+	if (seekable) {
+		other->of_offset = pos;
+	}
+	openfile_unlockoffset(other, locked);
+	if (result == 0) {
+		*retval = moved;
+	}
+
+ done:
+	filetable_put(to, toheld);
+	filetable_put(from, fromheld);
+	return result;
+}
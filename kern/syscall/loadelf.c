@@ -32,7 +32,8 @@
  * Code to load an ELF-format executable into the current address space.
  *
  * It makes the following address space calls:
- *    - first, as_define_region once for each segment of the program;
+ *    - first, as_define_region once for each segment of the program
+ *      (or as_define_text, for text shared through the exec cache);
  *    - then, as_prepare_load;
  *    - then it loads each chunk of the program;
  *    - finally, as_complete_load.
@@ -59,6 +60,7 @@
 #include <addrspace.h>
 #include <vnode.h>
 #include <elf.h>
+#include <execcache.h>
 
 /*
  * Load a segment at virtual address VADDR. The segment in memory
@@ -146,21 +148,18 @@ load_segment(struct addrspace *as, struct vnode *v,
 }
 
 /*
- * Load an ELF executable user program into the current address space.
- *
- * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ * Read and check the executable header and program headers of V,
+ * and collect the loadable segments into IMG.
  */
+static
 int
-load_elf(struct vnode *v, vaddr_t *entrypoint)
+elf_readheaders(struct vnode *v, struct execimage *img)
 {
 	Elf_Ehdr eh;   /* Executable header */
 	Elf_Phdr ph;   /* "Program header" = segment header */
 	int result, i;
 	struct iovec iov;
 	struct uio ku;
-	struct addrspace *as;
-
-	as = proc_getas();
 
 	/*
 	 * Read the executable header from offset 0 in the file.
@@ -202,13 +201,20 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 		return ENOEXEC;
 	}
 
+	img->ei_entry = eh.e_entry;
+	img->ei_nsegs = 0;
+	img->ei_textseg = -1;
+	img->ei_text = NULL;
+	img->ei_textpages = 0;
+
 	/*
-	 * Go through the list of segments and set up the address space.
+	 * Go through the list of segments and pick out the ones to
+	 * load.
 	 *
 	 * Ordinarily there will be one code segment, one read-only
 	 * data segment, and one data/bss segment, but there might
-	 * conceivably be more. You don't need to support such files
-	 * if it's unduly awkward to do so.
+	 * conceivably be more. We allow up to EXECIMAGE_MAXSEGS,
+	 * which is more than dumbvm can handle anyway.
 	 *
 	 * Note that the expression eh.e_phoff + i*eh.e_phentsize is
 	 * mandated by the ELF standard - we use sizeof(ph) to load,
@@ -243,65 +249,136 @@ load_elf(struct vnode *v, vaddr_t *entrypoint)
 			return ENOEXEC;
 		}
 
-		result = as_define_region(as,
-					  ph.p_vaddr, ph.p_memsz,
-					  ph.p_flags & PF_R,
-					  ph.p_flags & PF_W,
-					  ph.p_flags & PF_X);
-		if (result) {
-			return result;
+		if (img->ei_nsegs == EXECIMAGE_MAXSEGS) {
+			kprintf("loadelf: too many segments\n");
+			return ENOEXEC;
 		}
+		img->ei_segs[img->ei_nsegs++] = ph;
 	}
 
-	result = as_prepare_load(as);
-	if (result) {
-		return result;
+	return 0;
+}
+
+/*
+ * After loading V from scratch, cache its headers, and turn its text
+ * segment (the first one that is executable and not writable) into
+ * shared text if the VM system can. Failing to share just means the
+ * next exec loads its own copy, so errors are not passed on.
+ */
+static
+void
+elf_remember(struct addrspace *as, struct vnode *v, struct execimage *img)
+{
+	Elf_Phdr *ph;
+	unsigned i;
+	int result;
+
+	for (i=0; i<img->ei_nsegs; i++) {
+		ph = &img->ei_segs[i];
+		if ((ph->p_flags & PF_X) && !(ph->p_flags & PF_W)) {
+			break;
+		}
+	}
+	if (i < img->ei_nsegs) {
+		result = as_share_text(as, ph->p_vaddr, &img->ei_text);
+		if (result == 0) {
+			img->ei_textseg = i;
+			img->ei_textpages = ((ph->p_vaddr & ~(vaddr_t)PAGE_FRAME)
+					     + ph->p_memsz + PAGE_SIZE - 1)
+				/ PAGE_SIZE;
+		}
 	}
 
-	/*
-	 * Now actually load each segment.
-	 */
+	execcache_insert(v, img);
+}
 
-	for (i=0; i<eh.e_phnum; i++) {
-		off_t offset = eh.e_phoff + i*eh.e_phentsize;
-		uio_kinit(&iov, &ku, &ph, sizeof(ph), offset, UIO_READ);
+/*
+ * Load an ELF executable user program into the current address space.
+ *
+ * Returns the entry point (initial PC) for the program in ENTRYPOINT.
+ *
+ * The headers of programs loaded before come from the exec cache,
+ * and so does their text, which is mapped instead of read.
+ */
+int
+load_elf(struct vnode *v, vaddr_t *entrypoint)
+{
+	struct execimage img;
+	Elf_Phdr *ph;
+	bool cached;
+	unsigned i;
+	int result;
+	struct addrspace *as;
 
-		result = VOP_READ(v, &ku);
+	as = proc_getas();
+
+	cached = execcache_lookup(v, &img);
+	if (!cached) {
+		result = elf_readheaders(v, &img);
 		if (result) {
 			return result;
 		}
+	}
 
-		if (ku.uio_resid != 0) {
-			/* short read; problem with executable? */
-			kprintf("ELF: short read on phdr - file truncated?\n");
-			return ENOEXEC;
-		}
+	/*
+	 * Set up the address space.
+	 */
 
-		switch (ph.p_type) {
-		    case PT_NULL: /* skip */ continue;
-		    case PT_PHDR: /* skip */ continue;
-		    case PT_MIPS_REGINFO: /* skip */ continue;
-		    case PT_LOAD: break;
-		    default:
-			kprintf("loadelf: unknown segment type %d\n",
-				ph.p_type);
-			return ENOEXEC;
+	for (i=0; i<img.ei_nsegs; i++) {
+		ph = &img.ei_segs[i];
+		if ((int)i == img.ei_textseg) {
+			result = as_define_text(as, ph->p_vaddr, ph->p_memsz,
+						img.ei_text);
+		}
+		else {
+			result = as_define_region(as,
+						  ph->p_vaddr, ph->p_memsz,
+						  ph->p_flags & PF_R,
+						  ph->p_flags & PF_W,
+						  ph->p_flags & PF_X);
 		}
+		if (result) {
+			goto done;
+		}
+	}
+
+	result = as_prepare_load(as);
+	if (result) {
+		goto done;
+	}
+
+	/*
+	 * Now actually load each segment, except shared text, which
+	 * is already there.
+	 */
 
-		result = load_segment(as, v, ph.p_offset, ph.p_vaddr,
-				      ph.p_memsz, ph.p_filesz,
-				      ph.p_flags & PF_X);
+	for (i=0; i<img.ei_nsegs; i++) {
+		ph = &img.ei_segs[i];
+		if ((int)i == img.ei_textseg) {
+			continue;
+		}
+		result = load_segment(as, v, ph->p_offset, ph->p_vaddr,
+				      ph->p_memsz, ph->p_filesz,
+				      ph->p_flags & PF_X);
 		if (result) {
-			return result;
+			goto done;
 		}
 	}
 
 	result = as_complete_load(as);
 	if (result) {
-		return result;
+		goto done;
 	}
 
-	*entrypoint = eh.e_entry;
+	if (!cached) {
+		elf_remember(as, v, &img);
+	}
 
-	return 0;
+	*entrypoint = img.ei_entry;
+
+ done:
+	if (cached && img.ei_text != NULL) {
+		as_text_release(img.ei_text);
+	}
+	return result;
 }
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Open files. See openfile.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <lib.h>
+#include <membar.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <current.h>
+#include <proc.h>
+#include <vfs.h>
+#include <openfile.h>
+
+/*
+ * Freed openfiles, chained through of_nextfree. They are never given
+ * back to kmalloc, so openfile_tryincref can always look at one (see
+ * openfile.h). Their refcount stays 0 while they're here.
+ */
+static struct spinlock openfile_freelock = SPINLOCK_INITIALIZER;
+static struct openfile *openfile_free;
+
+static
+void
+openfile_put(struct openfile *of)
+{
+	spinlock_acquire(&openfile_freelock);
+	of->of_nextfree = openfile_free;
+	openfile_free = of;
+	spinlock_release(&openfile_freelock);
+}
+
+int
+openfile_create(struct vnode *vn, int flags, struct openfile **ret)
+{
+	struct openfile *of;
+
+	spinlock_acquire(&openfile_freelock);
+	of = openfile_free;
+	if (of != NULL) {
+		openfile_free = of->of_nextfree;
+	}
+	spinlock_release(&openfile_freelock);
+
+	if (of == NULL) {
+		of = kmalloc(sizeof(*of));
+		if (of == NULL) {
+			return ENOMEM;
+		}
+		atomic_set(&of->of_refcount, 0);
+	}
+	of->of_offsetsem = sem_create("offset", 1);
+	if (of->of_offsetsem == NULL) {
+		openfile_put(of);
+		return ENOMEM;
+	}
+
+	of->of_vnode = vn;
+	of->of_accmode = flags & O_ACCMODE;
+	of->of_append = (flags & O_APPEND) != 0;
+	of->of_offset = 0;
+	of->of_nextfree = NULL;
+	/* Set it up fully before openfile_tryincref can succeed. */
+	membar_store_store();
+	atomic_set(&of->of_refcount, 1);
+
+	*ret = of;
+	return 0;
+}
+
+int
+openfile_open(char *path, int flags, mode_t mode, struct openfile **ret)
+{
+	struct vnode *vn;
+	int result;
+
+	result = vfs_open(path, flags, mode, &vn);
+	if (result) {
+		return result;
+	}
+	result = openfile_create(vn, flags, ret);
+	if (result) {
+		vfs_close(vn);
+		return result;
+	}
+	return 0;
+}
+
+void
+openfile_incref(struct openfile *of)
+{
+	atomic_inc(&of->of_refcount);
+}
+
+bool
+openfile_tryincref(struct openfile *of)
+{
+	return atomic_add_unless(&of->of_refcount, 1, 0);
+}
+
+void
+openfile_decref(struct openfile *of)
+{
+	if (!atomic_dec_and_test(&of->of_refcount)) {
+		return;
+	}
+	vfs_close(of->of_vnode);
+	sem_destroy(of->of_offsetsem);
+	openfile_put(of);
+}
+
+bool
+openfile_lockoffset(struct openfile *of)
+{
+	/*
+	 * Only our own descriptor refers to OF and nobody else runs in
+	 * our process, so nobody can get at OF until we return.
+	 */
+	if (atomic_read(&of->of_refcount) == 1 &&
+	    atomic_read(&curproc->p_numthreads) == 1) {
+		return false;
+	}
+	P(of->of_offsetsem);
+	return true;
+}
+
+void
+openfile_unlockoffset(struct openfile *of, bool locked)
+{
+	if (locked) {
+		V(of->of_offsetsem);
+	}
+}
@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * poll and select.
+ *
+ * Both turn their arguments into an array of pollitems, one per
+ * descriptor of interest, and hand it to poll_items, which checks
+ * each descriptor once with VOP_POLL, registering on the way. If
+ * nothing is ready it sleeps, and after each wakeup rechecks only
+ * the descriptors whose objects signalled (see poll.h). Once
+ * something is ready, later descriptors are checked without
+ * registering, since we won't be sleeping.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/select.h>
+#include <kern/time.h>
+#include <limits.h>
+#include <lib.h>
+#include <clock.h>
+#include <current.h>
+#include <proc.h>
+#include <vnode.h>
+#include <copyinout.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <poll.h>
+#include <syscall.h>
+
+/* Calls with up to this many descriptors don't need kmalloc. */
+#define POLL_STACKITEMS	8
+
+struct pollitem {
+	int pi_fd;			/* descriptor, or -1 to skip */
+	int pi_events;			/* POLLIN/POLLOUT wanted */
+	int pi_revents;			/* what's ready */
+	struct openfile *pi_file;	/* reference held during the call */
+	struct pollentry pi_entry;
+};
+
+/*
+ * Get a reference to the open file for FD, to keep its object (and
+ * pollhead) around while we might be registered on it.
+ */
+static
+int
+poll_getfile(int fd, struct openfile **ret)
+{
+	bool held;
+	int result;
+
+	result = filetable_get(curproc->p_filetable, fd,
+			       atomic_read(&curproc->p_numthreads) > 1,
+			       ret, &held);
+	if (result) {
+		return result;
+	}
+	openfile_incref(*ret);
+	filetable_put(*ret, held);
+	return 0;
+}
+
+/*
+ * Wait until at least one of the N ITEMS is ready, or for TIMEOUT
+ * nanoseconds (forever if negative). Fills in pi_revents, and hands
+ * back in *NREADY how many items have any bits set.
+ */
+static
+int
+poll_items(struct pollitem *items, unsigned n, int64_t timeout,
+	   unsigned *nready)
+{
+	struct pollset ps;
+	struct pollentry *pe;
+	struct pollitem *pi;
+	struct vnode *vn;
+	uint64_t deadline;
+	unsigned i, ready;
+	bool wait;
+
+	pollset_init(&ps);
+
+	ready = 0;
+	wait = timeout != 0;
+	for (i=0; i<n; i++) {
+		pi = &items[i];
+		pollentry_init(&pi->pi_entry, &ps, i);
+		pi->pi_file = NULL;
+		pi->pi_revents = 0;
+		if (pi->pi_fd < 0) {
+			continue;
+		}
+		if (poll_getfile(pi->pi_fd, &pi->pi_file)) {
+			pi->pi_revents = POLLNVAL;
+		}
+		else {
+			vn = pi->pi_file->of_vnode;
+			pi->pi_revents = VOP_POLL(vn, pi->pi_events,
+						  wait ? &pi->pi_entry : NULL);
+		}
+		if (pi->pi_revents != 0) {
+			ready++;
+			wait = false;
+		}
+	}
+
+	if (wait) {
+		deadline = timeout < 0 ? 0 : clock_monotonic_ns() + timeout;
+		while (ready == 0) {
+			pollset_wait(&ps, deadline);
+			pe = pollset_next(&ps);
+			if (pe == NULL) {
+				/* timed out */
+				break;
+			}
+			for (; pe != NULL; pe = pollset_next(&ps)) {
+				pi = &items[pe->pe_index];
+				if (pi->pi_revents != 0) {
+					continue;
+				}
+				vn = pi->pi_file->of_vnode;
+				pi->pi_revents = VOP_POLL(vn, pi->pi_events,
+							  NULL);
+				if (pi->pi_revents != 0) {
+					ready++;
+				}
+			}
+		}
+	}
+
+	for (i=0; i<n; i++) {
+		pi = &items[i];
+		pollentry_remove(&pi->pi_entry);
+		if (pi->pi_file != NULL) {
+			openfile_decref(pi->pi_file);
+		}
+	}
+	pollset_cleanup(&ps);
+
+	*nready = ready;
+	return 0;
+}
+
+/*
+ * Get space for N items: STACKBUF if they fit, else kmalloc.
+ */
+static
+struct pollitem *
+poll_allocitems(unsigned n, struct pollitem *stackbuf)
+{
+	if (n <= POLL_STACKITEMS) {
+		return stackbuf;
+	}
+	return kmalloc(n * sizeof(struct pollitem));
+}
+
+static
+void
+poll_freeitems(struct pollitem *items, struct pollitem *stackbuf)
+{
+	if (items != stackbuf) {
+		kfree(items);
+	}
+}
+
+/*
+ * poll: wait for any of the NFDS descriptors in FDS to be ready for
+ * what it asks for, or for TIMEOUT milliseconds (forever if
+ * negative). Returns how many have revents set.
+ */
+int
+sys_poll(userptr_t fds, unsigned nfds, int timeout, int32_t *retval)
+{
+	struct pollitem stackitems[POLL_STACKITEMS];
+	struct pollfd stackfds[POLL_STACKITEMS];
+	struct pollitem *items;
+	struct pollfd *kfds;
+	unsigned i, nready;
+	int result;
+
+	if (nfds > OPEN_MAX) {
+		return EINVAL;
+	}
+
+	items = poll_allocitems(nfds, stackitems);
+	kfds = nfds <= POLL_STACKITEMS ? stackfds :
+		kmalloc(nfds * sizeof(struct pollfd));
+	if (items == NULL || kfds == NULL) {
+		result = ENOMEM;
+		goto done;
+	}
+	result = copyin(fds, kfds, nfds * sizeof(struct pollfd));
+	if (result) {
+		goto done;
+	}
+
+	for (i=0; i<nfds; i++) {
+		items[i].pi_fd = kfds[i].fd;
+		items[i].pi_events = kfds[i].events;
+	}
+
+	result = poll_items(items, nfds,
+			    timeout < 0 ? -1 : (int64_t)timeout * 1000000,
+			    &nready);
+	if (result) {
+		goto done;
+	}
+
+	for (i=0; i<nfds; i++) {
+		kfds[i].revents = items[i].pi_revents;
+	}
+	result = copyout(kfds, fds, nfds * sizeof(struct pollfd));
+	if (result) {
+		goto done;
+	}
+	*retval = nready;
+
+ done:
+	if (items != NULL) {
+		poll_freeitems(items, stackitems);
+	}
+	if (kfds != NULL && kfds != stackfds) {
+		kfree(kfds);
+	}
+	return result;
+}
+
+/*
+ * Bit FD of fd_set SET.
+ */
+#define FDSET_ISSET(set, fd) \
+	(((set)->__fds_bits[(fd) / __NFDBITS] >> ((fd) % __NFDBITS)) & 1)
+#define FDSET_SET(set, fd) \
+	((set)->__fds_bits[(fd) / __NFDBITS] |= 1U << ((fd) % __NFDBITS))
+
+/*
+ * select: wait for any descriptor below NFDS in READFDS to be
+ * readable, or in WRITEFDS to be writable, or for TIMEOUT (forever
+ * if NULL). Any of the sets may be NULL. On return the sets hold
+ * just the ready descriptors, and the result is how many bits are
+ * set in all. Nothing here has exceptional conditions, so EXCEPTFDS
+ * always comes back empty.
+ */
+int
+sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	   userptr_t exceptfds, const_userptr_t timeout, int32_t *retval)
+{
+	struct pollitem stackitems[POLL_STACKITEMS];
+	struct pollitem *items;
+	struct __fd_set rd, wr, ex;
+	struct timeval tv;
+	int64_t ns;
+	size_t setlen;
+	unsigned n, i, nready, nbits;
+	int fd, result;
+
+	if (nfds < 0 || nfds > __FD_SETSIZE) {
+		return EINVAL;
+	}
+	setlen = DIVROUNDUP(nfds, __NFDBITS) * sizeof(rd.__fds_bits[0]);
+
+	bzero(&rd, sizeof(rd));
+	bzero(&wr, sizeof(wr));
+	bzero(&ex, sizeof(ex));
+	if (readfds != NULL) {
+		result = copyin(readfds, &rd, setlen);
+		if (result) {
+			return result;
+		}
+	}
+	if (writefds != NULL) {
+		result = copyin(writefds, &wr, setlen);
+		if (result) {
+			return result;
+		}
+	}
+	if (exceptfds != NULL) {
+		result = copyin(exceptfds, &ex, setlen);
+		if (result) {
+			return result;
+		}
+	}
+
+	ns = -1;
+	if (timeout != NULL) {
+		result = copyin(timeout, &tv, sizeof(tv));
+		if (result) {
+			return result;
+		}
+		if (tv.tv_sec < 0 || tv.tv_usec < 0 ||
+		    tv.tv_usec >= 1000000) {
+			return EINVAL;
+		}
+		ns = tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
+	}
+
+	/* One item per descriptor in any of the sets. */
+	n = 0;
+	for (fd=0; fd<nfds; fd++) {
+		if (FDSET_ISSET(&rd, fd) || FDSET_ISSET(&wr, fd) ||
+		    FDSET_ISSET(&ex, fd)) {
+			n++;
+		}
+	}
+	items = poll_allocitems(n, stackitems);
+	if (items == NULL) {
+		return ENOMEM;
+	}
+	i = 0;
+	for (fd=0; fd<nfds; fd++) {
+		if (FDSET_ISSET(&rd, fd) || FDSET_ISSET(&wr, fd) ||
+		    FDSET_ISSET(&ex, fd)) {
+			items[i].pi_fd = fd;
+			items[i].pi_events =
+				(FDSET_ISSET(&rd, fd) ? POLLIN : 0) |
+				(FDSET_ISSET(&wr, fd) ? POLLOUT : 0);
+			i++;
+		}
+	}
+
+	result = poll_items(items, n, ns, &nready);
+	if (result) {
+		poll_freeitems(items, stackitems);
+		return result;
+	}
+
+	bzero(&rd, sizeof(rd));
+	bzero(&wr, sizeof(wr));
+	bzero(&ex, sizeof(ex));
+	nbits = 0;
+	for (i=0; i<n; i++) {
+		fd = items[i].pi_fd;
+		if (items[i].pi_revents & POLLNVAL) {
+			poll_freeitems(items, stackitems);
+			return EBADF;
+		}
+		if ((items[i].pi_events & POLLIN) &&
+		    (items[i].pi_revents & (POLLIN | POLLHUP | POLLERR))) {
+			FDSET_SET(&rd, fd);
+			nbits++;
+		}
+		if ((items[i].pi_events & POLLOUT) &&
+		    (items[i].pi_revents & (POLLOUT | POLLERR))) {
+			FDSET_SET(&wr, fd);
+			nbits++;
+		}
+	}
+	poll_freeitems(items, stackitems);
+
+	if (readfds != NULL) {
+		result = copyout(&rd, readfds, setlen);
+		if (result) {
+			return result;
+		}
+	}
+	if (writefds != NULL) {
+		result = copyout(&wr, writefds, setlen);
+		if (result) {
+			return result;
+		}
+	}
+	if (exceptfds != NULL) {
+		result = copyout(&ex, exceptfds, setlen);
+		if (result) {
+			return result;
+		}
+	}
+	*retval = nbits;
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/wait.h>
+#include <lib.h>
+#include <mips/trapframe.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * Process-related system calls.
+ */
+
+/*
+ * getrusage: return resource usage for the caller (RUSAGE_SELF) or
+ * its waited-for children (RUSAGE_CHILDREN) in the struct rusage at
+ * user address RU.
+ *
+ * Only CPU time and context switch counts are kept. A child's usage
+ * is added to its parent's RUSAGE_CHILDREN totals when waitpid
+ * reaps it.
+ */
+int
+sys_getrusage(int who, userptr_t ru)
+{
+	struct rusage kru;
+
+	switch (who) {
+	    case RUSAGE_SELF:
+		proc_getrusage(curproc, &kru);
+		break;
+	    case RUSAGE_CHILDREN:
+		proc_getrusage_children(curproc, &kru);
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	return copyout(&kru, ru, sizeof(kru));
+}
+
+/*
+ * Thread entry point for the child of fork. DATA1 is the kmalloc'd
+ * copy of the parent's trapframe.
+ */
+static
+void
+fork_child_entry(void *data1, unsigned long data2)
+{
+	(void)data2;
+	enter_forked_process(data1);
+}
+
+/*
+ * fork: create a copy of the calling process. The parent gets the
+ * child's pid; the child returns 0 from the same call.
+ *
+ * The child's trapframe has to be copied now, because the parent's
+ * goes away as soon as we return. It is handed to the child's new
+ * thread, which puts it on its own stack and frees it.
+ */
+int
+sys_fork(struct trapframe *tf, int32_t *retval)
+{
+	struct trapframe *childtf;
+	struct proc *newproc;
+	pid_t pid;
+	int result;
+
+	childtf = kmalloc(sizeof(*childtf));
+	if (childtf == NULL) {
+		return ENOMEM;
+	}
+	*childtf = *tf;
+
+	result = proc_fork(&newproc);
+	if (result) {
+		kfree(childtf);
+		return result;
+	}
+
+	/*
+	 * Nobody but us can reap the child, so its pid stays valid
+	 * even if it runs and exits before we get back here.
+	 */
+	pid = newproc->p_pid;
+
+	result = thread_fork(curthread->t_name, newproc,
+			     fork_child_entry, childtf, 0);
+	if (result) {
+		proc_destroy(newproc);
+		kfree(childtf);
+		return result;
+	}
+
+	*retval = pid;
+	return 0;
+}
+
+/*
+ * vfork: create a child that runs in the calling process's address
+ * space, without copying it, until it calls execv or _exit. The
+ * caller is suspended until then, and then gets the child's pid.
+ *
+ * The child must not return from the function that called vfork or
+ * change anything its parent relies on; in practice it should only
+ * exec or exit.
+ */
+int
+sys_vfork(struct trapframe *tf, int32_t *retval)
+{
+	struct trapframe *childtf;
+	struct proc *newproc;
+	pid_t pid;
+	int result;
+
+	childtf = kmalloc(sizeof(*childtf));
+	if (childtf == NULL) {
+		return ENOMEM;
+	}
+	*childtf = *tf;
+
+	result = proc_vfork(&newproc);
+	if (result) {
+		kfree(childtf);
+		return result;
+	}
+	pid = newproc->p_pid;
+
+	result = thread_fork(curthread->t_name, newproc,
+			     fork_child_entry, childtf, 0);
+	if (result) {
+		proc_destroy(newproc);
+		kfree(childtf);
+		return result;
+	}
+
+	proc_vfork_wait(newproc);
+
+	*retval = pid;
+	return 0;
+}
+
+/*
+ * _exit: end the calling process with exit code CODE.
+ */
+void
+sys__exit(int code)
+{
+	proc_exit(_MKWAIT_EXIT(code));
+}
+
+/*
+ * waitpid: wait for child PID, or any child if PID is WAIT_ANY, to
+ * exit, and reap it. The encoded exit status is stored at STATUS
+ * unless that is NULL. See proc_wait for the details.
+ */
+int
+sys_waitpid(pid_t pid, userptr_t status, int options, int32_t *retval)
+{
+	int kstatus;
+	pid_t childpid;
+	int result;
+
+	result = proc_wait(pid, options, &kstatus, &childpid);
+	if (result) {
+		return result;
+	}
+	if (childpid != 0 && status != NULL) {
+		/*
+		 * The child is gone already, so a bad pointer here
+		 * loses its status; that is the caller's problem.
+		 */
+		result = copyout(&kstatus, status, sizeof(kstatus));
+		if (result) {
+			return result;
+		}
+	}
+	*retval = childpid;
+	return 0;
+}
+
+/*
+ * getpid: return the caller's pid.
+ */
+int
+sys_getpid(int32_t *retval)
+{
+	*retval = curproc->p_pid;
+	return 0;
+}
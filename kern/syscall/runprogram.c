@@ -42,9 +42,41 @@
 #include <addrspace.h>
 #include <vm.h>
 #include <vfs.h>
+#include <openfile.h>
+#include <filetable.h>
 #include <syscall.h>
 #include <test.h>
 
+/*
+ * Open the console as standard input, output, and error of the
+ * current process, which must have an empty file table.
+ */
+static
+int
+runprogram_console(void)
+{
+	static const int modes[3] = { O_RDONLY, O_WRONLY, O_WRONLY };
+	struct openfile *of;
+	char path[5];
+	int fd, i, result;
+
+	for (i=0; i<3; i++) {
+		/* vfs_open may destroy the path, so start from fresh */
+		strcpy(path, "con:");
+		result = openfile_open(path, modes[i], 0, &of);
+		if (result) {
+			return result;
+		}
+		result = filetable_place(curproc->p_filetable, of, &fd);
+		if (result) {
+			openfile_decref(of);
+			return result;
+		}
+		KASSERT(fd == i);
+	}
+	return 0;
+}
+
 /*
  * Load program "progname" and start running it in usermode.
  * Does not return except on error.
@@ -68,6 +100,14 @@ runprogram(char *progname)
 	/* We should be a new process. */
 	KASSERT(proc_getas() == NULL);
 
+	/* Set up standard input, output, and error. */
+	result = runprogram_console();
+	if (result) {
+		/* the files will go away when curproc is destroyed */
+		vfs_close(v);
+		return result;
+	}
+
 	/* Create a new address space. */
 	as = as_create();
 	if (as == NULL) {
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/sched.h>
+#include <lib.h>
+#include <clock.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * Scheduling-related system calls.
+ */
+
+/*
+ * Check the WHICH/WHO pair given to getpriority/setpriority and
+ * return the process it names.
+ *
+ * There are no process groups or users, so only PRIO_PROCESS is
+ * supported. WHO can only be 0 or the caller's own pid; changing
+ * another process would need a reference on it that waitpid
+ * respects, which the process table does not provide.
+ */
+static
+int
+priority_target(int which, int who, struct proc **ret)
+{
+	if (which != PRIO_PROCESS) {
+		return EINVAL;
+	}
+	if (who != 0 && who != curproc->p_pid) {
+		return ESRCH;
+	}
+	*ret = curproc;
+	return 0;
+}
+
+/*
+ * getpriority: return the nice value of a process.
+ */
+int
+sys_getpriority(int which, int who, int32_t *retval)
+{
+	struct proc *proc;
+	int result;
+
+	result = priority_target(which, who, &proc);
+	if (result) {
+		return result;
+	}
+	*retval = proc->p_nice;
+	return 0;
+}
+
+/*
+ * setpriority: set the nice value of a process. Out-of-range values
+ * are clamped, as in Unix. Higher values mean lower priority; see
+ * thread_baselevel() in thread.c for how this maps onto scheduler
+ * levels.
+ */
+int
+sys_setpriority(int which, int who, int prio)
+{
+	struct proc *proc;
+	int result;
+
+	result = priority_target(which, who, &proc);
+	if (result) {
+		return result;
+	}
+
+	if (prio < PRIO_MIN) {
+		prio = PRIO_MIN;
+	}
+	if (prio > PRIO_MAX) {
+		prio = PRIO_MAX;
+	}
+
+	spinlock_acquire(&proc->p_lock);
+	proc->p_nice = prio;
+	spinlock_release(&proc->p_lock);
+
+	thread_renice();
+	return 0;
+}
+
+/*
+ * Check the PID given to the sched_* calls. Only 0 or the caller's own
+ * pid is accepted. Affinity and scheduling class are per-thread; they
+ * apply to the calling thread.
+ */
+static
+int
+sched_target(pid_t pid)
+{
+	if (pid != 0 && pid != curproc->p_pid) {
+		return ESRCH;
+	}
+	return 0;
+}
+
+/*
+ * sched_setaffinity: restrict the calling thread to the cpus whose
+ * bits are set in the mask at user address MASK.
+ */
+int
+sys_sched_setaffinity(pid_t pid, const_userptr_t mask)
+{
+	uint32_t kmask;
+	int result;
+
+	result = sched_target(pid);
+	if (result) {
+		return result;
+	}
+	result = copyin(mask, &kmask, sizeof(kmask));
+	if (result) {
+		return result;
+	}
+	return thread_setaffinity(kmask);
+}
+
+/*
+ * sched_getaffinity: store the calling thread's cpu mask at user
+ * address MASK.
+ */
+int
+sys_sched_getaffinity(pid_t pid, userptr_t mask)
+{
+	uint32_t kmask;
+	int result;
+
+	result = sched_target(pid);
+	if (result) {
+		return result;
+	}
+	kmask = curthread->t_affinity;
+	return copyout(&kmask, mask, sizeof(kmask));
+}
+
+/*
+ * sched_setscheduler: put the calling thread in scheduling class
+ * POLICY, with the parameters at user address PARAM for SCHED_RR.
+ * Times are rounded up to whole hardclocks.
+ */
+int
+sys_sched_setscheduler(pid_t pid, int policy, const_userptr_t param)
+{
+	struct sched_param kparam;
+	unsigned runtime, period;
+	int result;
+
+	result = sched_target(pid);
+	if (result) {
+		return result;
+	}
+
+	switch (policy) {
+	    case SCHED_OTHER:
+		return thread_setrt(0, 0, 0);
+	    case SCHED_RR:
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	result = copyin(param, &kparam, sizeof(kparam));
+	if (result) {
+		return result;
+	}
+	if (kparam.sched_priority < SCHED_RT_MINPRIO ||
+	    kparam.sched_priority > SCHED_RT_MAXPRIO) {
+		return EINVAL;
+	}
+	/* Check before converting, so the rounding can't wrap. */
+	if (kparam.sched_runtime == 0 ||
+	    kparam.sched_runtime > kparam.sched_period ||
+	    kparam.sched_period > SCHED_RT_MAXPERIOD) {
+		return EINVAL;
+	}
+	runtime = DIVROUNDUP(kparam.sched_runtime, 1000000 / HZ);
+	period = DIVROUNDUP(kparam.sched_period, 1000000 / HZ);
+	return thread_setrt(kparam.sched_priority, runtime, period);
+}
+
+/*
+ * sched_getscheduler: return the calling thread's scheduling class,
+ * and if PARAM isn't null store its parameters there.
+ */
+int
+sys_sched_getscheduler(pid_t pid, userptr_t param, int32_t *retval)
+{
+	struct sched_param kparam;
+	struct thread *cur = curthread;
+	int result;
+
+	result = sched_target(pid);
+	if (result) {
+		return result;
+	}
+
+	bzero(&kparam, sizeof(kparam));
+	kparam.sched_priority = cur->t_rtprio;
+	kparam.sched_runtime = cur->t_rtruntime * (1000000 / HZ);
+	kparam.sched_period = cur->t_rtperiod * (1000000 / HZ);
+	if (param != NULL) {
+		result = copyout(&kparam, param, sizeof(kparam));
+		if (result) {
+			return result;
+		}
+	}
+
+	*retval = cur->t_rtprio > 0 ? SCHED_RR : SCHED_OTHER;
+	return 0;
+}
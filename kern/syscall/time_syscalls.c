@@ -28,6 +28,9 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <lib.h>
 #include <clock.h>
 #include <copyinout.h>
 #include <syscall.h>
@@ -41,7 +44,7 @@ sys___time(userptr_t user_seconds_ptr, userptr_t user_nanoseconds_ptr)
 	struct timespec ts;
 	int result;
 
-	gettime(&ts);
+	clock_realtime(&ts);
 
 	result = copyout(&ts.tv_sec, user_seconds_ptr, sizeof(ts.tv_sec));
 	if (result) {
@@ -56,3 +59,72 @@ sys___time(userptr_t user_seconds_ptr, userptr_t user_nanoseconds_ptr)
 
 	return 0;
 }
+
+/*
+ * clock_gettime: read clock CLOCKID into the struct timespec at user
+ * address TS. Both clocks come from the cycle counter, so this never
+ * touches the clock device.
+ */
+int
+sys_clock_gettime(int clockid, userptr_t ts)
+{
+	struct timespec kts;
+	uint64_t ns;
+
+	switch (clockid) {
+	    case CLOCK_REALTIME:
+		clock_realtime(&kts);
+		break;
+	    case CLOCK_MONOTONIC:
+		ns = clock_monotonic_ns();
+		kts.tv_sec = ns / 1000000000;
+		kts.tv_nsec = ns % 1000000000;
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	return copyout(&kts, ts, sizeof(kts));
+}
+
+/*
+ * nanosleep: sleep for the time given in the struct timespec at user
+ * address REQ.
+ *
+ * The sleep is rounded up to whole hardclocks, plus one because the
+ * current tick is already partly over; so it is never short, and
+ * never long by more than a tick. Nothing can interrupt it, so the
+ * time remaining (REM) is never set.
+ */
+int
+sys_nanosleep(const_userptr_t req, userptr_t rem)
+{
+	struct timespec ts;
+	uint64_t ticks;
+	unsigned chunk;
+	int result;
+
+	(void)rem;
+
+	result = copyin(req, &ts, sizeof(ts));
+	if (result) {
+		return result;
+	}
+	if (ts.tv_sec < 0 || ts.tv_nsec < 0 || ts.tv_nsec >= 1000000000) {
+		return EINVAL;
+	}
+
+	ticks = (uint64_t)ts.tv_sec * HZ +
+		DIVROUNDUP((uint32_t)ts.tv_nsec, 1000000000 / HZ);
+	if (ticks == 0) {
+		return 0;
+	}
+	ticks++;
+
+	while (ticks > 0) {
+		chunk = ticks > 0x7fffffff ? 0x7fffffff : ticks;
+		clocksleep_ticks(chunk);
+		ticks -= chunk;
+	}
+	return 0;
+}
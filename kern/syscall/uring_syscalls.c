@@ -0,0 +1,694 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * uring_setup and uring_enter: batched I/O through rings shared with
+ * user space.
+ *
+ * The rings are in the process's own memory (see kern/uring.h), and
+ * we reach them with copyin and copyout like any other user buffer.
+ * Each request is carried out by calling the ordinary system call
+ * function for it, in the context of the process, so descriptors,
+ * permissions and errors all behave exactly as for the plain calls.
+ *
+ * The kernel's own copies of the indexes it owns (ir_sqhead and
+ * ir_cqtail) are authoritative; the ones in user memory are only
+ * published for the process to read, and whatever it writes there
+ * is ignored.
+ *
+ * With URING_SETUP_SQPOLL, a poller thread in the process takes the
+ * SQEs as they appear. It spins (yielding) while there is work, and
+ * after IORING_IDLE_NS without any sets URING_F_NEED_WAKEUP and
+ * sleeps until uring_enter wakes it. It runs each request itself,
+ * with t_nowait set, so it never blocks in one: a read or write that
+ * would have to wait for a pipe or the console stays queued, and
+ * the poller sleeps on the object (through ir_ps, like poll) until
+ * it is ready. The requests behind it wait too. Since the poller
+ * only ever sleeps in places we can wake it from, exec and exit
+ * never wait on a request.
+ *
+ * ir_runsem is held by whoever is running requests, and by exec and
+ * spawn (ioring_pause) while the address space the ring lives in is
+ * not the current one.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/uring.h>
+#include <lib.h>
+#include <clock.h>
+#include <membar.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <sleepq.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <copyinout.h>
+#include <vnode.h>
+#include <poll.h>
+#include <openfile.h>
+#include <filetable.h>
+#include <ioring.h>
+#include <syscall.h>
+
+/* How long the poller spins without work before going to sleep. */
+#define IORING_IDLE_NS	10000000	/* 10 ms */
+
+struct ioring {
+	userptr_t ir_rings;		/* struct uring_rings */
+	vaddr_t ir_sqes;		/* submission queue */
+	vaddr_t ir_cqes;		/* completion queue */
+	unsigned ir_entries;		/* size of each queue */
+	unsigned ir_sqhead;		/* next SQE to take */
+	unsigned ir_cqtail;		/* next CQE to fill */
+	unsigned ir_flags;		/* URING_F_*, as published */
+	bool ir_sqpoll;			/* has a poller thread */
+	bool ir_paused;			/* ir_runsem held by ioring_pause */
+	struct semaphore *ir_runsem;	/* held while running requests */
+	struct semaphore *ir_exitsem;	/* poller has left the process */
+
+	/* The poller sleeps on ir_ps; ir_pe waits for a pipe or console. */
+	struct pollset ir_ps;
+	struct pollentry ir_pe;
+	struct openfile *ir_pefile;	/* what ir_pe is waiting on */
+
+	struct spinlock ir_lock;	/* protects the rest */
+	unsigned ir_cqposted;		/* ir_cqtail as last published */
+	unsigned ir_cqwaiters;		/* threads waiting for CQEs */
+	bool ir_stop;			/* poller should exit */
+};
+
+/* User address of field F of the shared header. */
+#define IORING_FIELD(ir, f) \
+	((userptr_t)&((struct uring_rings *)(ir)->ir_rings)->f)
+
+static
+int
+ioring_getidx(userptr_t field, unsigned *ret)
+{
+	return copyin(field, ret, sizeof(*ret));
+}
+
+static
+int
+ioring_setidx(userptr_t field, unsigned val)
+{
+	return copyout(&val, field, sizeof(val));
+}
+
+/*
+ * Carry out one request. Returns what the system call would have,
+ * or -errno.
+ */
+static
+int32_t
+ioring_doop(const struct uring_sqe *sqe)
+{
+	int32_t ret;
+	int result;
+
+	ret = 0;
+	switch (sqe->sqe_op) {
+	    case URING_OP_NOP:
+		result = 0;
+		break;
+	    case URING_OP_READ:
+		if (sqe->sqe_off == -1) {
+			result = sys_read(sqe->sqe_fd, sqe->sqe_addr,
+					  sqe->sqe_len, &ret);
+		}
+		else {
+			result = sys_pread(sqe->sqe_fd, sqe->sqe_addr,
+					   sqe->sqe_len, sqe->sqe_off, &ret);
+		}
+		break;
+	    case URING_OP_WRITE:
+		if (sqe->sqe_off == -1) {
+			result = sys_write(sqe->sqe_fd,
+					   (const_userptr_t)sqe->sqe_addr,
+					   sqe->sqe_len, &ret);
+		}
+		else {
+			result = sys_pwrite(sqe->sqe_fd,
+					    (const_userptr_t)sqe->sqe_addr,
+					    sqe->sqe_len, sqe->sqe_off, &ret);
+		}
+		break;
+	    case URING_OP_OPEN:
+		result = sys_open((const_userptr_t)sqe->sqe_addr,
+				  sqe->sqe_flags, sqe->sqe_len, &ret);
+		break;
+	    case URING_OP_CLOSE:
+		result = sys_close(sqe->sqe_fd);
+		break;
+	    case URING_OP_STAT:
+		result = sys_stat((const_userptr_t)sqe->sqe_addr,
+				  sqe->sqe_statbuf);
+		break;
+	    case URING_OP_FSTAT:
+		result = sys_fstat(sqe->sqe_fd, sqe->sqe_statbuf);
+		break;
+	    default:
+		result = EINVAL;
+		break;
+	}
+	return result ? -result : ret;
+}
+
+/*
+ * The request SQE, which the poller could not run without waiting,
+ * reads or writes a pipe or the console. Put ir_pe on that object,
+ * keeping the openfile until ioring_unpark. Returns false if there
+ * is nothing to wait for after all, and the request should be tried
+ * again.
+ */
+static
+bool
+ioring_park(struct ioring *ir, const struct uring_sqe *sqe)
+{
+	struct openfile *of;
+	bool held;
+	int events;
+
+	KASSERT(ir->ir_pefile == NULL);
+
+	if (filetable_get(curproc->p_filetable, sqe->sqe_fd, true,
+			  &of, &held)) {
+		/* Closed in the meantime; trying again fails properly. */
+		return false;
+	}
+	openfile_incref(of);
+	filetable_put(of, held);
+
+	events = sqe->sqe_op == URING_OP_READ ? POLLIN : POLLOUT;
+	pollentry_init(&ir->ir_pe, &ir->ir_ps, 0);
+	if (VOP_POLL(of->of_vnode, events, &ir->ir_pe) != 0) {
+		pollentry_remove(&ir->ir_pe);
+		openfile_decref(of);
+		return false;
+	}
+	ir->ir_pefile = of;
+	return true;
+}
+
+/*
+ * Done waiting, for whatever reason: take ir_pe off its object, then
+ * clear any signal it left on ir_ps.
+ */
+static
+void
+ioring_unpark(struct ioring *ir)
+{
+	if (ir->ir_pefile != NULL) {
+		pollentry_remove(&ir->ir_pe);
+		openfile_decref(ir->ir_pefile);
+		ir->ir_pefile = NULL;
+	}
+	while (pollset_next(&ir->ir_ps) != NULL) {
+		/* nothing */
+	}
+}
+
+/*
+ * Run one request for ioring_submit, putting the result in *RES.
+ * If it can't be run without waiting, and we mustn't wait, park it
+ * and return false.
+ */
+static
+bool
+ioring_run(struct ioring *ir, const struct uring_sqe *sqe, int32_t *res)
+{
+	while (1) {
+		*res = ioring_doop(sqe);
+		if (*res != -EAGAIN || !curthread->t_nowait) {
+			return true;
+		}
+		if (ioring_park(ir, sqe)) {
+			return false;
+		}
+	}
+}
+
+/*
+ * Take up to MAX SQEs, run them, and post their CQEs, stopping early
+ * when the completion queue is full or a request is parked (see
+ * ioring_run). The count taken goes in *SUBMITTED; an error is
+ * returned only for trouble with the rings themselves. Call with
+ * ir_runsem held.
+ */
+static
+int
+ioring_submit(struct ioring *ir, unsigned max, unsigned *submitted)
+{
+	struct uring_sqe sqe;
+	struct uring_cqe cqe;
+	unsigned sqtail, cqhead, mask, n;
+	int result, result2;
+
+	*submitted = 0;
+	mask = ir->ir_entries - 1;
+
+	result = ioring_getidx(IORING_FIELD(ir, ur_sqtail), &sqtail);
+	if (result) {
+		return result;
+	}
+	if (sqtail - ir->ir_sqhead > ir->ir_entries) {
+		return EINVAL;
+	}
+	result = ioring_getidx(IORING_FIELD(ir, ur_cqhead), &cqhead);
+	if (result) {
+		return result;
+	}
+	/* Read the SQEs only after the tail that covers them. */
+	membar_load_load();
+
+	for (n = 0; n < max && ir->ir_sqhead != sqtail; n++) {
+		if (ir->ir_cqtail - cqhead >= ir->ir_entries) {
+			/* Full; the process may have made room since. */
+			result = ioring_getidx(IORING_FIELD(ir, ur_cqhead),
+					       &cqhead);
+			if (result != 0 ||
+			    ir->ir_cqtail - cqhead >= ir->ir_entries) {
+				break;
+			}
+		}
+
+		result = copyin((userptr_t)(ir->ir_sqes +
+					    (ir->ir_sqhead & mask) * sizeof(sqe)),
+				&sqe, sizeof(sqe));
+		if (result) {
+			break;
+		}
+		if (!ioring_run(ir, &sqe, &cqe.cqe_res)) {
+			/* Left queued until the object is ready. */
+			break;
+		}
+		cqe.cqe_data = sqe.sqe_data;
+		cqe.cqe_pad = 0;
+
+		/* The request has happened now, so it is used up. */
+		result = copyout(&cqe, (userptr_t)(ir->ir_cqes +
+					(ir->ir_cqtail & mask) * sizeof(cqe)),
+				 sizeof(cqe));
+		ir->ir_sqhead++;
+		ir->ir_cqtail++;
+		if (result) {
+			n++;
+			break;
+		}
+	}
+
+	if (n > 0) {
+		/* The CQEs must be visible before the tail that covers them. */
+		membar_store_store();
+		result2 = ioring_setidx(IORING_FIELD(ir, ur_sqhead),
+					ir->ir_sqhead);
+		if (result2 == 0) {
+			result2 = ioring_setidx(IORING_FIELD(ir, ur_cqtail),
+						ir->ir_cqtail);
+		}
+		if (result == 0) {
+			result = result2;
+		}
+	}
+	*submitted = n;
+	return result;
+}
+
+/*
+ * Publish new URING_F_* flags. Call with ir_runsem held.
+ */
+static
+int
+ioring_setflags(struct ioring *ir, unsigned flags)
+{
+	ir->ir_flags = flags;
+	return ioring_setidx(IORING_FIELD(ir, ur_flags), flags);
+}
+
+/*
+ * Wake the poller, or keep it from going to sleep.
+ */
+static
+void
+ioring_wakepoller(struct ioring *ir)
+{
+	pollset_wake(&ir->ir_ps);
+}
+
+/*
+ * The poller has posted CQEs; wake whoever is waiting for them.
+ */
+static
+void
+ioring_posted(struct ioring *ir)
+{
+	spinlock_acquire(&ir->ir_lock);
+	ir->ir_cqposted = ir->ir_cqtail;
+	if (ir->ir_cqwaiters > 0) {
+		sleepq_wakeall(&ir->ir_cqposted, &ir->ir_lock);
+	}
+	spinlock_release(&ir->ir_lock);
+}
+
+/*
+ * The poller has run out of work: tell the process it must now use
+ * uring_enter to get SQEs taken, and then look once more for SQEs
+ * queued before it could see that. Returns true if the poller may
+ * sleep. Call with ir_runsem held.
+ */
+static
+bool
+ioring_idle(struct ioring *ir)
+{
+	unsigned sqtail;
+
+	if (ioring_setflags(ir, URING_F_SQPOLL | URING_F_NEED_WAKEUP)) {
+		return true;
+	}
+	membar_any_any();
+	if (ioring_getidx(IORING_FIELD(ir, ur_sqtail), &sqtail)) {
+		return true;
+	}
+	if (sqtail != ir->ir_sqhead) {
+		ioring_setflags(ir, URING_F_SQPOLL);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * The poller thread. It belongs to the process, so the requests run
+ * with the process's descriptors and address space, and their CPU
+ * time is charged to it.
+ */
+static
+void
+ioring_poller(void *data1, unsigned long data2)
+{
+	struct ioring *ir = data1;
+	uint64_t lastwork;
+	unsigned n;
+	bool asleep, idle, parked;
+	int result;
+
+	(void)data2;
+
+	curthread->t_nowait = true;
+	asleep = false;
+	lastwork = clock_monotonic_ns();
+	while (1) {
+		P(ir->ir_runsem);
+		if (ir->ir_stop) {
+			V(ir->ir_runsem);
+			break;
+		}
+		if (asleep) {
+			ioring_setflags(ir, URING_F_SQPOLL);
+			asleep = false;
+		}
+
+		result = ioring_submit(ir, ir->ir_entries, &n);
+		if (n > 0) {
+			lastwork = clock_monotonic_ns();
+		}
+		parked = ir->ir_pefile != NULL;
+		/* If the rings are unusable, wait for uring_enter. */
+		idle = !parked &&
+			(result != 0 ||
+			 (n == 0 &&
+			  clock_monotonic_ns() - lastwork >= IORING_IDLE_NS));
+		if (idle) {
+			idle = ioring_idle(ir);
+		}
+		V(ir->ir_runsem);
+
+		if (n > 0) {
+			ioring_posted(ir);
+		}
+		if (parked || idle) {
+			/* Woken by ir_pe, uring_enter, or ioring_destroy. */
+			pollset_wait(&ir->ir_ps, 0);
+			ioring_unpark(ir);
+			asleep = idle;
+			lastwork = clock_monotonic_ns();
+		}
+		else if (n == 0) {
+			thread_yield();
+		}
+	}
+
+	/* Leave the process, as proc_exit does, so it can finish. */
+	proc_remthread(curthread);
+	proc_addthread(kproc, curthread);
+	V(ir->ir_exitsem);
+	thread_exit();
+}
+
+static
+void
+ioring_free(struct ioring *ir)
+{
+	if (ir->ir_exitsem != NULL) {
+		sem_destroy(ir->ir_exitsem);
+	}
+	if (ir->ir_runsem != NULL) {
+		sem_destroy(ir->ir_runsem);
+	}
+	pollset_cleanup(&ir->ir_ps);
+	spinlock_cleanup(&ir->ir_lock);
+	kfree(ir);
+}
+
+/*
+ * uring_setup: use the ENTRIES-slot rings at RINGS for batched I/O.
+ */
+int
+sys_uring_setup(userptr_t rings, unsigned entries, int flags)
+{
+	struct uring_rings hdr;
+	struct ioring *ir;
+	int result;
+
+	if (curproc->p_ioring != NULL) {
+		return EBUSY;
+	}
+	if (entries == 0 || entries > URING_MAXENTRIES ||
+	    (entries & (entries - 1)) != 0) {
+		return EINVAL;
+	}
+	if ((flags & ~URING_SETUP_SQPOLL) != 0) {
+		return EINVAL;
+	}
+	if ((uintptr_t)rings % sizeof(uint64_t) != 0) {
+		return EINVAL;
+	}
+
+	ir = kmalloc(sizeof(*ir));
+	if (ir == NULL) {
+		return ENOMEM;
+	}
+	ir->ir_rings = rings;
+	ir->ir_sqes = (vaddr_t)rings + sizeof(struct uring_rings);
+	ir->ir_cqes = ir->ir_sqes + entries * sizeof(struct uring_sqe);
+	ir->ir_entries = entries;
+	ir->ir_sqhead = 0;
+	ir->ir_cqtail = 0;
+	ir->ir_sqpoll = (flags & URING_SETUP_SQPOLL) != 0;
+	ir->ir_flags = ir->ir_sqpoll ? URING_F_SQPOLL : 0;
+	ir->ir_paused = false;
+	pollset_init(&ir->ir_ps);
+	ir->ir_pefile = NULL;
+	spinlock_init(&ir->ir_lock);
+	ir->ir_cqposted = 0;
+	ir->ir_cqwaiters = 0;
+	ir->ir_stop = false;
+	ir->ir_exitsem = NULL;
+	ir->ir_runsem = sem_create("uring", 1);
+	if (ir->ir_runsem == NULL) {
+		ioring_free(ir);
+		return ENOMEM;
+	}
+
+	hdr.ur_sqhead = 0;
+	hdr.ur_sqtail = 0;
+	hdr.ur_cqhead = 0;
+	hdr.ur_cqtail = 0;
+	hdr.ur_flags = ir->ir_flags;
+	hdr.ur_entries = entries;
+	result = copyout(&hdr, rings, sizeof(hdr));
+	if (result) {
+		ioring_free(ir);
+		return result;
+	}
+
+	if (ir->ir_sqpoll) {
+		ir->ir_exitsem = sem_create("uring exit", 0);
+		if (ir->ir_exitsem == NULL) {
+			ioring_free(ir);
+			return ENOMEM;
+		}
+		result = thread_fork("uring poller", curproc, ioring_poller,
+				     ir, 0);
+		if (result) {
+			ioring_free(ir);
+			return result;
+		}
+	}
+
+	curproc->p_ioring = ir;
+	return 0;
+}
+
+/*
+ * uring_enter: without a poller, take up to TO_SUBMIT SQEs and run
+ * them, returning the count; their CQEs are all posted by the time
+ * we return. With a poller, wake it if asked, and with GETEVENTS
+ * wait until MIN_COMPLETE CQEs beyond the current head are posted.
+ */
+int
+sys_uring_enter(unsigned to_submit, unsigned min_complete, int flags,
+		int32_t *retval)
+{
+	struct ioring *ir = curproc->p_ioring;
+	unsigned n, cqhead, target;
+	int result;
+
+	if (ir == NULL) {
+		return EINVAL;
+	}
+	if ((flags & ~(URING_ENTER_GETEVENTS | URING_ENTER_WAKEUP)) != 0) {
+		return EINVAL;
+	}
+
+	if (!ir->ir_sqpoll) {
+		n = 0;
+		if (to_submit > 0) {
+			P(ir->ir_runsem);
+			result = ioring_submit(ir, to_submit, &n);
+			V(ir->ir_runsem);
+			if (result && n == 0) {
+				return result;
+			}
+		}
+		*retval = n;
+		return 0;
+	}
+
+	/*
+	 * The poller may have stopped for lack of CQ space, so waiting
+	 * for CQEs wakes it too.
+	 */
+	if ((flags & (URING_ENTER_WAKEUP | URING_ENTER_GETEVENTS)) != 0) {
+		ioring_wakepoller(ir);
+	}
+
+	if ((flags & URING_ENTER_GETEVENTS) != 0 && min_complete > 0) {
+		if (min_complete > ir->ir_entries) {
+			min_complete = ir->ir_entries;
+		}
+		result = ioring_getidx(IORING_FIELD(ir, ur_cqhead),
+				       &cqhead);
+		if (result) {
+			return result;
+		}
+		target = cqhead + min_complete;
+
+		spinlock_acquire(&ir->ir_lock);
+		while ((int)(ir->ir_cqposted - target) < 0 && !ir->ir_stop) {
+			ir->ir_cqwaiters++;
+			sleepq_sleep(&ir->ir_cqposted, "uring", &ir->ir_lock);
+			ir->ir_cqwaiters--;
+		}
+		spinlock_release(&ir->ir_lock);
+	}
+
+	*retval = 0;
+	return 0;
+}
+
+/*
+ * exec and spawn: keep the ring out of user memory while the current
+ * address space is not the one it lives in.
+ */
+void
+ioring_pause(struct proc *proc)
+{
+	struct ioring *ir = proc->p_ioring;
+
+	if (ir == NULL) {
+		return;
+	}
+	P(ir->ir_runsem);
+	ir->ir_paused = true;
+}
+
+void
+ioring_resume(struct proc *proc)
+{
+	struct ioring *ir = proc->p_ioring;
+
+	if (ir == NULL) {
+		return;
+	}
+	KASSERT(ir->ir_paused);
+	ir->ir_paused = false;
+	V(ir->ir_runsem);
+}
+
+/*
+ * Stop the poller and free the ring; from exec and process exit.
+ */
+void
+ioring_destroy(struct proc *proc)
+{
+	struct ioring *ir = proc->p_ioring;
+
+	KASSERT(proc == curproc);
+	if (ir == NULL) {
+		return;
+	}
+
+	if (ir->ir_sqpoll) {
+		spinlock_acquire(&ir->ir_lock);
+		ir->ir_stop = true;
+		sleepq_wakeall(&ir->ir_cqposted, &ir->ir_lock);
+		spinlock_release(&ir->ir_lock);
+		pollset_wake(&ir->ir_ps);
+		if (ir->ir_paused) {
+			ir->ir_paused = false;
+			V(ir->ir_runsem);
+		}
+		P(ir->ir_exitsem);
+	}
+
+	proc->p_ioring = NULL;
+	ioring_free(ir);
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Tests for the atomic operations in <atomic.h>.
+ *
+ * atomictest checks each operation's return value and effect, first
+ * single-threaded and then with several threads hammering the same
+ * word so that any lost update shows up as a wrong total.
+ *
+ * atomicbench times a shared counter incremented by 1, 2, 4, ...
+ * threads, once with atomic_inc and once with a spinlock, to show
+ * how each scales with the number of CPUs.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <atomic.h>
+#include <spinlock.h>
+#include <synch.h>
+#include <thread.h>
+#include <test.h>
+
+#define NTHREADS	8
+#define NINCS		10000
+#define BENCHINCS	100000
+
+static atomic_t counter;
+static volatile uint32_t bitword;
+static struct spinlock counter_lock = SPINLOCK_INITIALIZER;
+static volatile unsigned locked_counter;
+static struct semaphore *donesem;
+
+static
+void
+atomictest_check(bool cond, const char *what)
+{
+	if (!cond) {
+		panic("atomictest: %s failed\n", what);
+	}
+}
+
+/*
+ * Single-threaded semantics of each operation.
+ */
+static
+void
+atomictest_basic(void)
+{
+	atomic_t a = ATOMIC_INITIALIZER(5);
+	uint32_t w;
+
+	atomictest_check(atomic_read(&a) == 5, "initializer");
+	atomic_set(&a, 10);
+	atomictest_check(atomic_read(&a) == 10, "atomic_set");
+
+	atomic_inc(&a);
+	atomictest_check(atomic_read(&a) == 11, "atomic_inc");
+	atomic_dec(&a);
+	atomictest_check(atomic_read(&a) == 10, "atomic_dec");
+
+	atomictest_check(atomic_fetch_add(&a, 3) == 10, "atomic_fetch_add");
+	atomictest_check(atomic_read(&a) == 13, "atomic_fetch_add result");
+	atomictest_check(atomic_add_return(&a, -4) == 9, "atomic_add_return");
+	atomictest_check(atomic_fetch_add(&a, -10) == 9, "negative add");
+	atomictest_check(atomic_read(&a) == -1, "negative value");
+
+	atomic_set(&a, 2);
+	atomictest_check(!atomic_dec_and_test(&a), "atomic_dec_and_test 2");
+	atomictest_check(atomic_dec_and_test(&a), "atomic_dec_and_test 1");
+
+	atomic_set(&a, 2);
+	atomictest_check(atomic_add_unless(&a, -1, 1), "add_unless 2");
+	atomictest_check(atomic_read(&a) == 1, "add_unless result");
+	atomictest_check(!atomic_add_unless(&a, -1, 1), "add_unless 1");
+	atomictest_check(atomic_read(&a) == 1, "add_unless no-op");
+
+	atomictest_check(atomic_xchg(&a, 42) == 1, "atomic_xchg");
+	atomictest_check(atomic_read(&a) == 42, "atomic_xchg result");
+
+	atomictest_check(atomic_cas(&a, 41, 0) == 42, "failing cas");
+	atomictest_check(atomic_read(&a) == 42, "failing cas no-op");
+	atomictest_check(atomic_cas(&a, 42, 7) == 42, "cas");
+	atomictest_check(atomic_read(&a) == 7, "cas result");
+
+	w = 0;
+	atomic_bit_set(&w, 0);
+	atomic_bit_set(&w, 31);
+	atomictest_check(w == 0x80000001, "atomic_bit_set");
+	atomic_bit_clear(&w, 0);
+	atomictest_check(w == 0x80000000, "atomic_bit_clear");
+	atomictest_check(!atomic_bit_testandset(&w, 4), "testandset clear");
+	atomictest_check(atomic_bit_testandset(&w, 4), "testandset set");
+	atomictest_check(atomic_bit_testandclear(&w, 4), "testandclear set");
+	atomictest_check(!atomic_bit_testandclear(&w, 4), "testandclear clear");
+	atomictest_check(w == 0x80000000, "bit ops result");
+}
+
+/*
+ * Each thread adds one NINCS times with atomic_inc, then NINCS times
+ * with a cas loop, and owns one bit of bitword which it flips NINCS
+ * times.
+ */
+static
+void
+atomictest_thread(void *junk, unsigned long num)
+{
+	int i, old;
+
+	(void)junk;
+
+	for (i=0; i<NINCS; i++) {
+		atomic_inc(&counter);
+	}
+	for (i=0; i<NINCS; i++) {
+		do {
+			old = atomic_read(&counter);
+		} while (atomic_cas(&counter, old, old + 1) != old);
+	}
+	for (i=0; i<NINCS; i++) {
+		if (atomic_bit_testandset(&bitword, num)) {
+			panic("atomictest: bit %lu already set\n", num);
+		}
+		if (!atomic_bit_testandclear(&bitword, num)) {
+			panic("atomictest: bit %lu already clear\n", num);
+		}
+	}
+	V(donesem);
+}
+
+int
+atomictest(int nargs, char **args)
+{
+	char name[16];
+	int i, result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf("Starting atomic test...\n");
+	atomictest_basic();
+
+	donesem = sem_create("atomictest", 0);
+	if (donesem == NULL) {
+		panic("atomictest: sem_create failed\n");
+	}
+	atomic_set(&counter, 0);
+	bitword = 0;
+
+	for (i=0; i<NTHREADS; i++) {
+		snprintf(name, sizeof(name), "atomictest%d", i);
+		result = thread_fork(name, NULL, atomictest_thread, NULL, i);
+		if (result) {
+			panic("atomictest: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<NTHREADS; i++) {
+		P(donesem);
+	}
+	sem_destroy(donesem);
+	donesem = NULL;
+
+	atomictest_check(atomic_read(&counter) == 2 * NINCS * NTHREADS,
+			 "concurrent counter");
+	atomictest_check(bitword == 0, "concurrent bits");
+
+	kprintf("Atomic test done.\n");
+	return 0;
+}
+
+////////////////////////////////////////////////////////////
+
+static
+void
+atomicbench_atomicthread(void *junk, unsigned long n)
+{
+	unsigned long i;
+
+	(void)junk;
+
+	for (i=0; i<n; i++) {
+		atomic_inc(&counter);
+	}
+	V(donesem);
+}
+
+static
+void
+atomicbench_lockthread(void *junk, unsigned long n)
+{
+	unsigned long i;
+
+	(void)junk;
+
+	for (i=0; i<n; i++) {
+		spinlock_acquire(&counter_lock);
+		locked_counter++;
+		spinlock_release(&counter_lock);
+	}
+	V(donesem);
+}
+
+/*
+ * Run NTHREADS threads of FUNC each doing BENCHINCS/nthreads
+ * increments and print how long it took.
+ */
+static
+void
+atomicbench_run(const char *what, unsigned nthreads,
+		void (*func)(void *, unsigned long))
+{
+	struct timespec before, after, duration;
+	unsigned i;
+	int result;
+
+	gettime(&before);
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("atomicbench", NULL, func,
+				     NULL, BENCHINCS / nthreads);
+		if (result) {
+			panic("atomicbench: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	for (i=0; i<nthreads; i++) {
+		P(donesem);
+	}
+	gettime(&after);
+	timespec_sub(&after, &before, &duration);
+
+	kprintf("%-8s %2u threads: %llu.%09lu seconds\n", what, nthreads,
+		(unsigned long long) duration.tv_sec,
+		(unsigned long) duration.tv_nsec);
+}
+
+int
+atomicbench(int nargs, char **args)
+{
+	unsigned nthreads;
+
+	(void)nargs;
+	(void)args;
+
+	donesem = sem_create("atomicbench", 0);
+	if (donesem == NULL) {
+		panic("atomicbench: sem_create failed\n");
+	}
+
+	kprintf("Counter benchmark: %u increments total\n", BENCHINCS);
+	for (nthreads = 1; nthreads <= NTHREADS; nthreads *= 2) {
+		atomic_set(&counter, 0);
+		atomicbench_run("atomic", nthreads, atomicbench_atomicthread);
+		KASSERT(atomic_read(&counter) ==
+			(int)((BENCHINCS / nthreads) * nthreads));
+
+		locked_counter = 0;
+		atomicbench_run("spinlock", nthreads, atomicbench_lockthread);
+		KASSERT(locked_counter == (BENCHINCS / nthreads) * nthreads);
+	}
+
+	sem_destroy(donesem);
+	donesem = NULL;
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Tests for callouts and timed sleeps.
+ *
+ * callouttest schedules callouts at delays on either side of the
+ * timing wheel's level boundaries and checks that each fires on
+ * exactly the tick it was due; checks that a cancelled callout
+ * doesn't fire; and checks that wchan_sleep_timeout both times out
+ * and can be woken early.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <clock.h>
+#include <callout.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <test.h>
+
+static const unsigned delays[] = { 1, 2, 5, 63, 64, 65, 127, 128, 300 };
+#define NDELAYS (sizeof(delays) / sizeof(delays[0]))
+
+struct testcallout {
+	struct callout tc_co;
+	unsigned tc_due;		/* tick it should fire on */
+	volatile unsigned tc_fired;	/* tick it did fire on, or 0 */
+};
+
+static struct testcallout tcs[NDELAYS];
+static struct semaphore *firesem;
+
+static struct wchan *testwchan;
+static struct spinlock testlock = SPINLOCK_INITIALIZER;
+
+static
+void
+callouttest_fire(void *data)
+{
+	struct testcallout *tc = data;
+
+	tc->tc_fired = curcpu->c_hardclocks;
+	if (firesem != NULL) {
+		V(firesem);
+	}
+}
+
+/*
+ * Each callout fires on the tick it's due, whichever wheel level
+ * it started on.
+ */
+static
+void
+callouttest_timing(void)
+{
+	unsigned i, now;
+	int spl;
+
+	kprintf("Scheduling %u callouts, up to %u ticks out...\n",
+		(unsigned)NDELAYS, delays[NDELAYS - 1]);
+
+	/* Schedule them all on the same tick, from the same cpu. */
+	spl = splhigh();
+	now = curcpu->c_hardclocks;
+	for (i=0; i<NDELAYS; i++) {
+		callout_init(&tcs[i].tc_co, callouttest_fire, &tcs[i]);
+		tcs[i].tc_due = now + delays[i];
+		tcs[i].tc_fired = 0;
+		callout_schedule(&tcs[i].tc_co, delays[i]);
+	}
+	splx(spl);
+
+	for (i=0; i<NDELAYS; i++) {
+		P(firesem);
+	}
+	for (i=0; i<NDELAYS; i++) {
+		if (tcs[i].tc_fired != tcs[i].tc_due) {
+			panic("callouttest: %u-tick callout fired on tick %u, "
+			      "not %u\n", delays[i], tcs[i].tc_fired,
+			      tcs[i].tc_due);
+		}
+	}
+	kprintf("All fired on time.\n");
+}
+
+/*
+ * A cancelled callout doesn't fire.
+ */
+static
+void
+callouttest_cancel(void)
+{
+	struct testcallout *tc = &tcs[0];
+
+	kprintf("Cancelling a callout...\n");
+	callout_init(&tc->tc_co, callouttest_fire, tc);
+	tc->tc_fired = 0;
+	callout_schedule(&tc->tc_co, 10);
+	if (!callout_cancel(&tc->tc_co)) {
+		panic("callouttest: pending callout wouldn't cancel\n");
+	}
+	clocksleep_ticks(20);
+	if (tc->tc_fired != 0) {
+		panic("callouttest: cancelled callout fired\n");
+	}
+	if (callout_cancel(&tc->tc_co)) {
+		panic("callouttest: callout cancelled twice\n");
+	}
+	kprintf("Cancelled callout stayed quiet.\n");
+}
+
+static
+void
+callouttest_waker(void *junk, unsigned long ticks)
+{
+	(void)junk;
+
+	clocksleep_ticks(ticks);
+	spinlock_acquire(&testlock);
+	wchan_wakeall(testwchan, &testlock);
+	spinlock_release(&testlock);
+	V(firesem);
+}
+
+/*
+ * wchan_sleep_timeout times out when nobody wakes us, and returns
+ * early when someone does.
+ */
+static
+void
+callouttest_sleep(void)
+{
+	unsigned before, after;
+	int result;
+
+	kprintf("Timed sleep with nobody to wake us...\n");
+	spinlock_acquire(&testlock);
+	before = curcpu->c_hardclocks;
+	result = wchan_sleep_timeout(testwchan, &testlock, 20);
+	spinlock_release(&testlock);
+	after = curcpu->c_hardclocks;
+	if (result != ETIMEDOUT) {
+		panic("callouttest: timed sleep returned %d\n", result);
+	}
+	kprintf("Timed out after about %u ticks (asked for 20)\n",
+		after - before);
+
+	kprintf("Timed sleep with a waker...\n");
+	result = thread_fork("callouttest waker", NULL, callouttest_waker,
+			     NULL, 5);
+	if (result) {
+		panic("callouttest: thread_fork failed: %s\n",
+		      strerror(result));
+	}
+	spinlock_acquire(&testlock);
+	result = wchan_sleep_timeout(testwchan, &testlock, 10 * HZ);
+	spinlock_release(&testlock);
+	if (result != 0) {
+		panic("callouttest: woken sleep returned %d\n", result);
+	}
+	P(firesem);
+	kprintf("Woken up early, as expected.\n");
+}
+
+int
+callouttest(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	firesem = sem_create("callouttest", 0);
+	testwchan = wchan_create("callouttest");
+	if (firesem == NULL || testwchan == NULL) {
+		panic("callouttest: out of memory\n");
+	}
+
+	callouttest_timing();
+	callouttest_cancel();
+	callouttest_sleep();
+
+	wchan_destroy(testwchan);
+	testwchan = NULL;
+	sem_destroy(firesem);
+	firesem = NULL;
+
+	kprintf("Callout test done.\n");
+	return 0;
+}
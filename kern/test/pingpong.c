@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Semaphore ping-pong benchmark.
+ *
+ * Two threads pass control back and forth through a pair of
+ * semaphores, as in a request/reply exchange, and we time the round
+ * trips. It runs once with V and once with V_sync, which hands the
+ * cpu straight to the woken thread (see wchan_wakeone_sync), so the
+ * two numbers show what the direct handoff saves.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <thread.h>
+#include <test.h>
+
+#define PINGPONG_ROUNDS 2000
+
+static struct semaphore *pingsem;
+static struct semaphore *pongsem;
+static struct semaphore *donesem;
+
+static
+void
+pingpong_wake(struct semaphore *sem, bool sync)
+{
+	if (sync) {
+		V_sync(sem);
+	}
+	else {
+		V(sem);
+	}
+}
+
+static
+void
+pingpong_ponger(void *junk, unsigned long sync)
+{
+	unsigned i;
+
+	(void)junk;
+
+	for (i=0; i<PINGPONG_ROUNDS; i++) {
+		P(pingsem);
+		pingpong_wake(pongsem, sync);
+	}
+	V(donesem);
+}
+
+/*
+ * Returns the average round trip in nanoseconds.
+ */
+static
+unsigned
+pingpong_run(bool sync)
+{
+	uint64_t start, end;
+	unsigned i;
+	int result;
+
+	result = thread_fork("ponger", NULL, pingpong_ponger, NULL, sync);
+	if (result) {
+		panic("pingpong: thread_fork failed: %s\n", strerror(result));
+	}
+
+	start = clock_monotonic_ns();
+	for (i=0; i<PINGPONG_ROUNDS; i++) {
+		pingpong_wake(pingsem, sync);
+		P(pongsem);
+	}
+	end = clock_monotonic_ns();
+	P(donesem);
+
+	return (end - start) / PINGPONG_ROUNDS;
+}
+
+int
+pingpongbench(int nargs, char **args)
+{
+	unsigned plain, sync;
+
+	(void)nargs;
+	(void)args;
+
+	pingsem = sem_create("ping", 0);
+	pongsem = sem_create("pong", 0);
+	donesem = sem_create("pingpong done", 0);
+	if (pingsem == NULL || pongsem == NULL || donesem == NULL) {
+		panic("pingpong: out of memory\n");
+	}
+
+	kprintf("Semaphore ping-pong, %u round trips each...\n",
+		PINGPONG_ROUNDS);
+	plain = pingpong_run(false);
+	kprintf("V:      %u ns per round trip\n", plain);
+	sync = pingpong_run(true);
+	kprintf("V_sync: %u ns per round trip\n", sync);
+
+	sem_destroy(donesem);
+	sem_destroy(pongsem);
+	sem_destroy(pingsem);
+	donesem = pongsem = pingsem = NULL;
+
+	kprintf("Ping-pong benchmark done.\n");
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Semaphore create/destroy benchmark.
+ *
+ * Creates and destroys a batch of semaphores and reports the time
+ * per operation and the memory each one takes. Semaphores keep
+ * their waiters on the shared sleep queues (see sleepq.h), so this
+ * is the structure plus a copy of the name and nothing else.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <synch.h>
+#include <test.h>
+
+#define SEMCREATE_COUNT 1000
+#define SEMCREATE_NAME "semcreate"
+
+int
+semcreatebench(int nargs, char **args)
+{
+	struct semaphore **sems;
+	uint64_t start, mid, end;
+	unsigned i;
+
+	(void)nargs;
+	(void)args;
+
+	sems = kmalloc(SEMCREATE_COUNT * sizeof(sems[0]));
+	if (sems == NULL) {
+		panic("semcreate: out of memory\n");
+	}
+
+	kprintf("Creating and destroying %u semaphores...\n",
+		SEMCREATE_COUNT);
+
+	start = clock_monotonic_ns();
+	for (i=0; i<SEMCREATE_COUNT; i++) {
+		sems[i] = sem_create(SEMCREATE_NAME, 0);
+		if (sems[i] == NULL) {
+			panic("semcreate: sem_create failed\n");
+		}
+	}
+	mid = clock_monotonic_ns();
+	for (i=0; i<SEMCREATE_COUNT; i++) {
+		sem_destroy(sems[i]);
+	}
+	end = clock_monotonic_ns();
+
+	kfree(sems);
+
+	kprintf("sem_create:  %u ns each\n",
+		(unsigned)((mid - start) / SEMCREATE_COUNT));
+	kprintf("sem_destroy: %u ns each\n",
+		(unsigned)((end - mid) / SEMCREATE_COUNT));
+	kprintf("Memory: %u bytes of semaphore + %u of name, "
+		"before kmalloc rounding\n",
+		(unsigned)sizeof(struct semaphore),
+		(unsigned)sizeof(SEMCREATE_NAME));
+
+	kprintf("Semaphore create benchmark done.\n");
+	return 0;
+}
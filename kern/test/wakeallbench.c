@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Broadcast wakeup benchmark.
+ *
+ * A crowd of threads sleeps on one key and the main thread wakes
+ * them all at once with sleepq_wakeall, over and over, waiting each
+ * time until every thread has run and gone back to sleep. Woken
+ * threads spread over the idle cpus, so this is a storm of remote
+ * wakeups; we report the time per round and how many IPIs were sent
+ * and how many were coalesced away (see ipi_send).
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <sleepq.h>
+#include <thread.h>
+#include <test.h>
+
+#define WAKEALL_THREADS 32
+#define WAKEALL_ROUNDS 200
+
+static struct spinlock wakeall_lock = SPINLOCK_INITIALIZER;
+static unsigned wakeall_gen;		/* bumped to wake the crowd */
+static unsigned wakeall_arrived;	/* threads done with this round */
+
+/*
+ * Check in for the round; the last one to arrive wakes the main
+ * thread. Called with wakeall_lock held.
+ */
+static
+void
+wakeall_arrive(void)
+{
+	wakeall_arrived++;
+	if (wakeall_arrived == WAKEALL_THREADS) {
+		sleepq_wakeone(&wakeall_arrived, &wakeall_lock);
+	}
+}
+
+static
+void
+wakeall_sleeper(void *junk, unsigned long num)
+{
+	unsigned i, gen;
+
+	(void)junk;
+	(void)num;
+
+	spinlock_acquire(&wakeall_lock);
+	for (i=0; i<WAKEALL_ROUNDS; i++) {
+		gen = wakeall_gen;
+		wakeall_arrive();
+		while (wakeall_gen == gen) {
+			sleepq_sleep(&wakeall_gen, "wakeall", &wakeall_lock);
+		}
+	}
+	/* Final check-in so the main thread knows we're done. */
+	wakeall_arrive();
+	spinlock_release(&wakeall_lock);
+}
+
+/*
+ * Wait for every sleeper to check in, and reset the count.
+ */
+static
+void
+wakeall_gather(void)
+{
+	spinlock_acquire(&wakeall_lock);
+	while (wakeall_arrived < WAKEALL_THREADS) {
+		sleepq_sleep(&wakeall_arrived, "wakeall main", &wakeall_lock);
+	}
+	wakeall_arrived = 0;
+	spinlock_release(&wakeall_lock);
+}
+
+int
+wakeallbench(int nargs, char **args)
+{
+	uint64_t start, end;
+	unsigned sent0, coalesced0, sent1, coalesced1;
+	unsigned i;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	wakeall_gen = 0;
+	wakeall_arrived = 0;
+
+	kprintf("Broadcast wakeup: %u threads, %u rounds...\n",
+		WAKEALL_THREADS, WAKEALL_ROUNDS);
+	for (i=0; i<WAKEALL_THREADS; i++) {
+		result = thread_fork("wakeall", NULL, wakeall_sleeper,
+				     NULL, i);
+		if (result) {
+			panic("wakeall: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+	wakeall_gather();
+
+	ipi_counts(&sent0, &coalesced0);
+	start = clock_monotonic_ns();
+	for (i=0; i<WAKEALL_ROUNDS; i++) {
+		spinlock_acquire(&wakeall_lock);
+		wakeall_gen++;
+		sleepq_wakeall(&wakeall_gen, &wakeall_lock);
+		spinlock_release(&wakeall_lock);
+		wakeall_gather();
+	}
+	end = clock_monotonic_ns();
+	ipi_counts(&sent1, &coalesced1);
+
+	kprintf("%u ns per round\n",
+		(unsigned)((end - start) / WAKEALL_ROUNDS));
+	kprintf("IPIs: %u sent, %u coalesced (%u.%02u sent per round)\n",
+		sent1 - sent0, coalesced1 - coalesced0,
+		(sent1 - sent0) / WAKEALL_ROUNDS,
+		(sent1 - sent0) * 100 / WAKEALL_ROUNDS % 100);
+
+	kprintf("Broadcast wakeup benchmark done.\n");
+	return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Tests for workqueues.
+ *
+ * workqueuetest queues a batch of work items and checks that each
+ * runs exactly once, in order, on the worker thread, and reports how
+ * long they waited; checks that queueing a pending item is refused;
+ * and checks that delayed work runs no earlier than asked and can be
+ * cancelled.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <clock.h>
+#include <workqueue.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <test.h>
+
+#define NWORK 32
+
+struct testwork {
+	struct work tw_work;
+	unsigned tw_num;
+	uint64_t tw_queued;		/* clock_monotonic_ns when queued */
+	uint64_t tw_ran;		/* ... when it ran */
+	struct thread *tw_thread;	/* who ran it */
+	volatile unsigned tw_runs;
+};
+
+static struct testwork tws[NWORK];
+static struct semaphore *donesem;
+static volatile unsigned nextnum;
+
+static
+void
+workqueuetest_run(void *data)
+{
+	struct testwork *tw = data;
+
+	tw->tw_ran = clock_monotonic_ns();
+	tw->tw_thread = curthread;
+	tw->tw_runs++;
+	if (tw->tw_num != nextnum) {
+		panic("workqueuetest: item %u ran when %u was next\n",
+		      tw->tw_num, nextnum);
+	}
+	nextnum++;
+	V(donesem);
+}
+
+static
+void
+workqueuetest_init(struct testwork *tw, unsigned num)
+{
+	work_init(&tw->tw_work, workqueuetest_run, tw);
+	tw->tw_num = num;
+	tw->tw_queued = 0;
+	tw->tw_ran = 0;
+	tw->tw_thread = NULL;
+	tw->tw_runs = 0;
+}
+
+/*
+ * A batch runs in order, once each, on another thread. Queue with
+ * interrupts off so the worker can't start until all are queued.
+ */
+static
+void
+workqueuetest_batch(void)
+{
+	uint64_t wait, total, max;
+	unsigned i;
+	int spl;
+
+	kprintf("Queueing %u work items...\n", NWORK);
+	nextnum = 0;
+	spl = splhigh();
+	for (i=0; i<NWORK; i++) {
+		workqueuetest_init(&tws[i], i);
+		tws[i].tw_queued = clock_monotonic_ns();
+		if (!queue_work(&tws[i].tw_work)) {
+			panic("workqueuetest: idle item not queued\n");
+		}
+	}
+	if (queue_work(&tws[0].tw_work)) {
+		panic("workqueuetest: pending item queued twice\n");
+	}
+	splx(spl);
+
+	for (i=0; i<NWORK; i++) {
+		P(donesem);
+	}
+
+	total = max = 0;
+	for (i=0; i<NWORK; i++) {
+		if (tws[i].tw_runs != 1) {
+			panic("workqueuetest: item %u ran %u times\n",
+			      i, tws[i].tw_runs);
+		}
+		if (tws[i].tw_thread == curthread) {
+			panic("workqueuetest: item %u ran in the caller\n", i);
+		}
+		wait = tws[i].tw_ran - tws[i].tw_queued;
+		total += wait;
+		if (wait > max) {
+			max = wait;
+		}
+	}
+	kprintf("All ran once, in order. Queue-to-run: avg %u us, "
+		"max %u us\n", (unsigned)(total / NWORK / 1000),
+		(unsigned)(max / 1000));
+}
+
+/*
+ * Delayed work waits at least as long as asked, and can be
+ * cancelled before then.
+ */
+static
+void
+workqueuetest_delayed(void)
+{
+	struct testwork *tw = &tws[0];
+	uint64_t start;
+
+	kprintf("Delayed work, 10 ticks...\n");
+	nextnum = 0;
+	workqueuetest_init(tw, 0);
+	start = clock_monotonic_ns();
+	if (!queue_delayed_work(&tw->tw_work, 10)) {
+		panic("workqueuetest: idle item not queued\n");
+	}
+	P(donesem);
+	if (tw->tw_ran - start < 9 * (1000000000 / HZ)) {
+		panic("workqueuetest: delayed work ran after only %u us\n",
+		      (unsigned)((tw->tw_ran - start) / 1000));
+	}
+	kprintf("Ran after %u us\n", (unsigned)((tw->tw_ran - start) / 1000));
+
+	kprintf("Cancelling delayed work...\n");
+	workqueuetest_init(tw, 0);
+	queue_delayed_work(&tw->tw_work, 10);
+	if (!cancel_delayed_work(&tw->tw_work)) {
+		panic("workqueuetest: delayed work wouldn't cancel\n");
+	}
+	clocksleep_ticks(20);
+	if (tw->tw_runs != 0) {
+		panic("workqueuetest: cancelled work ran\n");
+	}
+	if (!queue_work(&tw->tw_work)) {
+		panic("workqueuetest: cancelled item can't be queued\n");
+	}
+	P(donesem);
+	kprintf("Cancelled work stayed quiet and could be queued again.\n");
+}
+
+int
+workqueuetest(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	donesem = sem_create("workqueuetest", 0);
+	if (donesem == NULL) {
+		panic("workqueuetest: out of memory\n");
+	}
+
+	workqueuetest_batch();
+	workqueuetest_delayed();
+
+	sem_destroy(donesem);
+	donesem = NULL;
+
+	kprintf("Workqueue test done.\n");
+	return 0;
+}
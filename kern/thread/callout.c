@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Callouts, kept in a per-cpu hierarchical timing wheel.
+ *
+ * Level 0 of the wheel has one slot for each of the next
+ * CALLOUT_SLOTS ticks. Level 1 has one slot for each of the next
+ * CALLOUT_SLOTS blocks of CALLOUT_SLOTS ticks, and so on up. A
+ * callout goes in the lowest level whose range covers it, indexed by
+ * the corresponding bits of its expiry tick. Each time the level 0
+ * index wraps around to 0, the current slot of level 1 is emptied
+ * and its callouts put back in (now in level 0); when that wraps
+ * too, level 2 is cascaded into level 1; etc. This is the scheme
+ * classic BSD and Linux kernels use.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <current.h>
+#include <callout.h>
+
+#define CALLOUT_SLOTMASK	(CALLOUT_SLOTS - 1)
+
+/* The longest a callout can be put off, in ticks. */
+#define CALLOUT_MAXTICKS	((1U << (CALLOUT_LEVELS * CALLOUT_LEVELBITS)) - 1)
+
+/* Index of tick T in wheel level L. */
+#define CALLOUT_INDEX(t, l) \
+	(((t) >> ((l) * CALLOUT_LEVELBITS)) & CALLOUT_SLOTMASK)
+
+/*
+ * Slot list handling.
+ */
+static
+void
+callout_link(struct callout **head, struct callout *co)
+{
+	co->co_next = *head;
+	if (co->co_next != NULL) {
+		co->co_next->co_prevp = &co->co_next;
+	}
+	co->co_prevp = head;
+	*head = co;
+}
+
+static
+void
+callout_unlink(struct callout *co)
+{
+	*co->co_prevp = co->co_next;
+	if (co->co_next != NULL) {
+		co->co_next->co_prevp = co->co_prevp;
+	}
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+}
+
+/*
+ * Put CO in the slot of CW its expiry tick belongs in. Something
+ * already due goes in the slot for the next tick to be processed.
+ */
+static
+void
+callout_place(struct callout_wheel *cw, struct callout *co)
+{
+	unsigned delta, level;
+
+	KASSERT(spinlock_do_i_hold(&cw->cw_lock));
+
+	delta = co->co_expire - cw->cw_next;
+	if ((int)delta < 0) {
+		co->co_expire = cw->cw_next;
+		delta = 0;
+	}
+	for (level = 0; level < CALLOUT_LEVELS - 1; level++) {
+		if (delta < (1U << ((level + 1) * CALLOUT_LEVELBITS))) {
+			break;
+		}
+	}
+	callout_link(&cw->cw_slots[level][CALLOUT_INDEX(co->co_expire, level)],
+		     co);
+}
+
+/*
+ * Move everything in slot INDEX of LEVEL down the wheel. Returns
+ * INDEX, so the caller can tell whether the next level up also
+ * needs to cascade (it does if INDEX is 0).
+ */
+static
+unsigned
+callout_cascade(struct callout_wheel *cw, unsigned level, unsigned index)
+{
+	struct callout *list, *co;
+
+	list = cw->cw_slots[level][index];
+	cw->cw_slots[level][index] = NULL;
+	while ((co = list) != NULL) {
+		list = co->co_next;
+		co->co_next = NULL;
+		co->co_prevp = NULL;
+		callout_place(cw, co);
+	}
+	return index;
+}
+
+////////////////////////////////////////////////////////////
+// Interface
+
+void
+callout_init(struct callout *co, void (*func)(void *), void *arg)
+{
+	co->co_next = NULL;
+	co->co_prevp = NULL;
+	co->co_wheel = NULL;
+	co->co_pending = false;
+	co->co_expire = 0;
+	co->co_func = func;
+	co->co_arg = arg;
+}
+
+void
+callout_schedule(struct callout *co, unsigned ticks)
+{
+	struct callout_wheel *cw;
+
+	if (ticks == 0) {
+		ticks = 1;
+	}
+	if (ticks > CALLOUT_MAXTICKS) {
+		ticks = CALLOUT_MAXTICKS;
+	}
+
+	cw = &curcpu->c_callouts;
+	spinlock_acquire(&cw->cw_lock);
+	KASSERT(!co->co_pending);
+	co->co_wheel = cw;
+	co->co_pending = true;
+	co->co_expire = curcpu->c_hardclocks + ticks;
+	callout_place(cw, co);
+	cw->cw_count++;
+	spinlock_release(&cw->cw_lock);
+}
+
+bool
+callout_cancel(struct callout *co)
+{
+	struct callout_wheel *cw;
+
+	cw = co->co_wheel;
+	if (cw == NULL) {
+		/* Never scheduled. */
+		return false;
+	}
+
+	spinlock_acquire(&cw->cw_lock);
+	if (co->co_pending) {
+		callout_unlink(co);
+		co->co_pending = false;
+		cw->cw_count--;
+		spinlock_release(&cw->cw_lock);
+		return true;
+	}
+
+	/* Fired already; wait if it's still running elsewhere. */
+	KASSERT(cw->cw_running != co || cw != &curcpu->c_callouts);
+	while (cw->cw_running == co) {
+		spinlock_release(&cw->cw_lock);
+		spinlock_acquire(&cw->cw_lock);
+	}
+	spinlock_release(&cw->cw_lock);
+	return false;
+}
+
+void
+callout_wheel_init(struct callout_wheel *cw, unsigned now)
+{
+	unsigned i, j;
+
+	spinlock_init(&cw->cw_lock);
+	cw->cw_next = now + 1;
+	cw->cw_count = 0;
+	cw->cw_running = NULL;
+	for (i=0; i<CALLOUT_LEVELS; i++) {
+		for (j=0; j<CALLOUT_SLOTS; j++) {
+			cw->cw_slots[i][j] = NULL;
+		}
+	}
+}
+
+/*
+ * Process every tick up to and including NOW on this cpu's wheel:
+ * cascade where needed and run what's due. Called from hardclock.
+ * NOW can be more than one past the last call if the cpu skipped
+ * ticks while idle.
+ */
+void
+callout_hardclock(unsigned now)
+{
+	struct callout_wheel *cw;
+	struct callout *co;
+	unsigned index, level;
+
+	cw = &curcpu->c_callouts;
+	spinlock_acquire(&cw->cw_lock);
+	while ((int)(now - cw->cw_next) >= 0) {
+		index = cw->cw_next & CALLOUT_SLOTMASK;
+		for (level = 1; index == 0 && level < CALLOUT_LEVELS; level++) {
+			index = callout_cascade(cw, level,
+				CALLOUT_INDEX(cw->cw_next, level));
+		}
+		index = cw->cw_next & CALLOUT_SLOTMASK;
+		cw->cw_next++;
+
+		while ((co = cw->cw_slots[0][index]) != NULL) {
+			callout_unlink(co);
+			co->co_pending = false;
+			cw->cw_count--;
+			cw->cw_running = co;
+			spinlock_release(&cw->cw_lock);
+
+			co->co_func(co->co_arg);
+
+			spinlock_acquire(&cw->cw_lock);
+			cw->cw_running = NULL;
+		}
+	}
+	spinlock_release(&cw->cw_lock);
+}
+
+/*
+ * Return how many ticks from now this cpu's next callout is due, or
+ * MAX if that's further. This doesn't look past the next time level
+ * 0 wraps around, since that needs a cascade, which might bring
+ * something due sooner; nor does it promise more than 1 if ticks
+ * are still waiting to be processed.
+ */
+unsigned
+callout_idleticks(unsigned max)
+{
+	struct callout_wheel *cw;
+	unsigned i, t;
+
+	cw = &curcpu->c_callouts;
+	spinlock_acquire(&cw->cw_lock);
+	if (cw->cw_count == 0) {
+		spinlock_release(&cw->cw_lock);
+		return max;
+	}
+	if (cw->cw_next != curcpu->c_hardclocks + 1) {
+		spinlock_release(&cw->cw_lock);
+		return 1;
+	}
+	for (i=0; i<max; i++) {
+		t = cw->cw_next + i;
+		if ((t & CALLOUT_SLOTMASK) == 0 ||
+		    cw->cw_slots[0][t & CALLOUT_SLOTMASK] != NULL) {
+			break;
+		}
+	}
+	spinlock_release(&cw->cw_lock);
+	return i + 1 < max ? i + 1 : max;
+}
@@ -28,12 +28,15 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
 #include <lib.h>
 #include <cpu.h>
 #include <wchan.h>
 #include <clock.h>
 #include <thread.h>
 #include <current.h>
+#include <mainbus.h>
+#include <spl.h>
 
 /*
  * Time handling.
@@ -51,7 +54,7 @@
  * the scheduler.
  */
 #define SCHEDULE_HARDCLOCKS	4	/* Reschedule every 4 hardclocks. */
-#define MIGRATE_HARDCLOCKS	16	/* Migrate every 16 hardclocks. */
+#define IDLE_MAX_HARDCLOCKS	HZ	/* Idle at most a second per tick. */
 
 /*
  * Once a second, everything waiting on lbolt is awakened by CPU 0.
@@ -59,6 +62,16 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * Channel for clocksleep(). Nobody ever wakes it; sleepers come off
+ * it only when their timeouts expire.
+ */
+static struct wchan *sleep_wchan;
+static struct spinlock sleep_lock;
+
+/* Longest single timed sleep; clocksleep_ticks loops for more. */
+#define SLEEP_MAX_HARDCLOCKS	(3600 * HZ)
+
 /*
  * Setup.
  */
@@ -70,6 +83,11 @@ hardclock_bootstrap(void)
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
 	}
+	spinlock_init(&sleep_lock);
+	sleep_wchan = wchan_create("clocksleep");
+	if (sleep_wchan == NULL) {
+		panic("Couldn't create clocksleep wchan\n");
+	}
 }
 
 /*
@@ -85,9 +103,72 @@ timerclock(void)
 	spinlock_release(&lbolt_lock);
 }
 
+/*
+ * Account for hardclocks that were never delivered because the cpu
+ * was idle with its clock stopped.
+ */
+static
+void
+hardclock_skipped(unsigned ticks)
+{
+	curcpu->c_hardclocks += ticks;
+	curcpu->c_ticks_skipped += ticks;
+}
+
+/*
+ * Tickless idle.
+ *
+ * An idle cpu has nothing to do on a clock tick but wake up, find
+ * nothing to run, and go back to sleep. So before idling, the idle
+ * loop calls hardclock_idle() to push the next timer interrupt out
+ * to the next time something actually needs to happen, and after
+ * waking calls hardclock_unidle() to go back to ticking HZ times a
+ * second and to account for the ticks that were skipped.
+ *
+ * The next time something needs to happen is the next callout due
+ * on this cpu, or IDLE_MAX_HARDCLOCKS away if that's later. Idle
+ * cpus that need to wake earlier because there's work are sent an
+ * IPI.
+ *
+ * Both are called with interrupts off.
+ */
+void
+hardclock_idle(void)
+{
+	unsigned ticks;
+
+	KASSERT(curcpu->c_isidle);
+
+	if (curcpu->c_ticks_deferred > 0) {
+		/* Still deferred; the tick is pending. */
+		return;
+	}
+	ticks = callout_idleticks(IDLE_MAX_HARDCLOCKS);
+	if (ticks > 1 && mainbus_timer_defer(ticks)) {
+		curcpu->c_ticks_deferred = ticks;
+	}
+}
+
+void
+hardclock_unidle(void)
+{
+	unsigned elapsed;
+
+	if (curcpu->c_ticks_deferred == 0) {
+		/* Already ticking (the deferred tick came) */
+		return;
+	}
+	if (!mainbus_timer_undefer(&elapsed)) {
+		/* The deferred tick is pending; hardclock will handle it */
+		return;
+	}
+	curcpu->c_ticks_deferred = 0;
+	hardclock_skipped(elapsed);
+}
+
 /*
  * This is called HZ times a second (on each processor) by the timer
- * code.
+ * code, except while the processor is idle; see above.
  */
 void
 hardclock(void)
@@ -96,14 +177,161 @@ hardclock(void)
 	 * Collect statistics here as desired.
 	 */
 
-	curcpu->c_hardclocks++;
-	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
-		thread_consider_migration();
+	if (curcpu->c_ticks_deferred > 0) {
+		/*
+		 * This is the deferred tick from hardclock_idle; we
+		 * slept through all the ones before it.
+		 */
+		hardclock_skipped(curcpu->c_ticks_deferred - 1);
+		curcpu->c_ticks_deferred = 0;
 	}
+
+	curcpu->c_hardclocks++;
+	callout_hardclock(curcpu->c_hardclocks);
 	if ((curcpu->c_hardclocks % SCHEDULE_HARDCLOCKS) == 0) {
 		schedule();
 	}
-	thread_yield();
+	if (schedule_tick()) {
+		thread_yield();
+	}
+}
+
+/*
+ * High-resolution clock.
+ *
+ * gettime() reads the real-time clock device, which is slow. For
+ * anything that wants cheap or fine-grained time, we count cpu
+ * cycles instead (mainbus_cycles()) and convert to nanoseconds with
+ * a multiplier measured against the real-time clock at boot:
+ *
+ *     ns = cycles * cycle_mult / 2^CYCLE_SHIFT
+ *
+ * Each cpu's cycle count starts when that cpu does, so each cpu
+ * also gets an offset (c_clock_offset) that lines it up with time
+ * since boot, again measured against the real-time clock.
+ */
+#define CYCLE_SHIFT		16
+#define CALIBRATE_NS		50000000	/* 50 ms */
+
+static uint32_t cycle_mult;
+static struct timespec boottime;	/* wall clock at monotonic time 0 */
+
+static
+uint64_t
+timespec_to_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+/*
+ * Split the multiply so it can't overflow for any reasonable uptime.
+ */
+static
+uint64_t
+cycles_to_ns(uint64_t cycles)
+{
+	return (cycles >> CYCLE_SHIFT) * cycle_mult +
+		(((cycles & ((1U << CYCLE_SHIFT) - 1)) * cycle_mult)
+		 >> CYCLE_SHIFT);
+}
+
+/*
+ * Calibrate the cycle counter: count cycles across CALIBRATE_NS of
+ * real-time clock. Called once, on the boot cpu, after devices are
+ * probed.
+ */
+void
+clocksource_bootstrap(void)
+{
+	struct timespec now, diff;
+	uint64_t c0, c1, ns;
+
+	gettime(&boottime);
+	c0 = mainbus_cycles();
+	do {
+		gettime(&now);
+		timespec_sub(&now, &boottime, &diff);
+		ns = timespec_to_ns(&diff);
+	} while (ns < CALIBRATE_NS);
+	c1 = mainbus_cycles();
+
+	cycle_mult = (ns << CYCLE_SHIFT) / (c1 - c0);
+	kprintf("clock: cycle counter at %u kHz\n",
+		(unsigned)((c1 - c0) * 1000000 / ns));
+
+	clocksource_hatch();
+}
+
+/*
+ * Compute this cpu's offset. Called on each cpu as it starts.
+ */
+void
+clocksource_hatch(void)
+{
+	struct timespec now, diff;
+	uint64_t cycles;
+	int spl;
+
+	KASSERT(cycle_mult != 0);
+
+	spl = splhigh();
+	gettime(&now);
+	cycles = mainbus_cycles();
+	timespec_sub(&now, &boottime, &diff);
+	curcpu->c_clock_offset =
+		(int64_t)timespec_to_ns(&diff) - (int64_t)cycles_to_ns(cycles);
+	splx(spl);
+}
+
+/*
+ * Nanoseconds since boot.
+ */
+uint64_t
+clock_monotonic_ns(void)
+{
+	uint64_t ns;
+	int spl;
+
+	/* Don't migrate between reading the count and the offset. */
+	spl = splhigh();
+	ns = cycles_to_ns(mainbus_cycles()) + curcpu->c_clock_offset;
+	splx(spl);
+	return ns;
+}
+
+/*
+ * Current wall-clock time, without touching the clock device.
+ */
+void
+clock_realtime(struct timespec *ret)
+{
+	uint64_t ns;
+	struct timespec since;
+
+	ns = clock_monotonic_ns();
+	since.tv_sec = ns / 1000000000;
+	since.tv_nsec = ns % 1000000000;
+	timespec_add(&boottime, &since, ret);
+}
+
+/*
+ * Suspend execution for n hardclocks.
+ */
+void
+clocksleep_ticks(unsigned ticks)
+{
+	unsigned chunk;
+	int result;
+
+	spinlock_acquire(&sleep_lock);
+	while (ticks > 0) {
+		chunk = ticks < SLEEP_MAX_HARDCLOCKS ?
+			ticks : SLEEP_MAX_HARDCLOCKS;
+		result = wchan_sleep_timeout(sleep_wchan, &sleep_lock, chunk);
+		KASSERT(result == ETIMEDOUT);
+		ticks -= chunk;
+	}
+	spinlock_release(&sleep_lock);
 }
 
 /*
@@ -112,10 +340,7 @@ hardclock(void)
 void
 clocksleep(int num_secs)
 {
-	spinlock_acquire(&lbolt_lock);
-	while (num_secs > 0) {
-		wchan_sleep(lbolt, &lbolt_lock);
-		num_secs--;
+	if (num_secs > 0) {
+		clocksleep_ticks((unsigned)num_secs * HZ);
 	}
-	spinlock_release(&lbolt_lock);
 }
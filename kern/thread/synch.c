@@ -35,7 +35,7 @@
 #include <types.h>
 #include <lib.h>
 #include <spinlock.h>
-#include <wchan.h>
+#include <sleepq.h>
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
@@ -60,13 +60,6 @@ sem_create(const char *name, unsigned initial_count)
                 return NULL;
         }
 
-	sem->sem_wchan = wchan_create(sem->sem_name);
-	if (sem->sem_wchan == NULL) {
-		kfree(sem->sem_name);
-		kfree(sem);
-		return NULL;
-	}
-
 	spinlock_init(&sem->sem_lock);
         sem->sem_count = initial_count;
 
@@ -78,9 +71,8 @@ sem_destroy(struct semaphore *sem)
 {
         KASSERT(sem != NULL);
 
-	/* wchan_cleanup will assert if anyone's waiting on it */
+	KASSERT(sleepq_isempty(sem));
 	spinlock_cleanup(&sem->sem_lock);
-	wchan_destroy(sem->sem_wchan);
         kfree(sem->sem_name);
         kfree(sem);
 }
@@ -98,7 +90,7 @@ P(struct semaphore *sem)
          */
         KASSERT(curthread->t_in_interrupt == false);
 
-	/* Use the semaphore spinlock to protect the wchan as well. */
+	/* The semaphore spinlock covers its sleep queue as well. */
 	spinlock_acquire(&sem->sem_lock);
         while (sem->sem_count == 0) {
 		/*
@@ -113,13 +105,29 @@ P(struct semaphore *sem)
 		 * Exercise: how would you implement strict FIFO
 		 * ordering?
 		 */
-		wchan_sleep(sem->sem_wchan, &sem->sem_lock);
+		sleepq_sleep(sem, sem->sem_name, &sem->sem_lock);
         }
         KASSERT(sem->sem_count > 0);
         sem->sem_count--;
 	spinlock_release(&sem->sem_lock);
 }
 
+bool
+tryP(struct semaphore *sem)
+{
+	bool ret;
+
+        KASSERT(sem != NULL);
+
+	spinlock_acquire(&sem->sem_lock);
+	ret = sem->sem_count > 0;
+	if (ret) {
+		sem->sem_count--;
+	}
+	spinlock_release(&sem->sem_lock);
+	return ret;
+}
+
 void
 V(struct semaphore *sem)
 {
@@ -129,7 +137,21 @@ V(struct semaphore *sem)
 
         sem->sem_count++;
         KASSERT(sem->sem_count > 0);
-	wchan_wakeone(sem->sem_wchan, &sem->sem_lock);
+	sleepq_wakeone(sem, &sem->sem_lock);
+
+	spinlock_release(&sem->sem_lock);
+}
+
+void
+V_sync(struct semaphore *sem)
+{
+        KASSERT(sem != NULL);
+
+	spinlock_acquire(&sem->sem_lock);
+
+        sem->sem_count++;
+        KASSERT(sem->sem_count > 0);
+	sleepq_wakeone_sync(sem, &sem->sem_lock);
 
 	spinlock_release(&sem->sem_lock);
 }
@@ -35,12 +35,17 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <kern/sched.h>
 #include <lib.h>
 #include <array.h>
 #include <cpu.h>
 #include <spl.h>
+#include <clock.h>
 #include <spinlock.h>
 #include <wchan.h>
+#include <sleepq.h>
 #include <thread.h>
 #include <threadlist.h>
 #include <threadprivate.h>
@@ -55,12 +60,37 @@
 /* Magic number used as a guard value on kernel thread stacks. */
 #define THREAD_STACK_MAGIC 0xbaadf00d
 
+/*
+ * Zombies are left until there are this many on a cpu (or until
+ * thread_fork wants their stacks), and then reaped together.
+ */
+#define ZOMBIE_BATCH 8
+
+/*
+ * How often schedule() boosts every thread back to its base level.
+ * Must be a multiple of SCHEDULE_HARDCLOCKS in clock.c.
+ */
+#define SCHED_BOOST_HARDCLOCKS	100
+
 /* Wait channel. A wchan is protected by an associated, passed-in spinlock. */
 struct wchan {
 	const char *wc_name;		/* name for this channel */
 	struct threadlist wc_threads;	/* list of waiting threads */
 };
 
+/*
+ * Sleep queue hash table (see sleepq.h). Each bucket is a wait
+ * channel shared by every key that hashes there, with its own lock.
+ */
+#define SLEEPQ_HASHBITS	6
+#define SLEEPQ_HASHSIZE	(1U << SLEEPQ_HASHBITS)
+
+struct sleepq {
+	struct spinlock sq_lock;
+	struct wchan sq_wchan;
+};
+static struct sleepq sleepqs[SLEEPQ_HASHSIZE];
+
 /* Master array of CPUs. */
 DECLARRAY(cpu, static __UNUSED inline);
 DEFARRAY(cpu, static __UNUSED inline);
@@ -86,6 +116,59 @@ thread_checkstack_init(struct thread *thread)
 	((uint32_t *)thread->t_stack)[3] = THREAD_STACK_MAGIC;
 }
 
+/*
+ * Kernel stack allocation. Each cpu keeps up to STACK_CACHE free
+ * stacks, so threads that come and go quickly don't cost a page
+ * allocation and free each. A stack goes into the cache only after
+ * thread_checkstack has passed on it, so the magic numbers are
+ * still in place and a cached stack needs no initialization.
+ *
+ * The cache is only touched by its own cpu, with interrupts off.
+ */
+static
+void
+thread_stack_get(struct thread *thread)
+{
+	struct cpu *c;
+	int spl;
+
+	thread->t_stack = NULL;
+
+	spl = splhigh();
+	c = curcpu->c_self;
+	if (c->c_nstacks > 0) {
+		thread->t_stack = c->c_stacks[--c->c_nstacks];
+	}
+	splx(spl);
+
+	if (thread->t_stack == NULL) {
+		thread->t_stack = kmalloc(STACK_SIZE);
+		if (thread->t_stack != NULL) {
+			thread_checkstack_init(thread);
+		}
+	}
+}
+
+static
+void
+thread_stack_put(void *stack)
+{
+	struct cpu *c;
+	int spl;
+
+	spl = splhigh();
+	c = curcpu->c_self;
+	if (c->c_nstacks < STACK_CACHE) {
+		c->c_stacks[c->c_nstacks++] = stack;
+		stack = NULL;
+	}
+	splx(spl);
+
+	if (stack != NULL) {
+		kfree(stack);
+	}
+}
+
 /*
  * Check the magic number we put on the bottom end of the stack in
  * thread_checkstack_init. If these assertions go off, it most likely
@@ -131,6 +214,8 @@ thread_create(const char *name)
 		return NULL;
 	}
 	thread->t_wchan_name = "NEW";
+	thread->t_wchan = NULL;
+	thread->t_sleepkey = NULL;
 	thread->t_state = S_READY;
 
 	/* Thread subsystem fields */
@@ -141,12 +226,32 @@ thread_create(const char *name)
 	thread->t_cpu = NULL;
 	thread->t_proc = NULL;
 	HANGMAN_ACTORINIT(&thread->t_hangman, thread->t_name);
+	thread->t_level = 0;
+	thread->t_slice = SCHED_SLICE(0);
+	thread->t_affinity = CPUMASK_ALL;
+	thread->t_lastwaker = NULL;
+	thread->t_rtprio = 0;
+	thread->t_rtruntime = 0;
+	thread->t_rtperiod = 0;
+	thread->t_rtbudget = 0;
+	thread->t_rtrenew = 0;
+	thread->t_cputime[CPUTIME_USER] = 0;
+	thread->t_cputime[CPUTIME_SYS] = 0;
+	thread->t_cputime[CPUTIME_INTR] = 0;
+	thread->t_acct_state = CPUTIME_SYS;
+	thread->t_nvcsw = 0;
+	thread->t_nivcsw = 0;
+	thread->t_readystamp = 0;
+	thread->t_runstamp = 0;
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
 	thread->t_curspl = IPL_HIGH;
 	thread->t_iplhigh_count = 1; /* corresponding to t_curspl */
 
+	/* Public fields */
+	thread->t_nowait = false;
+
 	/* If you add to struct thread, be sure to initialize here */
 
 	return thread;
@@ -166,6 +271,7 @@ cpu_create(unsigned hardware_number)
 	struct cpu *c;
 	int result;
 	char namebuf[16];
+	unsigned i;
 
 	c = kmalloc(sizeof(*c));
 	if (c == NULL) {
@@ -178,11 +284,38 @@ cpu_create(unsigned hardware_number)
 	c->c_curthread = NULL;
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
+	c->c_lastboost = 0;
+	c->c_ticks_deferred = 0;
+	c->c_ticks_skipped = 0;
+	c->c_clock_offset = 0;
 	c->c_spinlocks = 0;
+	c->c_migrating = NULL;
+	for (i=0; i<CPUTIME_NSTATES; i++) {
+		c->c_cputime[i] = 0;
+	}
+	c->c_acct_stamp = 0;
+	c->c_acct_state = CPUTIME_SYS;
+	c->c_wakeups = 0;
+	c->c_wakeups_remote = 0;
+	c->c_wakeups_affine = 0;
+	c->c_ipi_sent = 0;
+	c->c_ipi_coalesced = 0;
+	c->c_ipi_received = 0;
+	c->c_handoffs = 0;
+	c->c_nstacks = 0;
+	c->c_resched = false;
+	for (i=0; i<SCHED_LATBUCKETS; i++) {
+		c->c_waithist[i] = 0;
+		c->c_runhist[i] = 0;
+	}
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
+	c->c_handoff = NULL;
 	spinlock_init(&c->c_runqueue_lock);
+	atomic_set(&c->c_load, 0);
+	callout_wheel_init(&c->c_callouts, c->c_hardclocks);
+	workqueue_init(&c->c_workq);
 
 	c->c_ipi_pending = 0;
 	c->c_numshootdown = 0;
@@ -275,7 +408,8 @@ thread_destroy(struct thread *thread)
 	/* Thread subsystem fields */
 	KASSERT(thread->t_proc == NULL);
 	if (thread->t_stack != NULL) {
-		kfree(thread->t_stack);
+		thread_checkstack(thread);
+		thread_stack_put(thread->t_stack);
 	}
 	threadlistnode_cleanup(&thread->t_listnode);
 	thread_machdep_cleanup(&thread->t_machdep);
@@ -331,6 +465,7 @@ thread_panic(void)
 	curcpu->c_runqueue.tl_count = 0;
 	curcpu->c_runqueue.tl_head.tln_next = &curcpu->c_runqueue.tl_tail;
 	curcpu->c_runqueue.tl_tail.tln_prev = &curcpu->c_runqueue.tl_head;
+	atomic_set(&curcpu->c_load, 0);
 
 	/*
 	 * Ideally, we want to make sure sleeping threads don't wake
@@ -371,8 +506,16 @@ thread_shutdown(void)
 void
 thread_bootstrap(void)
 {
+	unsigned i;
+
 	cpuarray_init(&allcpus);
 
+	for (i=0; i<SLEEPQ_HASHSIZE; i++) {
+		spinlock_init(&sleepqs[i].sq_lock);
+		threadlist_init(&sleepqs[i].sq_wchan.wc_threads);
+		sleepqs[i].sq_wchan.wc_name = "sleepq";
+	}
+
 	/*
 	 * Create the cpu structure for the bootup CPU, the one we're
 	 * currently running on. Assume the hardware number is 0; that
@@ -416,6 +559,9 @@ cpu_hatch(unsigned software_number)
 
 	kprintf("cpu%u: %s\n", software_number, buf);
 
+	clocksource_hatch();
+	curcpu->c_acct_stamp = clock_monotonic_ns();
+	workqueue_start();
 	V(cpu_startup_sem);
 	thread_exit();
 }
@@ -442,14 +588,354 @@ thread_start_cpus(void)
 	cpu_startup_sem = NULL;
 }
 
+/*
+ * Print per-cpu scheduler statistics. The counters are updated
+ * without locks by their own cpus, so the numbers may be slightly
+ * stale, but they never go backwards.
+ */
+void
+cpu_printstats(void)
+{
+	unsigned i, numcpus;
+	struct cpu *c;
+
+	kprintf("cpu  load  wakeups   remote   affine  handoff  ticks  skipped\n");
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		kprintf("%3u %5u %8u %8u %8u %8u %6u %8u\n", c->c_number,
+			atomic_read(&c->c_load), c->c_wakeups,
+			c->c_wakeups_remote, c->c_wakeups_affine,
+			c->c_handoffs, c->c_hardclocks, c->c_ticks_skipped);
+	}
+
+	kprintf("cpu   user(ms)    sys(ms)   intr(ms)   idle(ms)"
+		"     work  maxq\n");
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		kprintf("%3u %10u %10u %10u %10u %8u %5u\n", c->c_number,
+			(unsigned)(c->c_cputime[CPUTIME_USER] / 1000000),
+			(unsigned)(c->c_cputime[CPUTIME_SYS] / 1000000),
+			(unsigned)(c->c_cputime[CPUTIME_INTR] / 1000000),
+			(unsigned)(c->c_cputime[CPUTIME_IDLE] / 1000000),
+			c->c_workq.wq_queued, c->c_workq.wq_maxdepth);
+	}
+
+	kprintf("cpu  ipi sent  coalesced   received\n");
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		kprintf("%3u %9u %10u %10u\n", c->c_number,
+			c->c_ipi_sent, c->c_ipi_coalesced, c->c_ipi_received);
+	}
+}
+
+/*
+ * Scheduler latency histograms.
+ *
+ * thread_make_runnable stamps each thread as it's queued, and
+ * thread_switch records, per cpu, how long the incoming thread
+ * waited and how long the outgoing one ran. Both are in log2
+ * microsecond buckets so a single table covers everything from a
+ * handoff to a thread starved for several scheduling periods.
+ */
+static
+unsigned
+thread_latbucket(uint64_t from, uint64_t to)
+{
+	uint64_t us;
+	unsigned b;
+
+	/* A stamp from before calibration may be ahead of us. */
+	us = to > from ? (to - from) / 1000 : 0;
+	for (b = 0; us > 1 && b < SCHED_LATBUCKETS - 1; b++) {
+		us >>= 1;
+	}
+	return b;
+}
+
+/*
+ * Print the histograms, all cpus side by side, then clear them. Like
+ * cpu_printstats this reads other cpus' counters without locks; a
+ * count made while we're clearing may be lost.
+ */
+void
+cpu_printlatency(void)
+{
+	unsigned i, b, numcpus;
+	unsigned waits, runs;
+	struct cpu *c;
+
+	numcpus = cpuarray_num(&allcpus);
+	kprintf("  from(us)");
+	for (i=0; i<numcpus; i++) {
+		kprintf("  wait%-3u   run%-3u", i, i);
+	}
+	kprintf("\n");
+
+	for (b=0; b<SCHED_LATBUCKETS; b++) {
+		waits = runs = 0;
+		for (i=0; i<numcpus; i++) {
+			c = cpuarray_get(&allcpus, i);
+			waits += c->c_waithist[b];
+			runs += c->c_runhist[b];
+		}
+		if (waits == 0 && runs == 0) {
+			continue;
+		}
+		kprintf("%9u%c", b == 0 ? 0 : 1U << b,
+			b == SCHED_LATBUCKETS - 1 ? '+' : ' ');
+		for (i=0; i<numcpus; i++) {
+			c = cpuarray_get(&allcpus, i);
+			kprintf(" %8u %8u", c->c_waithist[b], c->c_runhist[b]);
+		}
+		kprintf("\n");
+	}
+
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		for (b=0; b<SCHED_LATBUCKETS; b++) {
+			c->c_waithist[b] = 0;
+			c->c_runhist[b] = 0;
+		}
+	}
+}
+
+/*
+ * CPU time accounting.
+ *
+ * Each cpu is always in one CPUTIME_* state. On every transition
+ * (trap entry and exit, interrupt entry and exit, context switch)
+ * the time since the last one is added to the cpu's total for the
+ * old state and, unless the cpu was idle, to the current thread's.
+ * Time is read from the cycle counter (clock_monotonic_ns), so this
+ * is cheap enough to do on every trap.
+ *
+ * While switching, from the start of thread_switch until the next
+ * thread is on the cpu, the cpu is in CPUTIME_IDLE and the thread's
+ * own state is kept in t_acct_state. Interrupts taken in the idle
+ * loop are charged to the cpu only, since the thread whose stack
+ * we're on isn't running.
+ */
+unsigned
+thread_cputime(unsigned newstate)
+{
+	struct cpu *c;
+	uint64_t now, delta;
+	unsigned oldstate;
+	int spl;
+
+	KASSERT(newstate < CPUTIME_NSTATES);
+
+	spl = splhigh();
+	c = curcpu->c_self;
+	now = clock_monotonic_ns();
+	/* The stamp may be from before calibration; don't go backwards. */
+	delta = now > c->c_acct_stamp ? now - c->c_acct_stamp : 0;
+	oldstate = c->c_acct_state;
+
+	c->c_cputime[oldstate] += delta;
+	if (oldstate < CPUTIME_NTHREAD && !c->c_isidle) {
+		curthread->t_cputime[oldstate] += delta;
+	}
+
+	c->c_acct_stamp = now;
+	c->c_acct_state = newstate;
+	splx(spl);
+	return oldstate;
+}
+
+/*
+ * The scheduler level a thread goes back to when boosted. This is
+ * the top level unless its process has been niced down with
+ * setpriority(); positive nice values are spread evenly over the
+ * levels. (Negative values are accepted but schedule like 0.)
+ */
+static
+unsigned
+thread_baselevel(struct thread *t)
+{
+	int nice;
+
+	nice = (t->t_proc != NULL) ? t->t_proc->p_nice : 0;
+	if (nice <= 0) {
+		return 0;
+	}
+	return (unsigned)nice * SCHED_NLEVELS / (PRIO_MAX + 1);
+}
+
+/*
+ * Real-time class.
+ *
+ * A real-time thread with budget left sorts ahead of every
+ * time-sharing thread, higher priorities first; one that has used up
+ * its budget for the period sorts by its MLFQ level like anyone
+ * else until the budget is refilled. The refill is done lazily, when
+ * the thread is charged a tick, made runnable, or boosted.
+ */
+static struct spinlock rt_lock = SPINLOCK_INITIALIZER;
+static unsigned rt_util;	/* admitted utilization, tenths of % */
+
+static
+bool
+thread_isrt(const struct thread *t)
+{
+	return t->t_rtprio > 0 && t->t_rtbudget > 0;
+}
+
+/*
+ * Sort key for run queues: lower runs first.
+ */
+static
+int
+thread_runkey(const struct thread *t)
+{
+	if (thread_isrt(t)) {
+		return -(int)t->t_rtprio;
+	}
+	return t->t_level;
+}
+
+static
+void
+thread_rt_refill(struct thread *t)
+{
+	uint64_t now, period;
+
+	if (t->t_rtprio == 0) {
+		return;
+	}
+	now = clock_monotonic_ns();
+	if (now < t->t_rtrenew) {
+		return;
+	}
+	period = (uint64_t)t->t_rtperiod * (1000000000 / HZ);
+	t->t_rtbudget = t->t_rtruntime;
+	t->t_rtrenew += period;
+	if (t->t_rtrenew <= now) {
+		/* Slept through whole periods; start afresh. */
+		t->t_rtrenew = now + period;
+	}
+}
+
+/*
+ * Utilization of a runtime/period pair, rounded up.
+ */
+static
+unsigned
+thread_rt_util(unsigned runtime, unsigned period)
+{
+	return period == 0 ? 0 : DIVROUNDUP(runtime * 1000, period);
+}
+
+/*
+ * Put a thread on a cpu's run queue. The run queue is kept sorted by
+ * thread_runkey (real-time priority, then scheduler level), so the
+ * head is always the best thread to run; within a key it is FIFO,
+ * which gives round-robin. We search from the tail because newly
+ * runnable threads usually belong at or near the end.
+ *
+ * The caller must hold the run queue lock.
+ */
+static
+void
+thread_runqueue_insert(struct cpu *c, struct thread *t)
+{
+	struct thread *prev;
+
+	KASSERT(spinlock_do_i_hold(&c->c_runqueue_lock));
+
+	THREADLIST_FORALL_REV(prev, c->c_runqueue) {
+		if (thread_runkey(prev) <= thread_runkey(t)) {
+			threadlist_insertafter(&c->c_runqueue, prev, t);
+			goto done;
+		}
+	}
+	threadlist_addhead(&c->c_runqueue, t);
+ done:
+	atomic_set(&c->c_load, c->c_runqueue.tl_count);
+}
+
+/*
+ * Check if thread T may run on cpu C according to its affinity mask.
+ */
+static
+bool
+thread_cpu_allowed(struct thread *t, struct cpu *c)
+{
+	return (t->t_affinity & CPUMASK_BIT(c->c_number)) != 0;
+}
+
+/*
+ * Choose a cpu for thread T that its affinity mask allows, when the
+ * one it was on isn't. Takes the least loaded one by the c_load
+ * hints. thread_setaffinity doesn't allow masks with no existing
+ * cpus in them, so there is always an answer.
+ */
+static
+struct cpu *
+thread_pickcpu(struct thread *t)
+{
+	unsigned i, numcpus, load, bestload;
+	struct cpu *c, *best;
+
+	best = NULL;
+	bestload = 0;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (!thread_cpu_allowed(t, c)) {
+			continue;
+		}
+		load = atomic_read(&c->c_load);
+		if (best == NULL || load < bestload) {
+			best = c;
+			bestload = load;
+		}
+	}
+	KASSERT(best != NULL);
+	return best;
+}
+
+/*
+ * Send IPI_UNIDLE to some idle cpu that thread T may run on, so it
+ * comes out of cpu_idle and looks for work to steal. Idle cpus have
+ * their clock stopped and would otherwise sleep through it.
+ *
+ * This peeks at c_isidle without the other cpus' run queue locks
+ * (we may be holding one already); if we get it wrong, the worst
+ * that happens is a wasted IPI or a missed steal.
+ */
+static
+void
+thread_kick_idle(struct thread *t)
+{
+	unsigned i, numcpus;
+	struct cpu *c;
+
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self && c->c_isidle &&
+		    thread_cpu_allowed(t, c)) {
+			ipi_send(c, IPI_UNIDLE);
+			return;
+		}
+	}
+}
+
 /*
  * Make a thread runnable.
  *
  * targetcpu might be curcpu; it might not be, too.
+ *
+ * WAKEUP is true for a thread that is newly runnable (woken up, or
+ * just forked), as opposed to one being put back on the queue by
+ * thread_switch or moved by thread_migrate_pending.
  */
 static
 void
-thread_make_runnable(struct thread *target, bool already_have_lock)
+thread_make_runnable(struct thread *target, bool already_have_lock,
+		     bool wakeup)
 {
 	struct cpu *targetcpu;
 
@@ -466,7 +952,26 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 
 	/* Target thread is now ready to run; put it on the run queue. */
 	target->t_state = S_READY;
-	threadlist_addtail(&targetcpu->c_runqueue, target);
+	target->t_readystamp = clock_monotonic_ns();
+	thread_rt_refill(target);
+	thread_runqueue_insert(targetcpu, target);
+
+	/*
+	 * A real-time thread shouldn't wait for the next tick to
+	 * preempt a lesser thread. If that's us, thread_resched will
+	 * yield on the way out of this trap; otherwise poke the cpu,
+	 * whose interrupt return will do the same. (The peek at what
+	 * it's running can be stale, which costs at most a tick.)
+	 */
+	if (thread_isrt(target) && !targetcpu->c_isidle &&
+	    thread_runkey(target) < thread_runkey(targetcpu->c_curthread)) {
+		if (targetcpu == curcpu->c_self) {
+			targetcpu->c_resched = true;
+		}
+		else {
+			ipi_send(targetcpu, IPI_RESCHED);
+		}
+	}
 
 	if (targetcpu->c_isidle && targetcpu != curcpu->c_self) {
 		/*
@@ -475,6 +980,16 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 		 */
 		ipi_send(targetcpu, IPI_UNIDLE);
 	}
+	else if (wakeup && !targetcpu->c_isidle &&
+		 targetcpu->c_runqueue.tl_count > 1) {
+		/*
+		 * New work is queueing up behind a busy cpu. Wake
+		 * up an idle cpu, if any, so it can steal some. Not
+		 * for a thread that is only being requeued, which
+		 * would otherwise bounce between cpus on every yield.
+		 */
+		thread_kick_idle(target);
+	}
 
 	if (!already_have_lock) {
 		spinlock_release(&targetcpu->c_runqueue_lock);
@@ -482,45 +997,187 @@ thread_make_runnable(struct thread *target, bool already_have_lock)
 }
 
 /*
- * Create a new thread based on an existing one.
+ * Wake up a thread that was taken off a wait channel: choose a cpu
+ * for it and make it runnable there.
  *
- * The new thread has name NAME, and starts executing in function
- * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
+ * Ordinarily a thread goes back to the cpu it last ran on, whose
+ * cache may still hold its working set. But if the same thread woke
+ * it last time as well, the two are probably a producer/consumer
+ * pair handing data back and forth, and it's better to run it on
+ * the waker's cpu where that data just was. Either way the choice
+ * has to be one its affinity mask allows.
  *
- * The new thread is created in the process P. If P is null, the
- * process is inherited from the caller. It will start on the same CPU
- * as the caller, unless the scheduler intervenes first.
+ * If the old cpu is idling on the thread's own stack (see
+ * thread_switch), it can't go anywhere else, whatever we'd like.
  */
-int
-thread_fork(const char *name,
-	    struct proc *proc,
-	    void (*entrypoint)(void *data1, unsigned long data2),
-	    void *data1, unsigned long data2)
+static
+void
+thread_wakeup(struct thread *target)
 {
-	struct thread *newthread;
-	int result;
+	struct cpu *last, *c;
+	bool paired, pinned;
 
-	newthread = thread_create(name);
-	if (newthread == NULL) {
-		return ENOMEM;
+	last = target->t_cpu;
+	paired = (target->t_lastwaker == curthread);
+	target->t_lastwaker = curthread;
+
+	if (paired && thread_cpu_allowed(target, curcpu->c_self)) {
+		c = curcpu->c_self;
+	}
+	else if (thread_cpu_allowed(target, last)) {
+		c = last;
+	}
+	else {
+		c = thread_pickcpu(target);
 	}
 
-	/* Allocate a stack */
-	newthread->t_stack = kmalloc(STACK_SIZE);
-	if (newthread->t_stack == NULL) {
-		thread_destroy(newthread);
-		return ENOMEM;
+	if (c != last) {
+		spinlock_acquire(&last->c_runqueue_lock);
+		pinned = (last->c_curthread == target);
+		spinlock_release(&last->c_runqueue_lock);
+		if (pinned) {
+			c = last;
+		}
+		else {
+			target->t_cpu = c;
+			if (c == curcpu->c_self) {
+				curcpu->c_wakeups_affine++;
+			}
+		}
 	}
-	thread_checkstack_init(newthread);
 
-	/*
-	 * Now we clone various fields from the parent thread.
-	 */
+	curcpu->c_wakeups++;
+	if (c != curcpu->c_self) {
+		curcpu->c_wakeups_remote++;
+	}
 
-	/* Thread subsystem fields */
-	newthread->t_cpu = curthread->t_cpu;
+	thread_make_runnable(target, false, true);
+}
 
-	/* Attach the new thread to its process */
+/*
+ * Wake up a thread by handing it this cpu: make it the thread the
+ * next thread_switch here runs, without putting it on the run queue.
+ * For wakers that are about to block, so the switch comes at once.
+ *
+ * Returns false, doing nothing, if that's not possible: from an
+ * interrupt handler (which isn't going to block), if the thread may
+ * not run here or is stuck on its old cpu (see thread_wakeup), or if
+ * there's already a handoff pending here.
+ *
+ * The caller holds a wchan lock, so we can't migrate meanwhile.
+ */
+static
+bool
+thread_handoff(struct thread *target)
+{
+	struct cpu *c, *last;
+	bool pinned;
+
+	c = curcpu->c_self;
+	last = target->t_cpu;
+
+	if (curthread->t_in_interrupt || !thread_cpu_allowed(target, c)) {
+		return false;
+	}
+	if (last != c) {
+		spinlock_acquire(&last->c_runqueue_lock);
+		pinned = (last->c_curthread == target);
+		spinlock_release(&last->c_runqueue_lock);
+		if (pinned) {
+			return false;
+		}
+	}
+
+	spinlock_acquire(&c->c_runqueue_lock);
+	if (c->c_handoff != NULL) {
+		spinlock_release(&c->c_runqueue_lock);
+		return false;
+	}
+	target->t_cpu = c;
+	target->t_lastwaker = curthread;
+	target->t_state = S_READY;
+	target->t_readystamp = clock_monotonic_ns();
+	c->c_handoff = target;
+	spinlock_release(&c->c_runqueue_lock);
+
+	c->c_wakeups++;
+	c->c_handoffs++;
+	return true;
+}
+
+/*
+ * A handoff this cpu's current thread set up but didn't follow by
+ * blocking: put the thread on the run queue after all. Called each
+ * hardclock, so a handoff is never held up longer than a tick.
+ */
+static
+void
+thread_handoff_expire(void)
+{
+	struct cpu *c = curcpu->c_self;
+
+	/* Only this cpu sets c_handoff, so a quick look is safe. */
+	if (c->c_handoff == NULL) {
+		return;
+	}
+
+	spinlock_acquire(&c->c_runqueue_lock);
+	if (c->c_handoff != NULL) {
+		thread_runqueue_insert(c, c->c_handoff);
+		c->c_handoff = NULL;
+	}
+	spinlock_release(&c->c_runqueue_lock);
+}
+
+/*
+ * Create a new thread based on an existing one.
+ *
+ * The new thread has name NAME, and starts executing in function
+ * ENTRYPOINT. DATA1 and DATA2 are passed to ENTRYPOINT.
+ *
+ * The new thread is created in the process P. If P is null, the
+ * process is inherited from the caller. It will start on the same CPU
+ * as the caller, unless the scheduler intervenes first.
+ */
+int
+thread_fork(const char *name,
+	    struct proc *proc,
+	    void (*entrypoint)(void *data1, unsigned long data2),
+	    void *data1, unsigned long data2)
+{
+	struct thread *newthread;
+	int result;
+	int spl;
+
+	/* Bury our dead first, so their stacks can be reused. */
+	spl = splhigh();
+	exorcise();
+	splx(spl);
+
+	newthread = thread_create(name);
+	if (newthread == NULL) {
+		return ENOMEM;
+	}
+
+	/* Allocate a stack */
+	thread_stack_get(newthread);
+	if (newthread->t_stack == NULL) {
+		thread_destroy(newthread);
+		return ENOMEM;
+	}
+
+	/*
+	 * Now we clone various fields from the parent thread.
+	 */
+
+	/* Thread subsystem fields */
+	newthread->t_cpu = curthread->t_cpu;
+	newthread->t_affinity = curthread->t_affinity;
+	if (!thread_cpu_allowed(newthread, newthread->t_cpu)) {
+		newthread->t_cpu = thread_pickcpu(newthread);
+	}
+
+	/* Attach the new thread to its process */
 	if (proc == NULL) {
 		proc = curthread->t_proc;
 	}
@@ -531,6 +1188,10 @@ thread_fork(const char *name,
 		return result;
 	}
 
+	/* Start at the top of the process's range with a full slice */
+	newthread->t_level = thread_baselevel(newthread);
+	newthread->t_slice = SCHED_SLICE(newthread->t_level);
+
 	/*
 	 * Because new threads come out holding the cpu runqueue lock
 	 * (see notes at bottom of thread_switch), we need to account
@@ -542,11 +1203,132 @@ thread_fork(const char *name,
 	switchframe_init(newthread, entrypoint, data1, data2);
 
 	/* Lock the current cpu's run queue and make the new thread runnable */
-	thread_make_runnable(newthread, false);
+	thread_make_runnable(newthread, false, true);
 
 	return 0;
 }
 
+/*
+ * Work stealing.
+ *
+ * Called by an idle cpu from the idle loop in thread_switch() before
+ * it goes to sleep in cpu_idle(). Picks the cpu with the most ready
+ * threads, using the lock-free c_load hints so that looking costs
+ * nothing, and pulls one thread off the tail of its run queue onto
+ * our own. The tail is where the lowest-priority, most recently
+ * queued threads are, which are the ones the victim would get to
+ * last anyway.
+ *
+ * Returns true if a thread was moved to our run queue. Must be called
+ * with interrupts off and without holding our own run queue lock.
+ *
+ * Migrating threads isn't free because of cache affinity; but
+ * System/161 does not (yet) model such cache effects, and an idle
+ * cpu is the one case where moving work is always worth it.
+ */
+static
+bool
+thread_steal(void)
+{
+	unsigned i, numcpus, load, bestload;
+	struct cpu *c, *victim;
+	struct thread *t;
+
+	KASSERT(curthread->t_curspl > 0);
+
+	victim = NULL;
+	bestload = 0;
+	numcpus = cpuarray_num(&allcpus);
+	for (i=0; i<numcpus; i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c == curcpu->c_self) {
+			continue;
+		}
+		load = atomic_read(&c->c_load);
+		if (load > bestload) {
+			bestload = load;
+			victim = c;
+		}
+	}
+	if (victim == NULL) {
+		return false;
+	}
+
+	spinlock_acquire(&victim->c_runqueue_lock);
+	/*
+	 * Recheck under the lock: the hint may be stale. If the victim
+	 * is idle it is about to run its one ready thread itself, so
+	 * only take one if there's more than that.
+	 */
+	if (victim->c_runqueue.tl_count <= (victim->c_isidle ? 1U : 0U)) {
+		spinlock_release(&victim->c_runqueue_lock);
+		return false;
+	}
+	/*
+	 * Ordinarily, the victim's curthread will not appear on its
+	 * run queue. However, it can if it went to sleep, the victim
+	 * became idle (so it remained curthread), and it was then
+	 * reawakened before the victim fully unidled. The victim is
+	 * still running on that thread's stack, so taking it would be
+	 * very bad; pick the last thread that isn't it and that is
+	 * allowed to run here.
+	 */
+	THREADLIST_FORALL_REV(t, victim->c_runqueue) {
+		if (t != victim->c_curthread &&
+		    thread_cpu_allowed(t, curcpu->c_self)) {
+			break;
+		}
+	}
+	if (t == NULL) {
+		spinlock_release(&victim->c_runqueue_lock);
+		return false;
+	}
+	threadlist_remove(&victim->c_runqueue, t);
+	atomic_set(&victim->c_load, victim->c_runqueue.tl_count);
+	spinlock_release(&victim->c_runqueue_lock);
+
+	DEBUG(DB_THREADS, "Stole thread %s: cpu %u -> %u",
+	      t->t_name, victim->c_number, curcpu->c_number);
+
+	spinlock_acquire(&curcpu->c_runqueue_lock);
+	t->t_cpu = curcpu->c_self;
+	thread_runqueue_insert(curcpu, t);
+	spinlock_release(&curcpu->c_runqueue_lock);
+
+	return true;
+}
+
+/*
+ * Send off the thread, if any, that thread_switch left behind in
+ * c_migrating because it isn't allowed to run on this cpu any more.
+ * This has to wait until we've switched away from it and dropped our
+ * run queue lock: until then we're still on its stack, and we can't
+ * hold two run queue locks at once.
+ *
+ * Like exorcise(), this is called both at the end of thread_switch
+ * and from thread_startup.
+ */
+static
+void
+thread_migrate_pending(void)
+{
+	struct thread *t;
+	struct cpu *c;
+
+	t = curcpu->c_migrating;
+	if (t == NULL) {
+		return;
+	}
+	curcpu->c_migrating = NULL;
+	KASSERT(t != curthread);
+
+	c = thread_pickcpu(t);
+	spinlock_acquire(&c->c_runqueue_lock);
+	t->t_cpu = c;
+	thread_make_runnable(t, true /*have lock*/, false);
+	spinlock_release(&c->c_runqueue_lock);
+}
+
 /*
  * High level, machine-independent context switch code.
  *
@@ -588,21 +1370,53 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	spinlock_acquire(&curcpu->c_runqueue_lock);
 
 	/* Micro-optimization: if nothing to do, just return */
-	if (newstate == S_READY && threadlist_isempty(&curcpu->c_runqueue)) {
+	if (newstate == S_READY && threadlist_isempty(&curcpu->c_runqueue) &&
+	    curcpu->c_handoff == NULL) {
 		spinlock_release(&curcpu->c_runqueue_lock);
 		splx(spl);
 		return;
 	}
 
+	/*
+	 * Stop charging this thread. A yield from an interrupt handler
+	 * is hardclock preempting us; anything else we asked for.
+	 */
+	cur->t_acct_state = thread_cputime(CPUTIME_IDLE);
+	if (cur->t_runstamp != 0) {
+		curcpu->c_runhist[thread_latbucket(cur->t_runstamp,
+						   clock_monotonic_ns())]++;
+	}
+	if (newstate == S_READY && cur->t_in_interrupt) {
+		cur->t_nivcsw++;
+	}
+	else if (newstate != S_ZOMBIE) {
+		cur->t_nvcsw++;
+	}
+
 	/* Put the thread in the right place. */
 	switch (newstate) {
 	    case S_RUN:
 		panic("Illegal S_RUN in thread_switch\n");
 	    case S_READY:
-		thread_make_runnable(cur, true /*have lock*/);
+		if (!thread_cpu_allowed(cur, curcpu->c_self)) {
+			/*
+			 * Our affinity mask changed. We're still on
+			 * cur's stack, so it can't go to another cpu
+			 * yet; thread_migrate_pending sends it once
+			 * we've switched away. (There's something else
+			 * to run, per the check above, so we will.)
+			 */
+			KASSERT(curcpu->c_migrating == NULL);
+			curcpu->c_migrating = cur;
+			break;
+		}
+		thread_make_runnable(cur, true /*have lock*/, false);
 		break;
 	    case S_SLEEP:
-		cur->t_wchan_name = wc->wc_name;
+		if (cur->t_sleepkey == NULL) {
+			/* (sleepq_sleep sets a better name itself) */
+			cur->t_wchan_name = wc->wc_name;
+		}
 		/*
 		 * Add the thread to the list in the wait channel, and
 		 * unlock same. To avoid a race with someone else
@@ -612,6 +1426,7 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		 * on the list.
 		 */
 		threadlist_addtail(&wc->wc_threads, cur);
+		cur->t_wchan = wc;
 		spinlock_release(lk);
 		break;
 	    case S_ZOMBIE:
@@ -636,19 +1451,44 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	 * Note that c_isidle becomes true briefly even if we don't go
 	 * idle. However, because one is supposed to hold the runqueue
 	 * lock to look at it, this should not be visible or matter.
+	 *
+	 * Before idling, try to steal a thread from a busier cpu. We
+	 * must not hold our own runqueue lock while doing so, or two
+	 * cpus stealing from each other could deadlock.
+	 *
+	 * While idle, the clock is stopped (see hardclock_idle), so
+	 * we don't come back around to steal again on every tick;
+	 * instead thread_make_runnable wakes an idle cpu when a
+	 * wakeup queues work behind a busy one.
 	 */
 
 	/* The current cpu is now idle. */
 	curcpu->c_isidle = true;
-	do {
+
+	/* A thread handed this cpu by wchan_wakeone_sync goes first. */
+	next = curcpu->c_handoff;
+	curcpu->c_handoff = NULL;
+
+	while (next == NULL) {
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
-			cpu_idle();
+			if (!thread_steal()) {
+				hardclock_idle();
+				cpu_idle();
+				hardclock_unidle();
+			}
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
-	} while (next == NULL);
+	}
+	atomic_set(&curcpu->c_load, curcpu->c_runqueue.tl_count);
 	curcpu->c_isidle = false;
+	curcpu->c_resched = false;
+
+	/* Record how long the next thread sat ready. */
+	next->t_runstamp = clock_monotonic_ns();
+	curcpu->c_waithist[thread_latbucket(next->t_readystamp,
+					    next->t_runstamp)]++;
 
 	/*
 	 * Note that curcpu->c_curthread may be the same variable as
@@ -714,14 +1554,22 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Start charging this thread again. */
+	thread_cputime(cur->t_acct_state);
+
 	/* Unlock the run queue. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
+	/* Send off a thread that can't run here any more. */
+	thread_migrate_pending();
+
 	/* Activate our address space in the MMU. */
 	as_activate();
 
-	/* Clean up dead threads. */
-	exorcise();
+	/* Clean up dead threads, a batch at a time. */
+	if (curcpu->c_zombies.tl_count >= ZOMBIE_BATCH) {
+		exorcise();
+	}
 
 	/* Turn interrupts back on. */
 	splx(spl);
@@ -747,14 +1595,22 @@ thread_startup(void (*entrypoint)(void *data1, unsigned long data2),
 	cur->t_wchan_name = NULL;
 	cur->t_state = S_RUN;
 
+	/* Start charging this thread. */
+	thread_cputime(cur->t_acct_state);
+
 	/* Release the runqueue lock acquired in thread_switch. */
 	spinlock_release(&curcpu->c_runqueue_lock);
 
+	/* Send off a thread that can't run here any more. */
+	thread_migrate_pending();
+
 	/* Activate our address space in the MMU. */
 	as_activate();
 
-	/* Clean up dead threads. */
-	exorcise();
+	/* Clean up dead threads, a batch at a time. */
+	if (curcpu->c_zombies.tl_count >= ZOMBIE_BATCH) {
+		exorcise();
+	}
 
 	/* Enable interrupts. */
 	spl0();
@@ -788,6 +1644,9 @@ thread_exit(void)
 	 */
 	proc_remthread(cur);
 
+	/* Give back any real-time utilization we were admitted with. */
+	thread_setrt(0, 0, 0);
+
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
 
@@ -816,137 +1675,243 @@ thread_yield(void)
  *
  * This is called periodically from hardclock(). It should reshuffle
  * the current CPU's run queue by job priority.
+ *
+ * The run queue is always kept in priority order (see
+ * thread_runqueue_insert), so all that's left to do here is the
+ * periodic priority boost: every SCHED_BOOST_HARDCLOCKS, put every
+ * thread on this CPU back at its base level with a fresh slice. This
+ * keeps CPU hogs from starving each other forever at the bottom
+ * level, and lets a job that turned interactive climb back up.
+ *
+ * Sleeping threads are not boosted; they keep their level until they
+ * wake up and are caught by a later boost.
  */
-
 void
 schedule(void)
 {
+	struct threadlist boosted;
+	struct thread *t;
+
 	/*
-	 * You can write this. If we do nothing, threads will run in
-	 * round-robin fashion.
+	 * Compare against the last boost rather than testing for a
+	 * multiple: coming out of tickless idle, c_hardclocks jumps
+	 * over the ticks that were skipped.
 	 */
+	if (curcpu->c_hardclocks - curcpu->c_lastboost <
+	    SCHED_BOOST_HARDCLOCKS) {
+		return;
+	}
+	curcpu->c_lastboost = curcpu->c_hardclocks;
+
+	threadlist_init(&boosted);
+
+	spinlock_acquire(&curcpu->c_runqueue_lock);
+	if (!curcpu->c_isidle) {
+		t = curthread;
+		t->t_level = thread_baselevel(t);
+		t->t_slice = SCHED_SLICE(t->t_level);
+	}
+	while ((t = threadlist_remhead(&curcpu->c_runqueue)) != NULL) {
+		t->t_level = thread_baselevel(t);
+		t->t_slice = SCHED_SLICE(t->t_level);
+		thread_rt_refill(t);
+		threadlist_addtail(&boosted, t);
+	}
+	while ((t = threadlist_remhead(&boosted)) != NULL) {
+		thread_runqueue_insert(curcpu, t);
+	}
+	spinlock_release(&curcpu->c_runqueue_lock);
+
+	threadlist_cleanup(&boosted);
 }
 
 /*
- * Thread migration.
+ * Time slicing.
  *
- * This is also called periodically from hardclock(). If the current
- * CPU is busy and other CPUs are idle, or less busy, it should move
- * threads across to those other other CPUs.
+ * This is called from hardclock() on every tick. Charge the tick to
+ * the current thread; if that uses up its slice, drop it one level
+ * and ask for a yield, which puts it at the back of its new level.
+ * Also ask for a yield if a thread at a better level is waiting, so
+ * that a wakeup doesn't wait behind a long bottom-level slice.
  *
- * Migrating threads isn't free because of cache affinity; a thread's
- * working cache set will end up having to be moved to the other CPU,
- * which is fairly slow. The tradeoff between this performance loss
- * and the performance loss due to underutilization of some CPUs is
- * something that needs to be tuned and probably is workload-specific.
- *
- * For here and now, because we know we're running on System/161 and
- * System/161 does not (yet) model such cache effects, we'll be very
- * aggressive.
+ * A thread that blocks keeps what's left of its slice, so sleeping
+ * doesn't reset the count; otherwise a thread could stay at the top
+ * just by sleeping briefly before each slice ran out.
+ */
+bool
+schedule_tick(void)
+{
+	struct thread *cur, *next;
+	bool preempt;
+
+	if (curcpu->c_isidle) {
+		/* Nothing to charge; thread_switch will notice anyway. */
+		return false;
+	}
+
+	/* Don't let a handoff wait on a waker that didn't block. */
+	thread_handoff_expire();
+
+	cur = curthread;
+
+	/*
+	 * Real-time threads are charged against their budget; when it
+	 * runs out they yield and queue as time-sharing threads until
+	 * it's refilled. They don't move between MLFQ levels, and
+	 * round-robin within a priority one tick at a time.
+	 */
+	thread_rt_refill(cur);
+	if (thread_isrt(cur)) {
+		cur->t_rtbudget--;
+		if (cur->t_rtbudget == 0) {
+			return true;
+		}
+		KASSERT(cur->t_slice > 0);
+		cur->t_slice--;
+		if (cur->t_slice == 0) {
+			cur->t_slice = SCHED_SLICE(0);
+			return true;
+		}
+	}
+	else {
+		KASSERT(cur->t_slice > 0);
+		cur->t_slice--;
+		if (cur->t_slice == 0) {
+			if (cur->t_level < SCHED_NLEVELS - 1) {
+				cur->t_level++;
+			}
+			cur->t_slice = SCHED_SLICE(cur->t_level);
+			return true;
+		}
+	}
+
+	spinlock_acquire(&curcpu->c_runqueue_lock);
+	next = threadlist_isempty(&curcpu->c_runqueue) ? NULL :
+		curcpu->c_runqueue.tl_head.tln_next->tln_self;
+	preempt = next != NULL && thread_runkey(next) < thread_runkey(cur);
+	spinlock_release(&curcpu->c_runqueue_lock);
+
+	return preempt;
+}
+
+/*
+ * The current process's nice value changed; move the current thread
+ * to its new base level right away instead of waiting for a boost.
  */
 void
-thread_consider_migration(void)
+thread_renice(void)
+{
+	int spl;
+
+	spl = splhigh();
+	curthread->t_level = thread_baselevel(curthread);
+	curthread->t_slice = SCHED_SLICE(curthread->t_level);
+	splx(spl);
+}
+
+/*
+ * Set the current thread's affinity mask. Bits for cpus that don't
+ * exist are dropped, so a mask of CPUMASK_ALL always means "any".
+ *
+ * If we're on a cpu the new mask excludes, yield: thread_switch will
+ * then send us to one it allows. If this cpu has nothing else to run
+ * thread_switch returns right away and we stay for now; we'll move
+ * the next time we yield with other work queued, or when we're next
+ * woken up from a sleep.
+ */
+int
+thread_setaffinity(uint32_t mask)
 {
-	unsigned my_count, total_count, one_share, to_send;
 	unsigned i, numcpus;
-	struct cpu *c;
-	struct threadlist victims;
-	struct thread *t;
+	uint32_t exists;
+	int spl;
 
-	my_count = total_count = 0;
+	exists = 0;
 	numcpus = cpuarray_num(&allcpus);
 	for (i=0; i<numcpus; i++) {
-		c = cpuarray_get(&allcpus, i);
-		spinlock_acquire(&c->c_runqueue_lock);
-		total_count += c->c_runqueue.tl_count;
-		if (c == curcpu->c_self) {
-			my_count = c->c_runqueue.tl_count;
-		}
-		spinlock_release(&c->c_runqueue_lock);
+		exists |= CPUMASK_BIT(cpuarray_get(&allcpus, i)->c_number);
 	}
-
-	one_share = DIVROUNDUP(total_count, numcpus);
-	if (my_count < one_share) {
-		return;
+	mask &= exists;
+	if (mask == 0) {
+		return EINVAL;
 	}
 
-	to_send = my_count - one_share;
-	threadlist_init(&victims);
-	spinlock_acquire(&curcpu->c_runqueue_lock);
-	for (i=0; i<to_send; i++) {
-		t = threadlist_remtail(&curcpu->c_runqueue);
-		threadlist_addhead(&victims, t);
+	spl = splhigh();
+	curthread->t_affinity = mask;
+	splx(spl);
+
+	if (!thread_cpu_allowed(curthread, curcpu->c_self)) {
+		thread_yield();
 	}
-	spinlock_release(&curcpu->c_runqueue_lock);
+	return 0;
+}
 
-	for (i=0; i < numcpus && to_send > 0; i++) {
-		c = cpuarray_get(&allcpus, i);
-		if (c == curcpu->c_self) {
-			continue;
-		}
-		spinlock_acquire(&c->c_runqueue_lock);
-		while (c->c_runqueue.tl_count < one_share && to_send > 0) {
-			t = threadlist_remhead(&victims);
-			/*
-			 * Ordinarily, curthread will not appear on
-			 * the run queue. However, it can under the
-			 * following circumstances:
-			 *   - it went to sleep;
-			 *   - the processor became idle, so it
-			 *     remained curthread;
-			 *   - it was reawakened, so it was put on the
-			 *     run queue;
-			 *   - and the processor hasn't fully unidled
-			 *     yet, so all these things are still true.
-			 *
-			 * If the timer interrupt happens at (almost)
-			 * exactly the proper moment, we can come here
-			 * while things are in this state and see
-			 * curthread. However, *migrating* curthread
-			 * can cause bad things to happen (Exercise:
-			 * Why? And what?) so shuffle it to the end of
-			 * the list and decrement to_send in order to
-			 * skip it. Then it goes back on our own run
-			 * queue below.
-			 */
-			if (t == curthread) {
-				threadlist_addtail(&victims, t);
-				to_send--;
-				continue;
-			}
+/*
+ * Enter or leave the real-time class. See thread.h.
+ */
+int
+thread_setrt(unsigned prio, unsigned runtime, unsigned period)
+{
+	struct thread *cur = curthread;
+	unsigned util, oldutil, limit;
+	int spl;
 
-			t->t_cpu = c;
-			threadlist_addtail(&c->c_runqueue, t);
-			DEBUG(DB_THREADS,
-			      "Migrated thread %s: cpu %u -> %u",
-			      t->t_name, curcpu->c_number, c->c_number);
-			to_send--;
-			if (c->c_isidle) {
-				/*
-				 * Other processor is idle; send
-				 * interrupt to make sure it unidles.
-				 */
-				ipi_send(c, IPI_UNIDLE);
-			}
+	if (prio == 0) {
+		if (cur->t_rtprio == 0) {
+			return 0;
 		}
-		spinlock_release(&c->c_runqueue_lock);
+		runtime = period = 0;
+	}
+	else if (prio < SCHED_RT_MINPRIO || prio > SCHED_RT_MAXPRIO ||
+		 runtime == 0 || period < runtime) {
+		return EINVAL;
 	}
 
-	/*
-	 * Because the code above isn't atomic, the thread counts may have
-	 * changed while we were working and we may end up with leftovers.
-	 * Don't panic; just put them back on our own run queue.
-	 */
-	if (!threadlist_isempty(&victims)) {
-		spinlock_acquire(&curcpu->c_runqueue_lock);
-		while ((t = threadlist_remhead(&victims)) != NULL) {
-			threadlist_addtail(&curcpu->c_runqueue, t);
-		}
-		spinlock_release(&curcpu->c_runqueue_lock);
+	util = thread_rt_util(runtime, period);
+	oldutil = thread_rt_util(cur->t_rtruntime, cur->t_rtperiod);
+	limit = SCHED_RT_UTIL * cpuarray_num(&allcpus);
+
+	/* A thread runs on one cpu at a time, so it gets one cpu's share. */
+	if (util > SCHED_RT_UTIL) {
+		return EBUSY;
 	}
 
-	KASSERT(threadlist_isempty(&victims));
-	threadlist_cleanup(&victims);
+	spinlock_acquire(&rt_lock);
+	if (rt_util - oldutil + util > limit) {
+		spinlock_release(&rt_lock);
+		return EBUSY;
+	}
+	rt_util = rt_util - oldutil + util;
+	spinlock_release(&rt_lock);
+
+	/* schedule_tick looks at these from the timer interrupt. */
+	spl = splhigh();
+	cur->t_rtprio = prio;
+	cur->t_rtruntime = runtime;
+	cur->t_rtperiod = period;
+	cur->t_rtbudget = runtime;
+	cur->t_rtrenew = prio == 0 ? 0 :
+		clock_monotonic_ns() + (uint64_t)period * (1000000000 / HZ);
+	cur->t_slice = SCHED_SLICE(prio == 0 ? cur->t_level : 0);
+	splx(spl);
+
+	return 0;
+}
+
+void
+thread_resched(void)
+{
+	bool resched;
+	int spl;
+
+	spl = splhigh();
+	resched = curcpu->c_resched;
+	curcpu->c_resched = false;
+	splx(spl);
+
+	if (resched) {
+		thread_yield();
+	}
 }
 
 ////////////////////////////////////////////////////////////
@@ -1012,6 +1977,80 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 	spinlock_acquire(lk);
 }
 
+/*
+ * State for wchan_sleep_timeout, shared with its callout.
+ */
+struct wchan_timeout {
+	struct thread *wt_thread;
+	struct wchan *wt_wchan;
+	struct spinlock *wt_lock;
+	bool wt_expired;		/* protected by wt_lock */
+};
+
+/*
+ * Callout function for wchan_sleep_timeout. If the thread is still
+ * asleep on the channel, nobody woke it in time: take it off and
+ * wake it ourselves.
+ *
+ * The thread can't have gone back to sleep on the channel in the
+ * meantime, because it doesn't leave wchan_sleep_timeout until its
+ * callout is cancelled or has finished running.
+ */
+static
+void
+wchan_timeout_expire(void *data)
+{
+	struct wchan_timeout *wt = data;
+	struct thread *t = wt->wt_thread;
+
+	spinlock_acquire(wt->wt_lock);
+	if (t->t_wchan == wt->wt_wchan) {
+		threadlist_remove(&wt->wt_wchan->wc_threads, t);
+		t->t_wchan = NULL;
+		wt->wt_expired = true;
+		thread_wakeup(t);
+	}
+	spinlock_release(wt->wt_lock);
+}
+
+/*
+ * Go to sleep on a wait channel for at most TICKS hardclocks.
+ */
+int
+wchan_sleep_timeout(struct wchan *wc, struct spinlock *lk, unsigned ticks)
+{
+	struct wchan_timeout wt;
+	struct callout co;
+
+	/* may not sleep in an interrupt handler */
+	KASSERT(!curthread->t_in_interrupt);
+
+	/* must hold the spinlock */
+	KASSERT(spinlock_do_i_hold(lk));
+
+	/* must not hold other spinlocks */
+	KASSERT(curcpu->c_spinlocks == 1);
+
+	wt.wt_thread = curthread;
+	wt.wt_wchan = wc;
+	wt.wt_lock = lk;
+	wt.wt_expired = false;
+	callout_init(&co, wchan_timeout_expire, &wt);
+
+	/*
+	 * The callout can't run before we're on the channel: it needs
+	 * LK, which we hold until thread_switch has put us there.
+	 * Afterwards, cancel it before taking LK back, since it may
+	 * be running on another cpu and waiting for LK itself.
+	 */
+	callout_schedule(&co, ticks);
+	thread_switch(S_SLEEP, wc, lk);
+	callout_cancel(&co);
+	spinlock_acquire(lk);
+
+	return wt.wt_expired ? ETIMEDOUT : 0;
+}
+
 /*
  * Wake up one thread sleeping on a wait channel.
  */
@@ -1029,6 +2068,7 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 		/* Nobody was sleeping. */
 		return;
 	}
+	target->t_wchan = NULL;
 
 	/*
 	 * Note that thread_make_runnable acquires a runqueue lock
@@ -1038,7 +2078,28 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 	 * in thread_switch.
 	 */
 
-	thread_make_runnable(target, false);
+	thread_wakeup(target);
+}
+
+/*
+ * Wake up one thread, handing it this cpu if we can.
+ */
+void
+wchan_wakeone_sync(struct wchan *wc, struct spinlock *lk)
+{
+	struct thread *target;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	target = threadlist_remhead(&wc->wc_threads);
+	if (target == NULL) {
+		return;
+	}
+	target->t_wchan = NULL;
+
+	if (!thread_handoff(target)) {
+		thread_wakeup(target);
+	}
 }
 
 /*
@@ -1059,6 +2120,7 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	 * private list.
 	 */
 	while ((target = threadlist_remhead(&wc->wc_threads)) != NULL) {
+		target->t_wchan = NULL;
 		threadlist_addtail(&list, target);
 	}
 
@@ -1068,7 +2130,7 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 	 * make each thread runnable.
 	 */
 	while ((target = threadlist_remhead(&list)) != NULL) {
-		thread_make_runnable(target, false);
+		thread_wakeup(target);
 	}
 
 	threadlist_cleanup(&list);
@@ -1091,22 +2153,316 @@ wchan_isempty(struct wchan *wc, struct spinlock *lk)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Sleep queue functions
+ */
+
+/*
+ * Pick the bucket for KEY. Keys are object addresses, so the low
+ * bits carry little information; a multiplicative hash spreads the
+ * rest over the table.
+ */
+static
+struct sleepq *
+sleepq_hash(const void *key)
+{
+	uint32_t x;
+
+	x = (uint32_t)(uintptr_t)key >> 2;
+	x *= 2654435761U;
+	return &sleepqs[x >> (32 - SLEEPQ_HASHBITS)];
+}
+
+/*
+ * Take the first thread sleeping on KEY off SQ, or return NULL.
+ */
+static
+struct thread *
+sleepq_take(struct sleepq *sq, const void *key)
+{
+	struct thread *t;
+
+	KASSERT(spinlock_do_i_hold(&sq->sq_lock));
+
+	THREADLIST_FORALL(t, sq->sq_wchan.wc_threads) {
+		if (t->t_sleepkey == key) {
+			threadlist_remove(&sq->sq_wchan.wc_threads, t);
+			t->t_wchan = NULL;
+			t->t_sleepkey = NULL;
+			return t;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Go to sleep on KEY. We take the bucket lock before letting go of
+ * LK and keep it until thread_switch has us on the bucket, so a
+ * waker (who must hold LK, then takes the bucket lock) can't miss us.
+ */
+void
+sleepq_sleep(const void *key, const char *name, struct spinlock *lk)
+{
+	struct sleepq *sq;
+	struct thread *cur = curthread;
+
+	/* may not sleep in an interrupt handler */
+	KASSERT(!cur->t_in_interrupt);
+
+	/* must hold the spinlock, and no others */
+	KASSERT(spinlock_do_i_hold(lk));
+	KASSERT(curcpu->c_spinlocks == 1);
+
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	spinlock_release(lk);
+
+	cur->t_sleepkey = key;
+	cur->t_wchan_name = name;
+	thread_switch(S_SLEEP, &sq->sq_wchan, &sq->sq_lock);
+	KASSERT(cur->t_sleepkey == NULL);
+
+	spinlock_acquire(lk);
+}
+
+/*
+ * State for sleepq_sleep_timeout, shared with its callout.
+ */
+struct sleepq_timeout {
+	struct thread *st_thread;
+	const void *st_key;
+	struct spinlock *st_lock;
+	bool st_expired;		/* protected by st_lock */
+};
+
+/*
+ * Callout function for sleepq_sleep_timeout. Like a waker, take the
+ * caller's lock and then the bucket lock; if the thread is still on
+ * the bucket under its key, nobody woke it in time.
+ *
+ * As with wchan_timeout_expire, the thread can't be asleep on the
+ * key again by now, because it doesn't leave sleepq_sleep_timeout
+ * until its callout is cancelled or has finished running.
+ */
+static
+void
+sleepq_timeout_expire(void *data)
+{
+	struct sleepq_timeout *st = data;
+	struct thread *t = st->st_thread;
+	struct sleepq *sq;
+	bool found = false;
+
+	sq = sleepq_hash(st->st_key);
+	spinlock_acquire(st->st_lock);
+	spinlock_acquire(&sq->sq_lock);
+	if (t->t_sleepkey == st->st_key) {
+		threadlist_remove(&sq->sq_wchan.wc_threads, t);
+		t->t_wchan = NULL;
+		t->t_sleepkey = NULL;
+		found = true;
+	}
+	spinlock_release(&sq->sq_lock);
+	if (found) {
+		st->st_expired = true;
+		thread_wakeup(t);
+	}
+	spinlock_release(st->st_lock);
+}
+
+/*
+ * Go to sleep on KEY for at most TICKS hardclocks.
+ */
+int
+sleepq_sleep_timeout(const void *key, const char *name, struct spinlock *lk,
+		     unsigned ticks)
+{
+	struct sleepq_timeout st;
+	struct callout co;
+	struct sleepq *sq;
+	struct thread *cur = curthread;
+
+	/* may not sleep in an interrupt handler */
+	KASSERT(!cur->t_in_interrupt);
+
+	/* must hold the spinlock, and no others */
+	KASSERT(spinlock_do_i_hold(lk));
+	KASSERT(curcpu->c_spinlocks == 1);
+
+	st.st_thread = cur;
+	st.st_key = key;
+	st.st_lock = lk;
+	st.st_expired = false;
+	callout_init(&co, sleepq_timeout_expire, &st);
+
+	/*
+	 * The callout needs LK and then the bucket lock, and we hold
+	 * one or the other until thread_switch has us on the bucket.
+	 * Cancel it before taking LK back, as wchan_sleep_timeout does.
+	 */
+	sq = sleepq_hash(key);
+	callout_schedule(&co, ticks);
+	spinlock_acquire(&sq->sq_lock);
+	spinlock_release(lk);
+
+	cur->t_sleepkey = key;
+	cur->t_wchan_name = name;
+	thread_switch(S_SLEEP, &sq->sq_wchan, &sq->sq_lock);
+	KASSERT(cur->t_sleepkey == NULL);
+
+	callout_cancel(&co);
+	spinlock_acquire(lk);
+
+	return st.st_expired ? ETIMEDOUT : 0;
+}
+
+/*
+ * Wake up one thread sleeping on KEY. As with wait channels, the
+ * runqueue lock nests inside the caller's LK; the bucket lock is
+ * dropped first, since once the thread is off the bucket nobody
+ * else can find it.
+ */
+void
+sleepq_wakeone(const void *key, struct spinlock *lk)
+{
+	struct sleepq *sq;
+	struct thread *target;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	target = sleepq_take(sq, key);
+	spinlock_release(&sq->sq_lock);
+
+	if (target != NULL) {
+		thread_wakeup(target);
+	}
+}
+
+/*
+ * Wake up one thread sleeping on KEY, handing it this cpu if we can.
+ */
+void
+sleepq_wakeone_sync(const void *key, struct spinlock *lk)
+{
+	struct sleepq *sq;
+	struct thread *target;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	target = sleepq_take(sq, key);
+	spinlock_release(&sq->sq_lock);
+
+	if (target != NULL && !thread_handoff(target)) {
+		thread_wakeup(target);
+	}
+}
+
+/*
+ * Wake up all threads sleeping on KEY. They are unlinked in one pass
+ * over the bucket, which may also hold sleepers on other keys.
+ */
+void
+sleepq_wakeall(const void *key, struct spinlock *lk)
+{
+	struct sleepq *sq;
+	struct thread *target, *next;
+	struct threadlist list;
+
+	KASSERT(spinlock_do_i_hold(lk));
+
+	threadlist_init(&list);
+
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	target = sq->sq_wchan.wc_threads.tl_head.tln_next->tln_self;
+	while (target != NULL) {
+		next = target->t_listnode.tln_next->tln_self;
+		if (target->t_sleepkey == key) {
+			threadlist_remove(&sq->sq_wchan.wc_threads, target);
+			target->t_wchan = NULL;
+			target->t_sleepkey = NULL;
+			threadlist_addtail(&list, target);
+		}
+		target = next;
+	}
+	spinlock_release(&sq->sq_lock);
+
+	while ((target = threadlist_remhead(&list)) != NULL) {
+		thread_wakeup(target);
+	}
+
+	threadlist_cleanup(&list);
+}
+
+/*
+ * Return true if no thread is sleeping on KEY.
+ */
+bool
+sleepq_isempty(const void *key)
+{
+	struct sleepq *sq;
+	struct thread *t;
+	bool ret = true;
+
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	THREADLIST_FORALL(t, sq->sq_wchan.wc_threads) {
+		if (t->t_sleepkey == key) {
+			ret = false;
+			break;
+		}
+	}
+	spinlock_release(&sq->sq_lock);
+
+	return ret;
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Machine-independent IPI handling
  */
 
 /*
  * Send an IPI (inter-processor interrupt) to the specified CPU.
+ *
+ * If the same IPI is already pending there, don't send another. All
+ * the plain IPIs are idempotent requests to go look at shared state
+ * (the run queue, c_resched), and the target hasn't cleared the bit
+ * yet, so it will see whatever our caller did before calling here.
+ * This matters in wakeup storms, where each thread woken onto an
+ * idle cpu would otherwise cost a lock round trip and a bus write.
+ * The unlocked peek catches most duplicates; a stale read just
+ * means we take the lock and check again.
  */
 void
 ipi_send(struct cpu *target, int code)
 {
+	uint32_t bit;
+
 	KASSERT(code >= 0 && code < 32);
+	bit = (uint32_t)1 << code;
+
+	if (target->c_ipi_pending & bit) {
+		curcpu->c_ipi_coalesced++;
+		return;
+	}
 
 	spinlock_acquire(&target->c_ipi_lock);
-	target->c_ipi_pending |= (uint32_t)1 << code;
+	if (target->c_ipi_pending & bit) {
+		spinlock_release(&target->c_ipi_lock);
+		curcpu->c_ipi_coalesced++;
+		return;
+	}
+	target->c_ipi_pending |= bit;
 	mainbus_send_ipi(target);
 	spinlock_release(&target->c_ipi_lock);
+
+	curcpu->c_ipi_sent++;
 }
 
 /*
@@ -1154,8 +2510,15 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 		target->c_numshootdown = n+1;
 	}
 
-	target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
-	mainbus_send_ipi(target);
+	/* As in ipi_send, one interrupt covers everything queued. */
+	if (target->c_ipi_pending & ((uint32_t)1 << IPI_TLBSHOOTDOWN)) {
+		curcpu->c_ipi_coalesced++;
+	}
+	else {
+		target->c_ipi_pending |= (uint32_t)1 << IPI_TLBSHOOTDOWN;
+		mainbus_send_ipi(target);
+		curcpu->c_ipi_sent++;
+	}
 
 	spinlock_release(&target->c_ipi_lock);
 }
@@ -1171,6 +2534,7 @@ interprocessor_interrupt(void)
 
 	spinlock_acquire(&curcpu->c_ipi_lock);
 	bits = curcpu->c_ipi_pending;
+	curcpu->c_ipi_received++;
 
 	if (bits & (1U << IPI_PANIC)) {
 		/* panic on another cpu - just stop dead */
@@ -1195,6 +2559,10 @@ interprocessor_interrupt(void)
 		 * interrupt; don't need to do anything else.
 		 */
 	}
+	if (bits & (1U << IPI_RESCHED)) {
+		/* Yield on the way out of the interrupt. */
+		curcpu->c_resched = true;
+	}
 	if (bits & (1U << IPI_TLBSHOOTDOWN)) {
 		/*
 		 * Note: depending on your VM system locking you might
@@ -1210,3 +2578,21 @@ interprocessor_interrupt(void)
 	curcpu->c_ipi_pending = 0;
 	spinlock_release(&curcpu->c_ipi_lock);
 }
+
+/*
+ * Total up the IPI counters, for tests. Unlocked, like
+ * cpu_printstats.
+ */
+void
+ipi_counts(unsigned *sent, unsigned *coalesced)
+{
+	unsigned i;
+	struct cpu *c;
+
+	*sent = *coalesced = 0;
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		*sent += c->c_ipi_sent;
+		*coalesced += c->c_ipi_coalesced;
+	}
+}
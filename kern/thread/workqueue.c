@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Workqueues. See workqueue.h.
+ */
+
+#include <types.h>
+#include <kern/sched.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <workqueue.h>
+
+/*
+ * Add W to WQ and wake the worker. W must already be marked pending.
+ */
+static
+void
+workqueue_add(struct workqueue *wq, struct work *w)
+{
+	spinlock_acquire(&wq->wq_lock);
+	if (!wq->wq_running) {
+		/* Too early in boot for a worker; just do it now. */
+		spinlock_release(&wq->wq_lock);
+		atomic_set(&w->w_pending, 0);
+		w->w_func(w->w_arg);
+		return;
+	}
+	w->w_next = NULL;
+	*wq->wq_tailp = w;
+	wq->wq_tailp = &w->w_next;
+	wq->wq_queued++;
+	wq->wq_depth++;
+	if (wq->wq_depth > wq->wq_maxdepth) {
+		wq->wq_maxdepth = wq->wq_depth;
+	}
+	wchan_wakeone(wq->wq_wchan, &wq->wq_lock);
+	spinlock_release(&wq->wq_lock);
+}
+
+/*
+ * Callout function for delayed work: the delay is over, so queue it
+ * on the cpu the timer fired on (the one it was scheduled from).
+ */
+static
+void
+work_timeout(void *vw)
+{
+	struct work *w = vw;
+
+	workqueue_add(&curcpu->c_workq, w);
+}
+
+/*
+ * The worker thread. Takes items off the queue one at a time and
+ * runs them with the lock released.
+ */
+static
+void
+workqueue_worker(void *vwq, unsigned long junk)
+{
+	struct workqueue *wq = vwq;
+	struct work *w;
+
+	(void)junk;
+
+	/*
+	 * Completions should run ahead of time-sharing threads, but a
+	 * flood of them mustn't starve the cpu: run real-time for one
+	 * tick in ten. If admission fails, run time-sharing instead.
+	 */
+	(void)thread_setrt(SCHED_RT_MAXPRIO, 1, 10);
+
+	spinlock_acquire(&wq->wq_lock);
+	while (1) {
+		w = wq->wq_head;
+		if (w == NULL) {
+			wchan_sleep(wq->wq_wchan, &wq->wq_lock);
+			continue;
+		}
+		wq->wq_head = w->w_next;
+		if (wq->wq_head == NULL) {
+			wq->wq_tailp = &wq->wq_head;
+		}
+		wq->wq_depth--;
+		spinlock_release(&wq->wq_lock);
+
+		w->w_next = NULL;
+		atomic_set(&w->w_pending, 0);
+		w->w_func(w->w_arg);
+
+		spinlock_acquire(&wq->wq_lock);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Interface
+
+void
+work_init(struct work *w, void (*func)(void *), void *arg)
+{
+	w->w_next = NULL;
+	atomic_set(&w->w_pending, 0);
+	callout_init(&w->w_timer, work_timeout, w);
+	w->w_func = func;
+	w->w_arg = arg;
+}
+
+bool
+queue_work(struct work *w)
+{
+	if (atomic_cas(&w->w_pending, 0, 1) != 0) {
+		return false;
+	}
+	workqueue_add(&curcpu->c_workq, w);
+	return true;
+}
+
+bool
+queue_delayed_work(struct work *w, unsigned ticks)
+{
+	if (ticks == 0) {
+		return queue_work(w);
+	}
+	if (atomic_cas(&w->w_pending, 0, 1) != 0) {
+		return false;
+	}
+	callout_schedule(&w->w_timer, ticks);
+	return true;
+}
+
+bool
+cancel_delayed_work(struct work *w)
+{
+	if (!callout_cancel(&w->w_timer)) {
+		return false;
+	}
+	atomic_set(&w->w_pending, 0);
+	return true;
+}
+
+void
+workqueue_init(struct workqueue *wq)
+{
+	spinlock_init(&wq->wq_lock);
+	wq->wq_head = NULL;
+	wq->wq_tailp = &wq->wq_head;
+	wq->wq_wchan = NULL;
+	wq->wq_running = false;
+	wq->wq_queued = 0;
+	wq->wq_maxdepth = 0;
+	wq->wq_depth = 0;
+}
+
+/*
+ * Start the current cpu's worker thread. Called once on each cpu as
+ * it comes up. The worker is bound to this cpu; we get it created
+ * here by binding ourselves for the duration of the thread_fork.
+ */
+void
+workqueue_start(void)
+{
+	struct workqueue *wq;
+	struct wchan *wc;
+	uint32_t oldmask;
+	unsigned num;
+	int result;
+
+	num = curcpu->c_number;
+	wq = &curcpu->c_workq;
+
+	wc = wchan_create("workq");
+	if (wc == NULL) {
+		panic("workqueue_start: Out of memory\n");
+	}
+
+	spinlock_acquire(&wq->wq_lock);
+	KASSERT(!wq->wq_running);
+	wq->wq_wchan = wc;
+	wq->wq_running = true;
+	spinlock_release(&wq->wq_lock);
+
+	oldmask = curthread->t_affinity;
+	result = thread_setaffinity(CPUMASK_BIT(num));
+	KASSERT(result == 0);
+	result = thread_fork("workq", kproc, workqueue_worker, wq, 0);
+	if (result) {
+		panic("workqueue_start: thread_fork: %s\n", strerror(result));
+	}
+	thread_setaffinity(oldmask);
+}
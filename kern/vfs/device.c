@@ -289,6 +289,22 @@ dev_namefile(struct vnode *v, struct uio *uio)
 	return 0;
 }
 
+/*
+ * For poll and select. Devices that never make anyone wait (disks,
+ * null:, random:) leave devop_poll out and are always ready.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, struct pollentry *pe)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_ops->devop_poll == NULL) {
+		return vnode_poll_ready(v, events, pe);
+	}
+	return DEVOP_POLL(d, events, pe);
+}
+
 /*
  * Name lookup.
  *
@@ -339,6 +355,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_mmap = dev_mmap,
 	.vop_truncate = dev_truncate,
 	.vop_namefile = dev_namefile,
+	.vop_poll = dev_poll,
 	.vop_creat = vopfail_creat_notdir,
 	.vop_symlink = vopfail_symlink_notdir,
 	.vop_mkdir = vopfail_mkdir_notdir,
@@ -0,0 +1,711 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Pipes. See pipe.h.
+ *
+ * The ring buffer is addressed by two free-running byte counts:
+ * pp_head (bytes read so far) and pp_tail (bytes written so far).
+ * pp_tail - pp_head is the amount buffered, and a count modulo
+ * PIPE_SIZE is a position in the buffer. PIPE_SIZE is a power of
+ * two, so this keeps working when the counts wrap.
+ *
+ * Readers take pp_rsem and writers pp_wsem, one at a time each, and
+ * hold it across the copy, which may fault. So while a reader copies
+ * out of the buffered part of the ring, only it can move pp_head,
+ * and only the writer can move pp_tail, and only forward into the
+ * free part; neither copy needs pp_lock. pp_lock covers updating the
+ * counts, the end-open flags, and sleeping.
+ *
+ * A reader sleeps only when the pipe is empty and a writer only
+ * when it is full, so those are the only transitions that wake
+ * anyone: a write into an empty pipe wakes readers, a read from a
+ * full one wakes writers. In between, a steady producer and consumer
+ * run without ever waking each other. The same transitions, and
+ * closing an end, wake threads waiting in poll or select on the
+ * other end.
+ *
+ * A thread with t_nowait set never sleeps in here: where it would,
+ * reads and writes return EAGAIN, or the count moved so far.
+ *
+ * Buffers are pages from alloc_kpages. Since the VM system may not
+ * really free pages (dumbvm doesn't), freed buffers are kept on a
+ * list and reused by later pipes.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <stat.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <sleepq.h>
+#include <synch.h>
+#include <thread.h>
+#include <current.h>
+#include <uio.h>
+#include <vm.h>
+#include <vnode.h>
+#include <poll.h>
+#include <pipe.h>
+
+#define PIPE_SIZE	(PIPE_NPAGES * PAGE_SIZE)
+
+struct pipe {
+	struct vnode pp_rdvn;		/* read end */
+	struct vnode pp_wrvn;		/* write end */
+	char *pp_buf;			/* PIPE_SIZE bytes */
+	struct semaphore *pp_rsem;	/* one reader at a time */
+	struct semaphore *pp_wsem;	/* one writer at a time */
+
+	struct spinlock pp_lock;
+	unsigned pp_head;		/* bytes read */
+	unsigned pp_tail;		/* bytes written */
+	bool pp_readable;		/* read end still open */
+	bool pp_writable;		/* write end still open */
+
+	struct pollhead pp_rdph;	/* pollers on the read end */
+	struct pollhead pp_wrph;	/* pollers on the write end */
+};
+
+/* Sleep queue keys: readers wait for data, writers for space. */
+#define PIPE_DATAKEY(pp)	(&(pp)->pp_tail)
+#define PIPE_SPACEKEY(pp)	(&(pp)->pp_head)
+
+static const struct vnode_ops pipe_vnode_ops;
+
+/* Free buffers, chained through their first word. */
+static struct spinlock pipebuf_lock = SPINLOCK_INITIALIZER;
+static void *pipebuf_free;
+
+static
+char *
+pipebuf_get(void)
+{
+	void *buf;
+
+	spinlock_acquire(&pipebuf_lock);
+	buf = pipebuf_free;
+	if (buf != NULL) {
+		pipebuf_free = *(void **)buf;
+	}
+	spinlock_release(&pipebuf_lock);
+
+	if (buf == NULL) {
+		buf = (void *)alloc_kpages(PIPE_NPAGES);
+	}
+	return buf;
+}
+
+static
+void
+pipebuf_put(char *buf)
+{
+	spinlock_acquire(&pipebuf_lock);
+	*(void **)buf = pipebuf_free;
+	pipebuf_free = buf;
+	spinlock_release(&pipebuf_lock);
+}
+
+static
+void
+pipe_destroy(struct pipe *pp)
+{
+	if (pp->pp_buf != NULL) {
+		pipebuf_put(pp->pp_buf);
+	}
+	if (pp->pp_rsem != NULL) {
+		sem_destroy(pp->pp_rsem);
+	}
+	if (pp->pp_wsem != NULL) {
+		sem_destroy(pp->pp_wsem);
+	}
+	pollhead_cleanup(&pp->pp_rdph);
+	pollhead_cleanup(&pp->pp_wrph);
+	spinlock_cleanup(&pp->pp_lock);
+	kfree(pp);
+}
+
+int
+pipe_create(struct vnode **rdvn, struct vnode **wrvn)
+{
+	struct pipe *pp;
+
+	pp = kmalloc(sizeof(*pp));
+	if (pp == NULL) {
+		return ENOMEM;
+	}
+	spinlock_init(&pp->pp_lock);
+	pollhead_init(&pp->pp_rdph);
+	pollhead_init(&pp->pp_wrph);
+	pp->pp_head = pp->pp_tail = 0;
+	pp->pp_readable = pp->pp_writable = true;
+	pp->pp_buf = pipebuf_get();
+	pp->pp_rsem = sem_create("piperd", 1);
+	pp->pp_wsem = sem_create("pipewr", 1);
+	if (pp->pp_buf == NULL || pp->pp_rsem == NULL || pp->pp_wsem == NULL) {
+		pipe_destroy(pp);
+		return ENOMEM;
+	}
+
+	vnode_init(&pp->pp_rdvn, &pipe_vnode_ops, NULL, pp);
+	vnode_init(&pp->pp_wrvn, &pipe_vnode_ops, NULL, pp);
+
+	*rdvn = &pp->pp_rdvn;
+	*wrvn = &pp->pp_wrvn;
+	return 0;
+}
+
+bool
+pipe_isread(struct vnode *vn)
+{
+	struct pipe *pp = vn->vn_data;
+
+	return vn->vn_ops == &pipe_vnode_ops && vn == &pp->pp_rdvn;
+}
+
+bool
+pipe_iswrite(struct vnode *vn)
+{
+	struct pipe *pp = vn->vn_data;
+
+	return vn->vn_ops == &pipe_vnode_ops && vn == &pp->pp_wrvn;
+}
+
+bool
+pipe_same(struct vnode *vn1, struct vnode *vn2)
+{
+	return vn1->vn_ops == &pipe_vnode_ops &&
+		vn2->vn_ops == &pipe_vnode_ops &&
+		vn1->vn_data == vn2->vn_data;
+}
+
+/*
+ * Take SEM, which is pp_rsem or pp_wsem, or fail with EAGAIN if that
+ * would mean waiting and we mustn't.
+ */
+static
+int
+pipe_enter(struct semaphore *sem)
+{
+	if (curthread->t_nowait) {
+		return tryP(sem) ? 0 : EAGAIN;
+	}
+	P(sem);
+	return 0;
+}
+
+/*
+ * Wait until there is something to read. Returns the number of bytes
+ * buffered in *AVAIL; 0 means end of file. Call with pp_rsem held.
+ */
+static
+int
+pipe_waitdata(struct pipe *pp, size_t *avail)
+{
+	spinlock_acquire(&pp->pp_lock);
+	while (pp->pp_tail == pp->pp_head && pp->pp_writable) {
+		if (curthread->t_nowait) {
+			spinlock_release(&pp->pp_lock);
+			return EAGAIN;
+		}
+		sleepq_sleep(PIPE_DATAKEY(pp), "pipe", &pp->pp_lock);
+	}
+	*avail = pp->pp_tail - pp->pp_head;
+	spinlock_release(&pp->pp_lock);
+	return 0;
+}
+
+/*
+ * Wait until there is room to write. Returns the free space in
+ * *SPACE, or EPIPE if nobody will ever read it. Call with pp_wsem
+ * held.
+ */
+static
+int
+pipe_waitspace(struct pipe *pp, size_t *space)
+{
+	spinlock_acquire(&pp->pp_lock);
+	while (pp->pp_tail - pp->pp_head == PIPE_SIZE && pp->pp_readable) {
+		if (curthread->t_nowait) {
+			spinlock_release(&pp->pp_lock);
+			return EAGAIN;
+		}
+		sleepq_sleep(PIPE_SPACEKEY(pp), "pipe", &pp->pp_lock);
+	}
+	if (!pp->pp_readable) {
+		spinlock_release(&pp->pp_lock);
+		return EPIPE;
+	}
+	*space = PIPE_SIZE - (pp->pp_tail - pp->pp_head);
+	spinlock_release(&pp->pp_lock);
+	return 0;
+}
+
+/* LEN bytes have been read; wake writers if it was full. */
+static
+void
+pipe_consumed(struct pipe *pp, size_t len)
+{
+	bool wasfull;
+
+	spinlock_acquire(&pp->pp_lock);
+	wasfull = len > 0 && pp->pp_tail - pp->pp_head == PIPE_SIZE;
+	if (wasfull) {
+		sleepq_wakeall(PIPE_SPACEKEY(pp), &pp->pp_lock);
+	}
+	pp->pp_head += len;
+	spinlock_release(&pp->pp_lock);
+
+	if (wasfull) {
+		pollhead_wakeup(&pp->pp_wrph);
+	}
+}
+
+/* LEN bytes have been written; wake readers if it was empty. */
+static
+void
+pipe_produced(struct pipe *pp, size_t len)
+{
+	bool wasempty;
+
+	spinlock_acquire(&pp->pp_lock);
+	wasempty = len > 0 && pp->pp_tail == pp->pp_head;
+	if (wasempty) {
+		sleepq_wakeall(PIPE_DATAKEY(pp), &pp->pp_lock);
+	}
+	pp->pp_tail += len;
+	spinlock_release(&pp->pp_lock);
+
+	if (wasempty) {
+		pollhead_wakeup(&pp->pp_rdph);
+	}
+}
+
+/*
+ * Describe LEN bytes of the ring starting at count POS with (at most
+ * two) kernel iovecs, since the range may wrap. Returns how many.
+ */
+static
+unsigned
+pipe_ringiov(struct pipe *pp, unsigned pos, size_t len, struct iovec *iov)
+{
+	unsigned off = pos % PIPE_SIZE;
+	size_t first;
+
+	first = PIPE_SIZE - off;
+	if (first > len) {
+		first = len;
+	}
+	iov[0].iov_kbase = pp->pp_buf + off;
+	iov[0].iov_len = first;
+	if (first == len) {
+		return 1;
+	}
+	iov[1].iov_kbase = pp->pp_buf;
+	iov[1].iov_len = len - first;
+	return 2;
+}
+
+/*
+ * Set up a kernel uio over the ring iovecs, for splice.
+ */
+static
+void
+pipe_kuio(struct iovec *iov, unsigned iovcnt, struct uio *u, size_t len,
+	  off_t offset, enum uio_rw rw)
+{
+	u->uio_iov = iov;
+	u->uio_iovcnt = iovcnt;
+	u->uio_offset = offset;
+	u->uio_resid = len;
+	u->uio_segflg = UIO_SYSSPACE;
+	u->uio_rw = rw;
+	u->uio_space = NULL;
+}
+
+////////////////////////////////////////////////////////////
+// vnode operations
+
+static
+int
+pipe_eachopen(struct vnode *vn, int flags)
+{
+	/* Pipes have no name, so this shouldn't happen. */
+	(void)vn;
+	(void)flags;
+	return EINVAL;
+}
+
+static
+int
+pipe_reclaim(struct vnode *vn)
+{
+	struct pipe *pp = vn->vn_data;
+	bool gone;
+
+	spinlock_acquire(&pp->pp_lock);
+	if (vn == &pp->pp_rdvn) {
+		pp->pp_readable = false;
+		sleepq_wakeall(PIPE_SPACEKEY(pp), &pp->pp_lock);
+	}
+	else {
+		pp->pp_writable = false;
+		sleepq_wakeall(PIPE_DATAKEY(pp), &pp->pp_lock);
+	}
+	/* Nobody can poll the end that's going away. */
+	pollhead_wakeup(vn == &pp->pp_rdvn ? &pp->pp_wrph : &pp->pp_rdph);
+	gone = !pp->pp_readable && !pp->pp_writable;
+	/*
+	 * Once we let go of the lock, the other end may be reclaimed
+	 * and free the pipe, so finish with it first.
+	 */
+	vnode_cleanup(vn);
+	spinlock_release(&pp->pp_lock);
+
+	if (gone) {
+		pipe_destroy(pp);
+	}
+	return 0;
+}
+
+/*
+ * Read what is there, up to the size of the request, waiting only
+ * if there is nothing.
+ */
+static
+int
+pipe_read(struct vnode *vn, struct uio *uio)
+{
+	struct pipe *pp = vn->vn_data;
+	struct iovec iov[2];
+	size_t avail, resid;
+	unsigned i, n;
+	int result = 0;
+
+	if (vn != &pp->pp_rdvn) {
+		return EBADF;
+	}
+	if (uio->uio_resid == 0) {
+		return 0;
+	}
+
+	result = pipe_enter(pp->pp_rsem);
+	if (result) {
+		return result;
+	}
+	result = pipe_waitdata(pp, &avail);
+	if (result) {
+		V(pp->pp_rsem);
+		return result;
+	}
+	if (avail > uio->uio_resid) {
+		avail = uio->uio_resid;
+	}
+	n = pipe_ringiov(pp, pp->pp_head, avail, iov);
+	resid = uio->uio_resid;
+	for (i=0; i<n && result == 0; i++) {
+		result = uiomove(iov[i].iov_kbase, iov[i].iov_len, uio);
+	}
+	pipe_consumed(pp, resid - uio->uio_resid);
+	V(pp->pp_rsem);
+	return result;
+}
+
+/*
+ * Write everything, waiting for space as needed. Writers take turns
+ * whole writes at a time, so writes are never interleaved.
+ */
+static
+int
+pipe_write(struct vnode *vn, struct uio *uio)
+{
+	struct pipe *pp = vn->vn_data;
+	struct iovec iov[2];
+	size_t space, resid, start;
+	unsigned i, n;
+	int result = 0;
+
+	if (vn != &pp->pp_wrvn) {
+		return EBADF;
+	}
+
+	start = uio->uio_resid;
+	result = pipe_enter(pp->pp_wsem);
+	if (result) {
+		return result;
+	}
+	while (uio->uio_resid > 0 && result == 0) {
+		result = pipe_waitspace(pp, &space);
+		if (result) {
+			break;
+		}
+		if (space > uio->uio_resid) {
+			space = uio->uio_resid;
+		}
+		n = pipe_ringiov(pp, pp->pp_tail, space, iov);
+		resid = uio->uio_resid;
+		for (i=0; i<n && result == 0; i++) {
+			result = uiomove(iov[i].iov_kbase, iov[i].iov_len,
+					 uio);
+		}
+		pipe_produced(pp, resid - uio->uio_resid);
+	}
+	V(pp->pp_wsem);
+
+	/*
+	 * If the reader went away partway, report what got written;
+	 * the next write gets the EPIPE. Likewise if we had to stop
+	 * rather than wait for space.
+	 */
+	if ((result == EPIPE || result == EAGAIN) &&
+	    uio->uio_resid < start) {
+		result = 0;
+	}
+	return result;
+}
+
+/*
+ * The read end is ready when there is data or the write end has
+ * been closed (POLLHUP); the write end when there is space, or with
+ * POLLERR once the read end has been closed.
+ */
+static
+int
+pipe_poll(struct vnode *vn, int events, struct pollentry *pe)
+{
+	struct pipe *pp = vn->vn_data;
+	unsigned used;
+	int revents = 0;
+
+	pollwait(pe, vn == &pp->pp_rdvn ? &pp->pp_rdph : &pp->pp_wrph);
+
+	spinlock_acquire(&pp->pp_lock);
+	used = pp->pp_tail - pp->pp_head;
+	if (vn == &pp->pp_rdvn) {
+		if (used > 0) {
+			revents |= POLLIN;
+		}
+		if (!pp->pp_writable) {
+			revents |= POLLIN | POLLHUP;
+		}
+	}
+	else {
+		if (!pp->pp_readable) {
+			revents |= POLLOUT | POLLERR;
+		}
+		else if (used < PIPE_SIZE) {
+			revents |= POLLOUT;
+		}
+	}
+	spinlock_release(&pp->pp_lock);
+
+	return revents & (events | POLLHUP | POLLERR);
+}
+
+static
+int
+pipe_ioctl(struct vnode *vn, int op, userptr_t data)
+{
+	(void)vn;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static
+int
+pipe_gettype(struct vnode *vn, mode_t *ret)
+{
+	(void)vn;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+/*
+ * The size of a pipe is the amount buffered in it.
+ */
+static
+int
+pipe_stat(struct vnode *vn, struct stat *st)
+{
+	struct pipe *pp = vn->vn_data;
+
+	bzero(st, sizeof(*st));
+	st->st_mode = S_IFIFO | 0600;
+	st->st_nlink = 1;
+	st->st_blksize = PIPE_SIZE;
+	spinlock_acquire(&pp->pp_lock);
+	st->st_size = pp->pp_tail - pp->pp_head;
+	spinlock_release(&pp->pp_lock);
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *vn)
+{
+	(void)vn;
+	return false;
+}
+
+static
+int
+pipe_fsync(struct vnode *vn)
+{
+	(void)vn;
+	return EINVAL;
+}
+
+static
+int
+pipe_mmap(struct vnode *vn /* add stuff as needed */)
+{
+	(void)vn;
+	return ENODEV;
+}
+
+static
+int
+pipe_truncate(struct vnode *vn, off_t len)
+{
+	(void)vn;
+	(void)len;
+	return EINVAL;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_mmap = pipe_mmap,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+	.vop_poll = pipe_poll,
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+// splice
+
+int
+pipe_splice_out(struct vnode *rdvn, struct vnode *dst, off_t *offset,
+		size_t len, size_t *moved)
+{
+	struct pipe *pp = rdvn->vn_data;
+	struct iovec iov[2];
+	struct uio u;
+	size_t avail;
+	unsigned n;
+	int result;
+
+	KASSERT(pipe_isread(rdvn));
+
+	/* Like a zero-length read or write, don't wait. */
+	if (len == 0) {
+		*moved = 0;
+		return 0;
+	}
+
+	P(pp->pp_rsem);
+	result = pipe_waitdata(pp, &avail);
+	if (result) {
+		V(pp->pp_rsem);
+		return result;
+	}
+	if (avail > len) {
+		avail = len;
+	}
+	n = pipe_ringiov(pp, pp->pp_head, avail, iov);
+	pipe_kuio(iov, n, &u, avail, *offset, UIO_WRITE);
+	result = avail > 0 ? VOP_WRITE(dst, &u) : 0;
+	pipe_consumed(pp, avail - u.uio_resid);
+	V(pp->pp_rsem);
+
+	*offset = u.uio_offset;
+	*moved = avail - u.uio_resid;
+	return result;
+}
+
+int
+pipe_splice_in(struct vnode *wrvn, struct vnode *src, off_t *offset,
+	       size_t len, size_t *moved)
+{
+	struct pipe *pp = wrvn->vn_data;
+	struct iovec iov[2];
+	struct uio u;
+	size_t space;
+	unsigned n;
+	int result;
+
+	KASSERT(pipe_iswrite(wrvn));
+
+	/* Like a zero-length read or write, don't wait. */
+	if (len == 0) {
+		*moved = 0;
+		return 0;
+	}
+
+	P(pp->pp_wsem);
+	result = pipe_waitspace(pp, &space);
+	if (result) {
+		V(pp->pp_wsem);
+		return result;
+	}
+	if (space > len) {
+		space = len;
+	}
+	n = pipe_ringiov(pp, pp->pp_tail, space, iov);
+	pipe_kuio(iov, n, &u, space, *offset, UIO_READ);
+	result = space > 0 ? VOP_READ(src, &u) : 0;
+	pipe_produced(pp, space - u.uio_resid);
+	V(pp->pp_wsem);
+
+	*offset = u.uio_offset;
+	*moved = space - u.uio_resid;
+	return result;
+}
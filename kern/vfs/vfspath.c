@@ -38,6 +38,7 @@
 #include <lib.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <execcache.h>
 
 
 /* Does most of the work for open(). */
@@ -93,6 +94,11 @@ vfs_open(char *path, int openflags, mode_t mode, struct vnode **ret)
 		return result;
 	}
 
+	/* The file may change, so stop running it from the exec cache. */
+	if (canwrite) {
+		execcache_purge(vn);
+	}
+
 	if (openflags & O_TRUNC) {
 		if (canwrite==0) {
 			result = EINVAL;
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Waiting for readiness, for poll and select. See poll.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <clock.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <sleepq.h>
+#include <vnode.h>
+#include <poll.h>
+
+////////////////////////////////////////////////////////////
+// pollhead
+
+void
+pollhead_init(struct pollhead *ph)
+{
+	spinlock_init(&ph->ph_lock);
+	ph->ph_entries = NULL;
+}
+
+void
+pollhead_cleanup(struct pollhead *ph)
+{
+	KASSERT(ph->ph_entries == NULL);
+	spinlock_cleanup(&ph->ph_lock);
+}
+
+void
+pollwait(struct pollentry *pe, struct pollhead *ph)
+{
+	if (pe == NULL) {
+		return;
+	}
+	KASSERT(pe->pe_head == NULL);
+
+	spinlock_acquire(&ph->ph_lock);
+	pe->pe_head = ph;
+	pe->pe_next = ph->ph_entries;
+	pe->pe_prevp = &ph->ph_entries;
+	if (pe->pe_next != NULL) {
+		pe->pe_next->pe_prevp = &pe->pe_next;
+	}
+	ph->ph_entries = pe;
+	spinlock_release(&ph->ph_lock);
+}
+
+void
+pollhead_wakeup(struct pollhead *ph)
+{
+	struct pollentry *pe;
+	struct pollset *ps;
+
+	/*
+	 * The unlocked check is safe: a poller registers before it
+	 * checks the object's state, and the state has already been
+	 * changed by the time we get here. So if we don't see its
+	 * entry, it will see the new state. The barrier orders our
+	 * state change before the check, for owners that change state
+	 * without a lock the poller also takes.
+	 */
+	membar_any_any();
+	if (ph->ph_entries == NULL) {
+		return;
+	}
+
+	spinlock_acquire(&ph->ph_lock);
+	for (pe = ph->ph_entries; pe != NULL; pe = pe->pe_next) {
+		ps = pe->pe_set;
+		spinlock_acquire(&ps->ps_lock);
+		if (!pe->pe_ready) {
+			pe->pe_ready = true;
+			pe->pe_readynext = ps->ps_ready;
+			ps->ps_ready = pe;
+			sleepq_wakeall(ps, &ps->ps_lock);
+		}
+		spinlock_release(&ps->ps_lock);
+	}
+	spinlock_release(&ph->ph_lock);
+}
+
+/*
+ * vop_poll for objects nobody ever has to wait for.
+ */
+int
+vnode_poll_ready(struct vnode *vn, int events, struct pollentry *pe)
+{
+	(void)vn;
+	(void)pe;
+	return events & (POLLIN | POLLOUT);
+}
+
+////////////////////////////////////////////////////////////
+// pollset
+
+void
+pollset_init(struct pollset *ps)
+{
+	spinlock_init(&ps->ps_lock);
+	ps->ps_ready = NULL;
+	ps->ps_woken = false;
+}
+
+void
+pollset_cleanup(struct pollset *ps)
+{
+	KASSERT(sleepq_isempty(ps));
+	spinlock_cleanup(&ps->ps_lock);
+}
+
+void
+pollentry_init(struct pollentry *pe, struct pollset *ps, unsigned index)
+{
+	pe->pe_head = NULL;
+	pe->pe_next = NULL;
+	pe->pe_prevp = NULL;
+	pe->pe_set = ps;
+	pe->pe_readynext = NULL;
+	pe->pe_ready = false;
+	pe->pe_index = index;
+}
+
+void
+pollentry_remove(struct pollentry *pe)
+{
+	struct pollhead *ph = pe->pe_head;
+
+	if (ph == NULL) {
+		return;
+	}
+	spinlock_acquire(&ph->ph_lock);
+	*pe->pe_prevp = pe->pe_next;
+	if (pe->pe_next != NULL) {
+		pe->pe_next->pe_prevp = pe->pe_prevp;
+	}
+	spinlock_release(&ph->ph_lock);
+	pe->pe_head = NULL;
+}
+
+/*
+ * The pollset lives on the caller's stack, so sleep on its address
+ * rather than allocating a wait channel for every call that blocks.
+ */
+void
+pollset_wait(struct pollset *ps, uint64_t deadline)
+{
+	uint64_t now;
+	unsigned ticks;
+
+	spinlock_acquire(&ps->ps_lock);
+	while (ps->ps_ready == NULL && !ps->ps_woken) {
+		if (deadline == 0) {
+			sleepq_sleep(ps, "poll", &ps->ps_lock);
+			continue;
+		}
+		now = clock_monotonic_ns();
+		if (now >= deadline) {
+			break;
+		}
+		ticks = DIVROUNDUP(deadline - now, 1000000000 / HZ);
+		if (ticks > 3600 * HZ) {
+			/* Go around again if it's longer. */
+			ticks = 3600 * HZ;
+		}
+		sleepq_sleep_timeout(ps, "poll", &ps->ps_lock, ticks);
+	}
+	ps->ps_woken = false;
+	spinlock_release(&ps->ps_lock);
+}
+
+void
+pollset_wake(struct pollset *ps)
+{
+	spinlock_acquire(&ps->ps_lock);
+	ps->ps_woken = true;
+	sleepq_wakeall(ps, &ps->ps_lock);
+	spinlock_release(&ps->ps_lock);
+}
+
+struct pollentry *
+pollset_next(struct pollset *ps)
+{
+	struct pollentry *pe;
+
+	/*
+	 * Clear pe_ready as we take the entry off, before the caller
+	 * rechecks the object, so a change after that signals it again.
+	 */
+	spinlock_acquire(&ps->ps_lock);
+	pe = ps->ps_ready;
+	if (pe != NULL) {
+		ps->ps_ready = pe->pe_readynext;
+		pe->pe_readynext = NULL;
+		pe->pe_ready = false;
+	}
+	spinlock_release(&ps->ps_lock);
+	return pe;
+}
@@ -180,3 +180,63 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * Return a kernel-accessible window onto the top of the stack of AS,
+ * which need not be the current address space. See addrspace.h.
+ */
+int
+as_stackwindow(struct addrspace *as, vaddr_t *ktop, size_t *len)
+{
+	/*
+	 * Write this.
+	 */
+
+	(void)as;
+	(void)ktop;
+	(void)len;
+	return ENOSYS;
+}
+
+/*
+ * Shared read-only text. See addrspace.h. Until this VM system
+ * supports it, as_share_text fails with ENOSYS, so there is never a
+ * text handle to pass to the others.
+ */
+int
+as_share_text(struct addrspace *as, vaddr_t vaddr, struct astext **ret)
+{
+	(void)as;
+	(void)vaddr;
+	(void)ret;
+	return ENOSYS;
+}
+
+int
+as_define_text(struct addrspace *as, vaddr_t vaddr, size_t sz,
+	       struct astext *text)
+{
+	(void)as;
+	(void)vaddr;
+	(void)sz;
+	(void)text;
+	return ENOSYS;
+}
+
+void
+as_text_hold(struct astext *text)
+{
+	(void)text;
+}
+
+void
+as_text_release(struct astext *text)
+{
+	(void)text;
+}
+
+unsigned
+as_text_users(struct astext *text)
+{
+	(void)text;
+	return 0;
+}
@@ -214,6 +214,14 @@ copyout(const void *src, userptr_t userdest, size_t len)
 	return 0;
 }
 
+/*
+ * True if any byte of the 32-bit word W is zero. Subtracting 1 from
+ * each byte sets a byte's high bit only by borrowing through zero or
+ * if the high bit was already set; the & ~W throws out the latter.
+ * Works the same in either byte order.
+ */
+#define WORD_HASZERO(w)	((((w) - 0x01010101U) & ~(w) & 0x80808080U) != 0)
+
 /*
  * Common string copying function that behaves the way that's desired
  * for copyinstr and copyoutstr.
@@ -229,29 +237,109 @@ copyout(const void *src, userptr_t userdest, size_t len)
  * hit STOPLEN it's because the string has run into the end of
  * userspace. Thus in the latter case we return EFAULT, not
  * ENAMETOOLONG.
+ *
+ * Once SRC is word-aligned this looks at a word at a time, and only
+ * drops back to bytes for the word holding the null. An aligned word
+ * never straddles a page, so this touches no page the bytewise copy
+ * wouldn't. If DEST is not aligned the same way as SRC, the word is
+ * stored a byte at a time; that is still quicker than testing each
+ * byte.
  */
 static
 int
 copystr(char *dest, const char *src, size_t maxlen, size_t stoplen,
 	size_t *gotlen)
 {
-	size_t i;
+	size_t i, limit;
+	uint32_t w;
+
+	limit = maxlen < stoplen ? maxlen : stoplen;
 
-	for (i=0; i<maxlen && i<stoplen; i++) {
+	for (i=0; i<limit && ((uintptr_t)(src+i) & 3) != 0; i++) {
 		dest[i] = src[i];
 		if (src[i] == 0) {
-			if (gotlen != NULL) {
-				*gotlen = i+1;
+			goto found;
+		}
+	}
+
+	if (((uintptr_t)(dest+i) & 3) == 0) {
+		for (; i+4 <= limit; i += 4) {
+			w = *(const uint32_t *)(src+i);
+			if (WORD_HASZERO(w)) {
+				break;
+			}
+			*(uint32_t *)(dest+i) = w;
+		}
+	}
+	else {
+		for (; i+4 <= limit; i += 4) {
+			w = *(const uint32_t *)(src+i);
+			if (WORD_HASZERO(w)) {
+				break;
 			}
-			return 0;
+			dest[i] = src[i];
+			dest[i+1] = src[i+1];
+			dest[i+2] = src[i+2];
+			dest[i+3] = src[i+3];
 		}
 	}
+
+	for (; i<limit; i++) {
+		dest[i] = src[i];
+		if (src[i] == 0) {
+			goto found;
+		}
+	}
+
 	if (stoplen < maxlen) {
 		/* ran into user-kernel boundary */
 		return EFAULT;
 	}
 	/* otherwise just ran out of space */
 	return ENAMETOOLONG;
+
+ found:
+	if (gotlen != NULL) {
+		*gotlen = i+1;
+	}
+	return 0;
+}
+
+/*
+ * Like copystr, but only finds the length; nothing is copied.
+ */
+static
+int
+scanstr(const char *src, size_t maxlen, size_t stoplen, size_t *gotlen)
+{
+	size_t i, limit;
+
+	limit = maxlen < stoplen ? maxlen : stoplen;
+
+	for (i=0; i<limit && ((uintptr_t)(src+i) & 3) != 0; i++) {
+		if (src[i] == 0) {
+			goto found;
+		}
+	}
+	for (; i+4 <= limit; i += 4) {
+		if (WORD_HASZERO(*(const uint32_t *)(src+i))) {
+			break;
+		}
+	}
+	for (; i<limit; i++) {
+		if (src[i] == 0) {
+			goto found;
+		}
+	}
+
+	if (stoplen < maxlen) {
+		return EFAULT;
+	}
+	return ENAMETOOLONG;
+
+ found:
+	*gotlen = i+1;
+	return 0;
 }
 
 /*
@@ -319,3 +407,36 @@ copyoutstr(const char *src, userptr_t userdest, size_t len, size_t *actual)
 	curthread->t_machdep.tm_badfaultfunc = NULL;
 	return result;
 }
+
+/*
+ * copyinstrlen
+ *
+ * Find the length, including the null, of the string at user-level
+ * address USERSRC, failing as copyinstr would if it does not fit in
+ * LEN bytes. Lets a caller size the destination before copying the
+ * string straight into place.
+ */
+int
+copyinstrlen(const_userptr_t usersrc, size_t len, size_t *actual)
+{
+	int result;
+	size_t stoplen;
+
+	result = copycheck(usersrc, len, &stoplen);
+	if (result) {
+		return result;
+	}
+
+	curthread->t_machdep.tm_badfaultfunc = copyfail;
+
+	result = setjmp(curthread->t_machdep.tm_copyjmp);
+	if (result) {
+		curthread->t_machdep.tm_badfaultfunc = NULL;
+		return EFAULT;
+	}
+
+	result = scanstr((const char *)usersrc, len, stoplen, actual);
+
+	curthread->t_machdep.tm_badfaultfunc = NULL;
+	return result;
+}
@@ -355,6 +355,25 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * printtime
+ * print the time from START to END, as used with timing on.
+ */
+static
+void
+printtime(const char *what, time_t startsecs, unsigned long startnsecs,
+	  time_t endsecs, unsigned long endnsecs)
+{
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	endnsecs -= startnsecs;
+	endsecs -= startsecs;
+	warnx("%s: %lu.%09lu seconds", what,
+	      (unsigned long) endsecs, (unsigned long) endnsecs);
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
@@ -372,8 +391,8 @@ docommand(char *buf, struct exitinfo *ei)
 	pid_t pid;
 	int status;
 	int bg=0;
-	time_t startsecs, endsecs;
-	unsigned long startnsecs, endnsecs;
+	time_t startsecs, launchsecs, endsecs;
+	unsigned long startnsecs, launchnsecs, endnsecs;
 
 	nargs = 0;
 	for (s = strtok(buf, " \t\r\n"); s; s = strtok(NULL, " \t\r\n")) {
@@ -421,11 +440,16 @@ docommand(char *buf, struct exitinfo *ei)
 		__time(&startsecs, &startnsecs);
 	}
 
-	pid = fork();
+	/*
+	 * Use vfork, not fork: the child only execs, so there's no
+	 * point copying our address space for it. We don't run again
+	 * until the child has exec'd or exited.
+	 */
+	pid = vfork();
 	switch (pid) {
 		case -1:
 			/* error */
-			warn("fork");
+			warn("vfork");
 			exitinfo_exit(ei, 255);
 			return;
 		case 0:
@@ -444,7 +468,11 @@ docommand(char *buf, struct exitinfo *ei)
 			break;
 	}
 
-	/* parent */
+	/* parent; the child has exec'd by now, so it's launched */
+	if (timing) {
+		__time(&launchsecs, &launchnsecs);
+	}
+
 	if (bg) {
 		/* background this command */
 		remember_bg(pid);
@@ -463,14 +491,10 @@ docommand(char *buf, struct exitinfo *ei)
 
 	if (timing) {
 		__time(&endsecs, &endnsecs);
-		if (endnsecs < startnsecs) {
-			endnsecs += 1000000000;
-			endsecs--;
-		}
-		endnsecs -= startnsecs;
-		endsecs -= startsecs;
-		warnx("subprocess time: %lu.%09lu seconds",
-		      (unsigned long) endsecs, (unsigned long) endnsecs);
+		printtime("launch time", startsecs, startnsecs,
+			  launchsecs, launchnsecs);
+		printtime("subprocess time", startsecs, startnsecs,
+			  endsecs, endnsecs);
 	}
 }
 
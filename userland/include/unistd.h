@@ -40,13 +40,39 @@
  */
 #include <kern/fcntl.h>
 #include <kern/ioctl.h>
+#include <kern/iovec.h>
+#include <kern/poll.h>
 #include <kern/reboot.h>
+#include <kern/sched.h>
 #include <kern/seek.h>
+#include <kern/select.h>
+#include <kern/spawn.h>
 #include <kern/time.h>
+#include <kern/resource.h>	/* after kern/time.h: uses struct timeval */
 #include <kern/unistd.h>
+#include <kern/uring.h>
 #include <kern/wait.h>
 
 
+/*
+ * For select(). FD_SETSIZE is OPEN_MAX; FD_ZERO, FD_SET, FD_CLR and
+ * FD_ISSET manipulate an fd_set.
+ */
+typedef struct __fd_set fd_set;
+#define FD_SETSIZE	__FD_SETSIZE
+#define FD_ZERO(set) do { \
+		unsigned __i; \
+		for (__i = 0; __i < __FD_SETSIZE / __NFDBITS; __i++) \
+			(set)->__fds_bits[__i] = 0; \
+	} while (0)
+#define FD_SET(fd, set) \
+	((set)->__fds_bits[(fd) / __NFDBITS] |= 1U << ((fd) % __NFDBITS))
+#define FD_CLR(fd, set) \
+	((set)->__fds_bits[(fd) / __NFDBITS] &= ~(1U << ((fd) % __NFDBITS)))
+#define FD_ISSET(fd, set) \
+	(((set)->__fds_bits[(fd) / __NFDBITS] >> ((fd) % __NFDBITS)) & 1)
+
+
 /*
  * Prototypes for OS/161 system calls.
  *
@@ -68,6 +94,8 @@
  *     remove:   stdio.h
  *     rename:   stdio.h
  *     time:     time.h
+ *     select:   sys/select.h
+ *     poll:     poll.h
  *
  * Also note that the prototypes for open() and mkdir() contain, for
  * compatibility with Unix, an extra argument that is not meaningful
@@ -147,7 +175,32 @@ ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
+int nanosleep(const struct timespec *req, struct timespec *rem);
+int clock_gettime(int clockid, struct timespec *ts);
 ssize_t __getcwd(char *buf, size_t buflen);
+int getpriority(int which, int who);
+int setpriority(int which, int who, int prio);
+int getrusage(int who, struct rusage *ru);
+int sched_setaffinity(pid_t pid, const unsigned *mask);
+int sched_getaffinity(pid_t pid, unsigned *mask);
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param *param);
+int sched_getscheduler(pid_t pid, struct sched_param *param);
+pid_t vfork(void);
+pid_t spawn(const char *prog, char *const *args,
+	    const struct spawn_action *actions);
+ssize_t pread(int filehandle, void *buf, size_t size, off_t pos);
+ssize_t pwrite(int filehandle, const void *buf, size_t size, off_t pos);
+ssize_t readv(int filehandle, const struct iovec *iov, int iovcnt);
+ssize_t writev(int filehandle, const struct iovec *iov, int iovcnt);
+ssize_t preadv(int filehandle, const struct iovec *iov, int iovcnt, off_t pos);
+ssize_t pwritev(int filehandle, const struct iovec *iov, int iovcnt,
+		off_t pos);
+ssize_t splice(int fromhandle, int tohandle, size_t size);
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+	   struct timeval *timeout);
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+int uring_setup(void *rings, unsigned entries, int flags);
+int uring_enter(unsigned to_submit, unsigned min_complete, int flags);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -159,4 +212,18 @@ int execvp(const char *prog, char *const *args); /* calls execv */
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
 time_t time(time_t *seconds);			/* calls __time */
 
+/*
+ * Helpers for the rings of uring_setup. Fill in the SQE that
+ * uring_get_sqe returns, then uring_queue_sqe it; uring_submit hands
+ * the queued ones to the kernel (with SQPOLL, only waking the poller
+ * when it has gone to sleep). Read completions with uring_peek_cqe,
+ * or uring_wait_cqe to wait for one, and uring_cqe_seen each one.
+ */
+struct uring_sqe *uring_get_sqe(struct uring_rings *r);	/* NULL if full */
+void uring_queue_sqe(struct uring_rings *r);
+int uring_submit(struct uring_rings *r);		/* calls uring_enter */
+struct uring_cqe *uring_peek_cqe(struct uring_rings *r); /* NULL if none */
+struct uring_cqe *uring_wait_cqe(struct uring_rings *r); /* calls uring_enter */
+void uring_cqe_seen(struct uring_rings *r);
+
 #endif /* _UNISTD_H_ */
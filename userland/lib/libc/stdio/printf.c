@@ -29,13 +29,53 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 
 /*
  * printf - C standard I/O function.
+ *
+ * __vprintf hands us the output in small pieces, often a character
+ * at a time. We collect them in a buffer and write it out when it
+ * fills or at the end, so a printf is usually one write. A piece
+ * that doesn't fit goes out with the buffer in front of it as one
+ * writev, without being copied.
  */
 
+#define PRINTF_BUFSIZE 128
+
+struct printbuf {
+	char pb_buf[PRINTF_BUFSIZE];
+	size_t pb_len;
+	int pb_err;
+};
+
+/*
+ * Write out the buffer, followed by DATA (LEN bytes, possibly 0).
+ */
+static
+void
+__printf_flush(struct printbuf *pb, const char *data, size_t len)
+{
+	struct iovec iov[2];
+	int n = 0;
+
+	if (pb->pb_len > 0) {
+		iov[n].iov_base = pb->pb_buf;
+		iov[n].iov_len = pb->pb_len;
+		n++;
+	}
+	if (len > 0) {
+		iov[n].iov_base = (void *)data;
+		iov[n].iov_len = len;
+		n++;
+	}
+	if (n > 0 && pb->pb_err == 0 && writev(STDOUT_FILENO, iov, n) == -1) {
+		pb->pb_err = errno;
+	}
+	pb->pb_len = 0;
+}
 
 /*
  * Function passed to __vprintf to do the actual output.
@@ -44,11 +84,15 @@ static
 void
 __printf_send(void *mydata, const char *data, size_t len)
 {
-	ssize_t ret;
-	int *err = mydata;
+	struct printbuf *pb = mydata;
 
-	ret = write(STDOUT_FILENO, data, len);
-	*err = (ret == -1) ? errno : 0;
+	if (len <= PRINTF_BUFSIZE - pb->pb_len) {
+		memcpy(pb->pb_buf + pb->pb_len, data, len);
+		pb->pb_len += len;
+	}
+	else {
+		__printf_flush(pb, data, len);
+	}
 }
 
 /* printf: hand off to vprintf */
@@ -68,10 +112,15 @@ printf(const char *fmt, ...)
 int
 vprintf(const char *fmt, va_list ap)
 {
-	int chars, err;
-	chars = __vprintf(__printf_send, &err, fmt, ap);
-	if (err) {
-		errno = err;
+	struct printbuf pb;
+	int chars;
+
+	pb.pb_len = 0;
+	pb.pb_err = 0;
+	chars = __vprintf(__printf_send, &pb, fmt, ap);
+	__printf_flush(&pb, NULL, 0);
+	if (pb.pb_err) {
+		errno = pb.pb_err;
 		return -1;
 	}
 	return chars;
@@ -74,18 +74,16 @@ system(const char *cmd)
 
 	argv[nargs] = NULL;
 
-	pid = fork();
-	switch (pid) {
-	    case -1:
-		return -1;
-	    case 0:
-		/* child */
-		execv(argv[0], argv);
-		/* exec only returns if it fails */
-		_exit(255);
-	    default:
-		/* parent */
-		waitpid(pid, &status, 0);
-		return status;
+	/*
+	 * spawn builds the child straight from the executable, so
+	 * we don't pay for copying our address space only to throw
+	 * the copy away in exec.
+	 */
+	pid = spawn(argv[0], argv, NULL);
+	if (pid < 0) {
+		/* Report it the way a failed exec in a child would. */
+		return _MKWAIT_EXIT(255);
 	}
+	waitpid(pid, &status, 0);
+	return status;
 }
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2013
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * Helpers for the submission and completion rings of uring_setup
+ * (see <kern/uring.h> for the layout).
+ *
+ * The kernel may read and write the rings at any time, so the
+ * indexes are accessed through volatile pointers, and an entry is
+ * always made visible before the index that covers it moves
+ * (or read only after the index has been seen to move).
+ */
+
+#define RINGIDX(x) (*(volatile unsigned *)&(x))
+
+/* Memory barrier; the same instruction as the kernel's membar_any_any. */
+static
+void
+ring_membar(void)
+{
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		"sync;"			/* do it */
+		".set pop"		/* restore assembler mode */
+		:			/* no outputs */
+		:			/* no inputs */
+		: "memory");		/* "changes" memory */
+}
+
+static
+struct uring_sqe *
+ring_sqes(struct uring_rings *r)
+{
+	return (struct uring_sqe *)(r + 1);
+}
+
+static
+struct uring_cqe *
+ring_cqes(struct uring_rings *r)
+{
+	return (struct uring_cqe *)(ring_sqes(r) + r->ur_entries);
+}
+
+/*
+ * Return the next free SQE, or NULL if the submission queue is full.
+ * It belongs to the kernel only after uring_queue_sqe.
+ */
+struct uring_sqe *
+uring_get_sqe(struct uring_rings *r)
+{
+	unsigned tail = r->ur_sqtail;
+
+	if (tail - RINGIDX(r->ur_sqhead) >= r->ur_entries) {
+		return NULL;
+	}
+	return &ring_sqes(r)[tail & (r->ur_entries - 1)];
+}
+
+void
+uring_queue_sqe(struct uring_rings *r)
+{
+	ring_membar();
+	RINGIDX(r->ur_sqtail) = r->ur_sqtail + 1;
+}
+
+/*
+ * Hand the queued SQEs to the kernel. Returns the number taken, or
+ * with SQPOLL 0, since the poller takes them itself.
+ */
+int
+uring_submit(struct uring_rings *r)
+{
+	if (RINGIDX(r->ur_flags) & URING_F_SQPOLL) {
+		/* The tail must be out before we look at the flag. */
+		ring_membar();
+		if (RINGIDX(r->ur_flags) & URING_F_NEED_WAKEUP) {
+			return uring_enter(0, 0, URING_ENTER_WAKEUP);
+		}
+		return 0;
+	}
+	return uring_enter(r->ur_sqtail - RINGIDX(r->ur_sqhead), 0, 0);
+}
+
+/*
+ * Return the oldest unseen CQE, or NULL if there is none.
+ */
+struct uring_cqe *
+uring_peek_cqe(struct uring_rings *r)
+{
+	unsigned head = r->ur_cqhead;
+
+	if (head == RINGIDX(r->ur_cqtail)) {
+		return NULL;
+	}
+	ring_membar();
+	return &ring_cqes(r)[head & (r->ur_entries - 1)];
+}
+
+/*
+ * Like uring_peek_cqe, but wait for a CQE. Without SQPOLL, CQEs only
+ * appear when SQEs are submitted, so this submits any queued ones,
+ * and fails with EAGAIN if there are none.
+ */
+struct uring_cqe *
+uring_wait_cqe(struct uring_rings *r)
+{
+	struct uring_cqe *cqe;
+
+	while ((cqe = uring_peek_cqe(r)) == NULL) {
+		if (RINGIDX(r->ur_flags) & URING_F_SQPOLL) {
+			if (uring_enter(0, 1, URING_ENTER_GETEVENTS) < 0) {
+				return NULL;
+			}
+		}
+		else if (r->ur_sqtail == RINGIDX(r->ur_sqhead)) {
+			errno = EAGAIN;
+			return NULL;
+		}
+		else if (uring_submit(r) < 0) {
+			return NULL;
+		}
+	}
+	return cqe;
+}
+
+/*
+ * Give the CQE from uring_peek_cqe or uring_wait_cqe back to the
+ * kernel, once done with it.
+ */
+void
+uring_cqe_seen(struct uring_rings *r)
+{
+	ring_membar();
+	RINGIDX(r->ur_cqhead) = r->ur_cqhead + 1;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * forkbench - measure the fork/exit/waitpid rate.
+ *
+ * Usage: forkbench [workers [iterations]]
+ *
+ * Starts WORKERS processes (default 1), each of which forks a child
+ * that exits immediately and waits for it, ITERATIONS times (default
+ * 1000). Prints the total time and the rate over all workers. Run it
+ * with 1 to 8 workers on a kernel with as many cpus to see how well
+ * process creation and reaping scale.
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+
+#define MAXWORKERS 32
+
+static
+void
+worker(unsigned iterations)
+{
+	unsigned i;
+	pid_t pid;
+	int status;
+
+	for (i=0; i<iterations; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "child %d: bad status 0x%x", pid, status);
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned workers = 1, iterations = 1000;
+	pid_t pids[MAXWORKERS];
+	struct timespec start, end;
+	unsigned i, failed, usec;
+	int status;
+
+	if (argc > 1) {
+		workers = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		iterations = atoi(argv[2]);
+	}
+	if (workers < 1 || workers > MAXWORKERS || iterations < 1) {
+		errx(1, "Usage: forkbench [workers (1-%d) [iterations]]",
+		     MAXWORKERS);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i=0; i<workers; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			worker(iterations);
+			_exit(0);
+		}
+	}
+
+	failed = 0;
+	for (i=0; i<workers; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			failed++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (failed > 0) {
+		errx(1, "%u workers failed", failed);
+	}
+
+	usec = (end.tv_sec - start.tv_sec) * 1000000 +
+		(end.tv_nsec - start.tv_nsec) / 1000;
+	if (usec == 0) {
+		usec = 1;
+	}
+	printf("forkbench: %u workers x %u forks in %u.%06u s\n",
+	       workers, iterations, usec / 1000000, usec % 1000000);
+	printf("forkbench: %u forks/s, %u us per fork in each worker\n",
+	       (unsigned)((unsigned long long)workers * iterations *
+			  1000000 / usec),
+	       usec / iterations);
+	return 0;
+}
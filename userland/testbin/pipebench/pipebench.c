@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * pipebench - measure pipe throughput, with and without splice.
+ *
+ * Usage: pipebench [-s] [kilobytes [chunk]]
+ *
+ * A child process writes KILOBYTES (default 4096) of data into a
+ * pipe, CHUNK bytes (default 4096) at a time. The parent drains the
+ * pipe into the null device. By default it does so the usual way,
+ * reading each chunk into its own buffer and writing it out again;
+ * with -s it uses splice to move the data from the pipe to the
+ * device without it passing through user memory. Prints the time
+ * taken and the throughput.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <err.h>
+#include <sys/wait.h>
+
+#define MAXCHUNK 65536
+
+static char buf[MAXCHUNK];
+
+static
+void
+writer(int fd, unsigned long long total, size_t chunk)
+{
+	size_t len;
+	ssize_t r;
+
+	memset(buf, 'x', chunk);
+	while (total > 0) {
+		len = total < chunk ? total : chunk;
+		r = write(fd, buf, len);
+		if (r < 0) {
+			err(1, "write");
+		}
+		total -= r;
+	}
+}
+
+static
+unsigned long long
+reader(int fd, int outfd, size_t chunk, int usesplice)
+{
+	unsigned long long total = 0;
+	ssize_t r, w;
+
+	while (1) {
+		if (usesplice) {
+			r = splice(fd, outfd, chunk);
+			if (r < 0) {
+				err(1, "splice");
+			}
+		}
+		else {
+			r = read(fd, buf, chunk);
+			if (r < 0) {
+				err(1, "read");
+			}
+			if (r > 0) {
+				w = write(outfd, buf, r);
+				if (w != r) {
+					err(1, "write");
+				}
+			}
+		}
+		if (r == 0) {
+			break;
+		}
+		total += r;
+	}
+	return total;
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: pipebench [-s] [kilobytes [chunk (1-%d)]]",
+	     MAXCHUNK);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long long total = 4096ULL * 1024, got;
+	size_t chunk = 4096;
+	struct timespec start, end;
+	unsigned usec;
+	int usesplice = 0, arg = 1;
+	int fds[2], outfd, status;
+	pid_t pid;
+
+	if (argc > arg && !strcmp(argv[arg], "-s")) {
+		usesplice = 1;
+		arg++;
+	}
+	if (argc > arg) {
+		total = (unsigned long long)atoi(argv[arg++]) * 1024;
+	}
+	if (argc > arg) {
+		chunk = atoi(argv[arg++]);
+	}
+	if (argc > arg || total == 0 || chunk < 1 || chunk > MAXCHUNK) {
+		usage();
+	}
+
+	outfd = open("null:", O_WRONLY);
+	if (outfd < 0) {
+		err(1, "null:");
+	}
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		writer(fds[1], total, chunk);
+		_exit(0);
+	}
+	close(fds[1]);
+
+	got = reader(fds[0], outfd, chunk, usesplice);
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "writer failed");
+	}
+	if (got != total) {
+		errx(1, "got %llu bytes, expected %llu", got, total);
+	}
+
+	usec = (end.tv_sec - start.tv_sec) * 1000000 +
+		(end.tv_nsec - start.tv_nsec) / 1000;
+	if (usec == 0) {
+		usec = 1;
+	}
+	printf("pipebench: %llu KB in %zu-byte chunks with %s, "
+	       "in %u.%06u s\n", total / 1024, chunk,
+	       usesplice ? "splice" : "read+write",
+	       usec / 1000000, usec % 1000000);
+	printf("pipebench: %llu KB/s\n", total * 1000000 / 1024 / usec);
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * rwbench - measure the rate of small read and write calls.
+ *
+ * Usage: rwbench [-s] [workers [iterations]]
+ *
+ * Starts WORKERS processes (default 1), each of which does
+ * ITERATIONS (default 10000) one-byte writes and one-byte reads on
+ * the null device, so nearly all the time is in the system call
+ * path and the file descriptor layer rather than the device. Prints
+ * the total time and the rate of calls over all workers.
+ *
+ * By default each worker opens the device itself. With -s the
+ * parent opens it once before forking, so all workers share one
+ * open file and its seek position, which then has to be locked on
+ * every call.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <err.h>
+#include <sys/wait.h>
+
+#define MAXWORKERS 32
+
+static
+void
+worker(int fd, unsigned iterations)
+{
+	unsigned i;
+	char ch = 'x';
+
+	if (fd < 0) {
+		fd = open("null:", O_RDWR);
+		if (fd < 0) {
+			err(1, "null:");
+		}
+	}
+	for (i=0; i<iterations; i++) {
+		if (write(fd, &ch, 1) != 1) {
+			err(1, "write");
+		}
+		if (read(fd, &ch, 1) < 0) {
+			err(1, "read");
+		}
+	}
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: rwbench [-s] [workers (1-%d) [iterations]]",
+	     MAXWORKERS);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned workers = 1, iterations = 10000;
+	pid_t pids[MAXWORKERS];
+	struct timespec start, end;
+	unsigned i, failed, usec;
+	int shared = 0, fd = -1, arg = 1;
+	int status;
+
+	if (argc > arg && !strcmp(argv[arg], "-s")) {
+		shared = 1;
+		arg++;
+	}
+	if (argc > arg) {
+		workers = atoi(argv[arg++]);
+	}
+	if (argc > arg) {
+		iterations = atoi(argv[arg++]);
+	}
+	if (argc > arg || workers < 1 || workers > MAXWORKERS ||
+	    iterations < 1) {
+		usage();
+	}
+
+	if (shared) {
+		fd = open("null:", O_RDWR);
+		if (fd < 0) {
+			err(1, "null:");
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i=0; i<workers; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			worker(fd, iterations);
+			_exit(0);
+		}
+	}
+
+	failed = 0;
+	for (i=0; i<workers; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			failed++;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (failed > 0) {
+		errx(1, "%u workers failed", failed);
+	}
+
+	usec = (end.tv_sec - start.tv_sec) * 1000000 +
+		(end.tv_nsec - start.tv_nsec) / 1000;
+	if (usec == 0) {
+		usec = 1;
+	}
+	printf("rwbench: %u workers x %u read+write pairs, %s file, "
+	       "in %u.%06u s\n", workers, iterations,
+	       shared ? "shared" : "private",
+	       usec / 1000000, usec % 1000000);
+	printf("rwbench: %u calls/s\n",
+	       (unsigned)((unsigned long long)workers * iterations * 2 *
+			  1000000 / usec));
+	return 0;
+}
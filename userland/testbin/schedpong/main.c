@@ -221,9 +221,9 @@ waitstart(void)
 static
 void
 runit(unsigned numthinkers, unsigned numgrinders,
-      unsigned numponggroups, unsigned ponggroupsize)
+      unsigned numponggroups, unsigned ponggroupsize, unsigned numprobes)
 {
-	pid_t pids[numponggroups + 2];
+	pid_t pids[numponggroups + 3];
 	time_t startsecs;
 	unsigned long startnsecs;
 	char buf[32];
@@ -232,6 +232,10 @@ runit(unsigned numthinkers, unsigned numgrinders,
 	printf("Running with %u thinkers, %u grinders, and %u pong groups "
 	       "of size %u each.\n", numthinkers, numgrinders, numponggroups,
 	       ponggroupsize);
+	if (numprobes > 0) {
+		printf("Also %u %s latency probes.\n", numprobes,
+		       probe_rt ? "real-time" : "time-sharing");
+	}
 
 	usem_init(&startsem, STARTSEM);
 	createresultsfile();
@@ -241,12 +245,14 @@ runit(unsigned numthinkers, unsigned numgrinders,
 		forkem(ponggroupsize, pong_prep, pong, pong_cleanup, i+2,
 		       &pids[i+2]);
 	}
+	forkem(numprobes, nop, probe, nop, numponggroups+2,
+	       &pids[numponggroups+2]);
 	usem_open(&startsem);
 	printf("Forking done; starting the workload.\n");
 	__time(&startsecs, &startnsecs);
 	Vn(&startsem, numthinkers + numgrinders +
-	   numponggroups * ponggroupsize);
-	waitall(pids, numponggroups + 2);
+	   numponggroups * ponggroupsize + numprobes);
+	waitall(pids, numponggroups + 3);
 	usem_close(&startsem);
 	usem_cleanup(&startsem);
 
@@ -268,6 +274,12 @@ runit(unsigned numthinkers, unsigned numgrinders,
 		printf("Pong group %u: %s\n", i, buf);
 	}
 
+	if (numprobes > 0) {
+		calcresult(numponggroups+2, startsecs, startnsecs,
+			   buf, sizeof(buf));
+		printf("Probes: %s\n", buf);
+	}
+
 	closeresultsfile();
 	destroyresultsfile();
 }
@@ -281,8 +293,10 @@ usage(const char *av0)
 	warnx("  [-g grinders]         set number of grinders (default 0)");
 	warnx("  [-p ponggroups]       set number of pong groups (default 1)");
 	warnx("  [-s ponggroupsize]    set pong group size (default 6)");
+	warnx("  [-l probes]           set number of latency probes (default 0)");
+	warnx("  [-r]                  run the probes real-time (SCHED_RR)");
 	warnx("Thinkers are CPU bound; grinders are memory-bound;");
-	warnx("pong groups are I/O bound.");
+	warnx("pong groups are I/O bound; probes measure wakeup latency.");
 	exit(1);
 }
 
@@ -293,6 +307,7 @@ main(int argc, char *argv[])
 	unsigned numgrinders = 0;
 	unsigned numponggroups = 1;
 	unsigned ponggroupsize = 6;
+	unsigned numprobes = 0;
 
 	int i;
 
@@ -309,11 +324,18 @@ main(int argc, char *argv[])
 		else if (!strcmp(argv[i], "-s")) {
 			ponggroupsize = atoi(argv[++i]);
 		}
+		else if (!strcmp(argv[i], "-l")) {
+			numprobes = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-r")) {
+			probe_rt = 1;
+		}
 		else {
 			usage(argv[0]);
 		}
 	}
 
-	runit(numthinkers, numgrinders, numponggroups, ponggroupsize);
+	runit(numthinkers, numgrinders, numponggroups, ponggroupsize,
+	      numprobes);
 	return 0;
 }
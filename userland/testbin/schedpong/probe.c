@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2015
+ *	The President and Fellows of Harvard College.
+ *      Written by David A. Holland.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <err.h>
+
+#include "tasks.h"
+
+/*
+ * probe - wakeup latency task
+ *
+ * Sleep for a tick at a time and record how late each wakeup comes,
+ * while the thinkers and grinders keep the cpus busy. With -r the
+ * probes run in the real-time class (SCHED_RR). A real-time wakeup
+ * preempts a time-sharing thread at once, so the lateness should
+ * stay within about a tick; time-sharing probes may have to wait
+ * for the running thread's slice to end. The kernel's "lat" menu
+ * command shows the same thing from the scheduler's side.
+ */
+
+#define PROBE_ROUNDS	200
+#define PROBE_SLEEPNS	10000000	/* 10 ms, one tick at HZ=100 */
+#define PROBE_BUCKETS	16		/* log2 of microseconds */
+
+int probe_rt;
+
+static
+unsigned long long
+ts_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+void
+probe(unsigned groupid, unsigned id)
+{
+	unsigned hist[PROBE_BUCKETS];
+	struct sched_param sp;
+	struct timespec req, before, after;
+	unsigned long long late, max, total;
+	unsigned i, b, us;
+
+	(void)groupid;
+
+	if (probe_rt) {
+		/* One tick in ten; well inside admission control. */
+		sp.sched_priority = SCHED_RT_MAXPRIO;
+		sp.sched_runtime = 10000;
+		sp.sched_period = 100000;
+		if (sched_setscheduler(0, SCHED_RR, &sp) < 0) {
+			err(1, "probe %u: sched_setscheduler", id);
+		}
+	}
+
+	for (b=0; b<PROBE_BUCKETS; b++) {
+		hist[b] = 0;
+	}
+	max = total = 0;
+	req.tv_sec = 0;
+	req.tv_nsec = PROBE_SLEEPNS;
+
+	waitstart();
+
+	for (i=0; i<PROBE_ROUNDS; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &before);
+		if (nanosleep(&req, NULL) < 0) {
+			err(1, "probe %u: nanosleep", id);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &after);
+
+		late = ts_ns(&after) - ts_ns(&before);
+		late = late > PROBE_SLEEPNS ? late - PROBE_SLEEPNS : 0;
+		total += late;
+		if (late > max) {
+			max = late;
+		}
+		us = late / 1000;
+		for (b=0; b<PROBE_BUCKETS-1 && us >= (2U << b); b++) {
+			/* nothing */
+		}
+		hist[b]++;
+	}
+
+	printf("Probe %u (%s): wakeup lateness avg %llu us, max %llu us\n",
+	       id, probe_rt ? "real-time" : "time-sharing",
+	       total / PROBE_ROUNDS / 1000, max / 1000);
+	for (b=0; b<PROBE_BUCKETS; b++) {
+		if (hist[b] > 0) {
+			printf("Probe %u: %7u%c us: %u\n", id,
+			       b == 0 ? 0 : 1U << b,
+			       b == PROBE_BUCKETS-1 ? '+' : ' ', hist[b]);
+		}
+	}
+}
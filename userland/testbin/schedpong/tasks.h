@@ -36,3 +36,6 @@ void grind(unsigned groupid, unsigned id);
 void pong_prep(unsigned groupid, unsigned count);
 void pong_cleanup(unsigned groupid, unsigned count);
 void pong(unsigned groupid, unsigned id);
+
+extern int probe_rt;
+void probe(unsigned groupid, unsigned id);
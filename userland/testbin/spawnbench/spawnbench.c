@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * spawnbench - compare the ways of launching a program.
+ *
+ * Usage: spawnbench [iterations [program]]
+ *
+ * Runs PROGRAM (default /bin/true) ITERATIONS times (default 100)
+ * with each of fork+execv, vfork+execv, and spawn, waiting for it
+ * each time, and prints the average time per launch for each.
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <err.h>
+
+static const char *prog = "/bin/true";
+
+static
+pid_t
+launch_fork(char **args)
+{
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0) {
+		execv(prog, args);
+		_exit(255);
+	}
+	return pid;
+}
+
+static
+pid_t
+launch_vfork(char **args)
+{
+	pid_t pid;
+
+	pid = vfork();
+	if (pid == 0) {
+		execv(prog, args);
+		_exit(255);
+	}
+	return pid;
+}
+
+static
+pid_t
+launch_spawn(char **args)
+{
+	return spawn(prog, args, NULL);
+}
+
+static
+void
+bench(const char *name, pid_t (*launch)(char **), unsigned iterations)
+{
+	char *args[2];
+	struct timespec start, end;
+	unsigned i, usec;
+	pid_t pid;
+	int status;
+
+	args[0] = (char *)prog;
+	args[1] = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i=0; i<iterations; i++) {
+		pid = launch(args);
+		if (pid < 0) {
+			err(1, "%s", name);
+		}
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "%s: %s failed: status 0x%x", name, prog,
+			     status);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	usec = (end.tv_sec - start.tv_sec) * 1000000 +
+		(end.tv_nsec - start.tv_nsec) / 1000;
+	printf("%-12s %u launches, %u us each\n", name, iterations,
+	       usec / iterations);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iterations = 100;
+
+	if (argc > 1) {
+		iterations = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		prog = argv[2];
+	}
+	if (iterations < 1) {
+		errx(1, "Usage: spawnbench [iterations [program]]");
+	}
+
+	bench("fork+execv", launch_fork, iterations);
+	bench("vfork+execv", launch_vfork, iterations);
+	bench("spawn", launch_spawn, iterations);
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2000, 2001, 2002, 2003, 2004, 2005, 2008, 2009
+ *	The President and Fellows of Harvard College.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * uringbench - compare plain system calls with batched submission
+ * through uring_setup rings.
+ *
+ * Usage: uringbench [-p] [ops [batch]]
+ *
+ * Does OPS (default 100000) small writes to the null device, first
+ * with one write() call each, then through a ring, queueing BATCH
+ * (default 32) at a time and handing each batch to the kernel with
+ * one uring_enter. With -p the ring is set up with a kernel poller
+ * thread, which takes the writes without any system call at all
+ * while it is kept busy. Prints the time per write for each.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <err.h>
+
+#define ENTRIES 256	/* largest batch */
+#define WRITESIZE 16
+
+static char buf[WRITESIZE];
+
+/* The rings; unsigned long long for alignment. */
+static unsigned long long ringmem[URING_SIZE(ENTRIES) /
+				  sizeof(unsigned long long) + 1];
+
+static
+unsigned long long
+elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000000ULL +
+		(end->tv_nsec - start->tv_nsec);
+}
+
+static
+void
+plainrun(int fd, unsigned ops)
+{
+	unsigned i;
+
+	for (i = 0; i < ops; i++) {
+		if (write(fd, buf, WRITESIZE) != WRITESIZE) {
+			err(1, "write");
+		}
+	}
+}
+
+static
+void
+ringrun(struct uring_rings *r, int fd, unsigned ops, unsigned batch)
+{
+	struct uring_sqe *sqe;
+	struct uring_cqe *cqe;
+	unsigned queued = 0, done = 0, n;
+
+	while (done < ops) {
+		for (n = 0; n < batch && queued < ops; n++) {
+			sqe = uring_get_sqe(r);
+			if (sqe == NULL) {
+				break;
+			}
+			sqe->sqe_op = URING_OP_WRITE;
+			sqe->sqe_fd = fd;
+			sqe->sqe_flags = 0;
+			sqe->sqe_len = WRITESIZE;
+			sqe->sqe_addr = buf;
+			sqe->sqe_statbuf = NULL;
+			sqe->sqe_off = -1;
+			sqe->sqe_data = queued;
+			uring_queue_sqe(r);
+			queued++;
+		}
+		if (n > 0 && uring_submit(r) < 0) {
+			err(1, "uring_submit");
+		}
+
+		cqe = uring_wait_cqe(r);
+		if (cqe == NULL) {
+			err(1, "uring_wait_cqe");
+		}
+		do {
+			if (cqe->cqe_data != done) {
+				errx(1, "completion %llu out of order, "
+				     "expected %u", cqe->cqe_data, done);
+			}
+			if (cqe->cqe_res != WRITESIZE) {
+				errx(1, "ring write %u: result %d",
+				     done, cqe->cqe_res);
+			}
+			uring_cqe_seen(r);
+			done++;
+		} while ((cqe = uring_peek_cqe(r)) != NULL);
+	}
+}
+
+static
+void
+usage(void)
+{
+	errx(1, "Usage: uringbench [-p] [ops [batch (1-%d)]]", ENTRIES);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct uring_rings *r = (struct uring_rings *)ringmem;
+	struct timespec start, end;
+	unsigned ops = 100000, batch = 32;
+	unsigned long long plainns, ringns;
+	int sqpoll = 0, arg = 1;
+	int fd;
+
+	if (argc > arg && !strcmp(argv[arg], "-p")) {
+		sqpoll = 1;
+		arg++;
+	}
+	if (argc > arg) {
+		ops = atoi(argv[arg++]);
+	}
+	if (argc > arg) {
+		batch = atoi(argv[arg++]);
+	}
+	if (argc > arg || ops == 0 || batch < 1 || batch > ENTRIES) {
+		usage();
+	}
+
+	fd = open("null:", O_WRONLY);
+	if (fd < 0) {
+		err(1, "null:");
+	}
+	memset(buf, 'x', WRITESIZE);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	plainrun(fd, ops);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	plainns = elapsed_ns(&start, &end);
+
+	if (uring_setup(r, ENTRIES, sqpoll ? URING_SETUP_SQPOLL : 0) < 0) {
+		err(1, "uring_setup");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ringrun(r, fd, ops, batch);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ringns = elapsed_ns(&start, &end);
+
+	printf("uringbench: %u writes of %d bytes to null:\n",
+	       ops, WRITESIZE);
+	printf("uringbench: write(): %llu ns each\n", plainns / ops);
+	printf("uringbench: ring (batch %u%s): %llu ns each\n", batch,
+	       sqpoll ? ", poller" : "", ringns / ops);
+	return 0;
+}